@@ -17,91 +17,295 @@
 #include <iostream>
 #include <cstdlib>
 #include <cstring>
+#include <string>
+#include <vector>
 #include "parser/rib_driver.h"
+#include "parser/rib_flat.h"
+#include "parser/rib_walk.h"
 
-void dfs(const rib::Node *node) {
-	switch (node->type) {
-	case rib::kJoint:
-		printf("Joint node\n");
-		break;
-	case rib::kTranslate:
-		printf("Translate node\n");
-		break;
-	case rib::kRotate:
-		printf("Rotate node\n");
-		break;
-	case rib::kScale:
-		printf("Scale node\n");
-		break;
-	case rib::kConcatTransform:
-		printf("Concat Transform node\n");
-		break;
-	case rib::kHyperboloid:
-		printf("Hyperboloid node\n");
-		break;
-	case rib::kParaboloid:
-		printf("Paraboloid node\n");
-		break;
-	case rib::kTorus:
-		printf("Torus node\n");
-		break;
-	case rib::kCylinder:
-		printf("Cylinder node\n");
-		break;
-	case rib::kSphere:
-		printf("Sphere node\n");
-		break;
-	case rib::kDisk:
-		printf("Disk node\n");
-		break;
-	case rib::kCone:
-		printf("Cone node\n");
-		break;
-	case rib::kPattern:
-		printf("Pattern node\n");
-		break;
-	case rib::kBxdf:
-		printf("Bxdf node\n");
-		break;
-	case rib::kLight:
-		printf("Light node\n");
-		break;
-	case rib::kAttribute:
-		printf("Attribute node\n");
-		break;
-	case rib::kPointsPolygons:
-		printf("Points Polygons node\n");
-		break;
-	case rib::kPointsGeneralPolygons:
+// Counts primitives without building a tree.
+class CountHandler : public rib::RibHandler {
+public:
+	size_t quadrics = 0;
+	size_t meshes = 0;
+	size_t faces = 0;
+	size_t blocks = 0;
+public:
+	void onAttributeBegin() { blocks++; }
+	void onHyperboloid(float, float, float, float, float, float,
+				float) { quadrics++; }
+	void onParaboloid(float, float, float, float) { quadrics++; }
+	void onTorus(float, float, float, float, float) { quadrics++; }
+	void onCylinder(float, float, float, float) { quadrics++; }
+	void onSphere(float, float, float, float) { quadrics++; }
+	void onDisk(float, float, float) { quadrics++; }
+	void onCone(float, float, float) { quadrics++; }
+	void onPointsGeneralPolygons(rib::Array<int> &nloops,
+				rib::Array<int> &nvertices,
+				rib::Array<int> &vertices) {
+		meshes++;
+		faces += nloops.size();
+	}
+	void onPointsPolygons(rib::Array<int> &nvertices,
+				rib::Array<int> &vertices) {
+		meshes++;
+		faces += nvertices.size();
+	}
+};
+
+// printed for every node but archives, in the order of rib::NodeType
+static const char *kNodeNames[] = {
+	"Joint",
+	"Attribute",
+	"Translate",
+	"Rotate",
+	"Scale",
+	"Concat Transform",
+	"Hyperboloid",
+	"Paraboloid",
+	"Torus",
+	"Cylinder",
+	"Sphere",
+	"Disk",
+	"Cone",
+	"Points General Polygons",
+	"Points Polygons",
+	"Pattern",
+	"Bxdf",
+	"Light",
+	"Archive"
+};
+
+// Prints the nodes in the order they are entered, what an archive has
+// read before anything else inside it.
+class Printer : public rib::Visitor {
+public:
+	bool enter(const rib::Node *node) {
+		rib::Dispatch(node, *this);
+		return true;
+	}
+	const rib::Node *inside(const rib::Node *node) {
+		if (node->type != rib::kArchive)
+			return nullptr;
+		// delayed ones are left as they are
+		std::shared_ptr<const rib::Scene> contents =
+			((const rib::ArchiveNode *) node)->loaded();
+		return contents ? &contents->root : nullptr;
+	}
+	void visit(const rib::Node *node) {
+		printf("%s node\n", kNodeNames[node->type]);
+	}
+	void visit(const rib::ArchiveNode *node) {
+		printf("%s node %s\n", node->delayed ?
+			"Delayed Archive" : "Archive",
+			node->filename.c_str());
+	}
+	void visit(const rib::PointsGeneralPolygonsNode *node) {
 		printf("Points General Polygons node\n");
-		rib::PointsGeneralPolygonsNode *pnode =
-			(rib::PointsGeneralPolygonsNode *) node;
-		for(std::vector<int>::iterator
-		    it = pnode->vertices.begin();
-		    it != pnode->vertices.end();
+		for(rib::Array<int>::const_iterator
+		    it = node->vertices.begin();
+		    it != node->vertices.end();
 		    ++it) {
 			printf("Vertices attribute %i\n", *it);
 		}
-		for(std::vector<float>::iterator
-		    it = pnode->params["P"].begin();
-		    it != pnode->params["P"].end();
+		const rib::Primvar *P = node->primvars.P();
+		if (P == nullptr)
+			return;
+		for(rib::Array<float>::const_iterator
+		    it = P->numbers.begin();
+		    it != P->numbers.end();
 		    ++it) {
 			printf("P parameter %f\n", *it);
 		}
+	}
+};
+
+void dfs(const rib::Node *node) {
+	Printer printer;
+	rib::Walk(node, printer);
+}
+
+// Prints what dfs() prints, the flat layout is already in its order.
+void walk(const rib::FlatScene &scene) {
+	for (size_t i = 0; i < scene.size(); i++) {
+		rib::NodeType type = scene.type(i);
+		if (type == rib::kArchive) {
+			const rib::FlatArchive &archive =
+				scene.archives[scene.items[i]];
+			printf("%s node %s\n", archive.delayed ?
+				"Delayed Archive" : "Archive",
+				archive.filename.c_str());
+			continue;
+		}
+		printf("%s node\n", kNodeNames[type]);
+		if (type != rib::kPointsGeneralPolygons)
+			continue;
+		const rib::FlatMesh &mesh = scene.meshes[scene.items[i]];
+		for (size_t v = mesh.vertices.begin; v < mesh.vertices.end; v++)
+			printf("Vertices attribute %i\n", scene.ints[v]);
+		const rib::FlatPrimvar *P =
+				scene.findPrimvar(mesh, rib::kSymbolP);
+		if (P == nullptr || P->declaration.type == rib::kString)
+			continue;
+		for (size_t v = P->values.begin; v < P->values.end; v++)
+			printf("P parameter %f\n", scene.data[v]);
+	}
+}
+
+static double MBps(size_t bytes, double seconds)
+{
+	return seconds > 0.0 ? bytes / seconds / (1 << 20) : 0.0;
+}
+
+void printStats(const rib::InputStats &stats) {
+	double parse = stats.parse_seconds - stats.wait_seconds;
+	if (stats.compressed_bytes > 0) {
+		printf("Inflate: %zu -> %zu bytes, %.3f s, %.1f MB/s, "
+			"%.3f s stalled on a full ring\n",
+			stats.compressed_bytes, stats.bytes,
+			stats.inflate_seconds,
+			MBps(stats.bytes, stats.inflate_seconds),
+			stats.stall_seconds);
+	}
+	printf("Parse: %zu bytes, %.3f s, %.1f MB/s, "
+		"%.3f s waiting for input\n",
+		stats.bytes, parse, MBps(stats.bytes, parse),
+		stats.wait_seconds);
+}
+
+int count(const char *filename) {
+	rib::Driver driver;
+	rib::SymbolTable symbols;
+	CountHandler counter;
+	if (driver.parseFile(filename, &counter, &symbols) != rib::kSuccess) {
+		printf("Parse failed\n");
+		return(EXIT_FAILURE);
+	}
+	printf("Attribute blocks: %zu\n", counter.blocks);
+	printf("Quadrics: %zu\n", counter.quadrics);
+	printf("Meshes: %zu, faces: %zu\n", counter.meshes, counter.faces);
+	return(EXIT_SUCCESS);
+}
+
+int flatten(const char *filename, bool stats) {
+	rib::Driver driver;
+	rib::FlatScene scene;
+	printf("Parsing...\n");
+	switch (driver.parse(filename, &scene)) {
+	case rib::kBadFile:
+		printf("The file is bad\n");
+		return(EXIT_FAILURE);
+	case rib::kParseFailed:
+		std::cerr << "Error: " << scene.message << "\n";
+		printf("Parse failed\n");
+		break;
+	case rib::kSuccess:
 		break;
 	}
-	for(std::vector<rib::Node *>::const_iterator it =
-	    node->children.begin();
-	    it != node->children.end();
-	    ++it) {
-	    	dfs(*it);
+	if (stats)
+		printStats(scene.stats);
+	else
+		walk(scene);
+	return(EXIT_SUCCESS);
+}
+
+int batch(const char **filenames, int count, unsigned threads,
+					bool stats, const char *cache) {
+	rib::Driver driver;
+	if (cache != nullptr)
+		driver.setCacheDirectory(cache);
+	std::vector<std::string> paths(filenames, filenames + count);
+	std::vector<rib::ParseResult> results =
+				driver.parseMany(paths, threads, false);
+	int failed = 0;
+	for (size_t i = 0; i < results.size(); i++) {
+		const rib::ParseResult &result = results[i];
+		switch (result.error) {
+		case rib::kBadFile:
+			printf("%s: the file is bad\n", result.filename.c_str());
+			break;
+		case rib::kParseFailed:
+			printf("%s: %s\n", result.filename.c_str(),
+				result.message.empty() ? "parse failed"
+						: result.message.c_str());
+			break;
+		case rib::kSuccess:
+			printf("%s: ok\n", result.filename.c_str());
+			if (stats)
+				printStats(result.stats);
+			break;
+		}
+		if (result.error != rib::kSuccess)
+			failed++;
 	}
+	printf("%d of %zu files failed\n", failed, results.size());
+	return failed == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
 }
 
 int main(const int argc, const char **argv)
 {
+	// -c counts primitives without building the tree,
+	// -s prints throughput instead of the tree,
+	// -j N parses on N threads, 0 for one per core,
+	// -b checks every file given, N of them at a time,
+	// -C dir keeps parsed trees in dir and reads them back from there,
+	// -f lays the scene out flat and walks it in a loop
+	bool counting = false;
+	bool flat = false;
+	bool stats = false;
+	bool batching = false;
+	unsigned threads = 1;
+	const char *cache = nullptr;
+	int i = 1;
+	for (; i < argc - 1; i++) {
+		if (strcmp(argv[i], "-c") == 0)
+			counting = true;
+		else if (strcmp(argv[i], "-s") == 0)
+			stats = true;
+		else if (strcmp(argv[i], "-b") == 0)
+			batching = true;
+		else if (strcmp(argv[i], "-f") == 0)
+			flat = true;
+		else if (strcmp(argv[i], "-j") == 0 && i + 2 < argc)
+			threads = (unsigned) atoi(argv[++i]);
+		else if (strcmp(argv[i], "-C") == 0 && i + 2 < argc)
+			cache = argv[++i];
+		else
+			break;
+	}
+	if (i >= argc) {
+		printf("Usage: %s [-c] [-s] [-j threads] [-C cache] file\n"
+			"       %s -f [-s] file\n"
+			"       %s -b [-s] [-j threads] [-C cache] file...\n",
+			argv[0], argv[0], argv[0]);
+		return(EXIT_FAILURE);
+	}
+	if (batching)
+		return batch(argv + i, argc - i, threads, stats, cache);
+	if (counting)
+		return count(argv[i]);
+	if (flat)
+		return flatten(argv[i], stats);
+
 	rib::Driver driver;
-	rib::Node root = driver.parse(argv[1]);
-	dfs(&root);
+	if (cache != nullptr)
+		driver.setCacheDirectory(cache);
+	rib::Scene scene;
+	printf("Parsing...\n");
+	switch (driver.parse(argv[i], &scene, threads)) {
+	case rib::kBadFile:
+		printf("The file is bad\n");
+		return(EXIT_FAILURE);
+	case rib::kParseFailed:
+		std::cerr << "Error: " << scene.message << "\n";
+		printf("Parse failed\n");
+		break;
+	case rib::kSuccess:
+		break;
+	}
+	if (stats)
+		printStats(scene.stats);
+	else
+		dfs(&scene.root);
 	return(EXIT_SUCCESS);
 }
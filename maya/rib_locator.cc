@@ -14,17 +14,27 @@
  * limitations under the License.
  * ************************************************************************/
 
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
 #include "maya/rib_locator.h"
-#include "utils/maya_primitives.h"
-#include "utils/primitives.h"
 
 
 MTypeId RibLocator::id(kRibLocatorID);
 MObject RibLocator::file_;
+MObject RibLocator::density_;
+MObject RibLocator::min_samples_;
+MObject RibLocator::max_samples_;
 MString	RibLocator::drawDbClassification(kRibLocatorDbClassification);
 MString	RibLocator::drawRegistrantId(kRibLocatorRegistrantId);
 
-RibLocator::RibLocator() {}
+RibLocator::RibLocator() : scene_(new rib::Scene), generation_(0)
+{
+	// parsed trees are kept on disk if there is somewhere to keep them
+	const char *cache = getenv("RIB_LOCATOR_CACHE");
+	if (cache != nullptr)
+		driver_.setCacheDirectory(cache);
+}
 RibLocator::~RibLocator() {}
 
 
@@ -48,6 +58,26 @@ MStatus RibLocator::initialize()
 	t_attr.setKeyable(true);
 	addAttribute(file_);
 
+	MFnNumericAttribute n_attr;
+	density_ = n_attr.create("density", "density",
+				MFnNumericData::kFloat, 0.5);
+	n_attr.setMin(0.0);
+	n_attr.setStorable(true);
+	n_attr.setKeyable(true);
+	addAttribute(density_);
+	min_samples_ = n_attr.create("minSamples", "minSamples",
+				MFnNumericData::kInt, 4);
+	n_attr.setMin(2);
+	n_attr.setStorable(true);
+	n_attr.setKeyable(true);
+	addAttribute(min_samples_);
+	max_samples_ = n_attr.create("maxSamples", "maxSamples",
+				MFnNumericData::kInt, 64);
+	n_attr.setMin(2);
+	n_attr.setStorable(true);
+	n_attr.setKeyable(true);
+	addAttribute(max_samples_);
+
 	return MS::kSuccess;
 }
 
@@ -66,12 +96,13 @@ void RibLocator::postConstructor()
 
 void RibLocator::updateRibTree(MPlug &plug) {
 	rib::ParseError ret;
-	rib::Node node;
 	
 	MString file;
 	MString error_msg;
 	plug.getValue(file);
-	ret = driver_.parseMaya(file.asChar(), &node);
+	// blocks that are the same as last time keep their nodes,
+	// on failure the tree stays as it was
+	ret = driver_.reparse(file.asChar(), scene_.get());
 
 	switch(ret) {
 	case rib::kBadFile:
@@ -79,12 +110,15 @@ void RibLocator::updateRibTree(MPlug &plug) {
 		MGlobal::displayError(error_msg);
 		break;
 	case rib::kParseFailed:
-		error_msg = "Parse failed";
+		error_msg = "Parse failed: ";
+		error_msg += scene_->message.c_str();
 		MGlobal::displayError(error_msg);
 		break;
 	case rib::kSuccess:
-		driver_.clean(&root_);
-		root_ = node;
+		rib::Flatten(scene_->root, &flat_);
+		bvh_.build(flat_);
+		generation_++;
+		MHWRender::MRenderer::setGeometryDrawDirty(thisMObject());
 		break;
 	}
 }
@@ -116,8 +150,21 @@ void RibLocator::draw(M3dView & view, const MDagPath & path,
 }
 
 
-RibLocatorDrawOverride::RibLocatorDrawOverride(const MObject& obj)
-: MHWRender::MPxDrawOverride(obj, NULL, false)
+MBoundingBox RibLocator::boundingBox() const
+{
+	if (bvh_.bound().empty())
+		return MBoundingBox();
+	const rib::Bound &bound = bvh_.bound();
+	return MBoundingBox(
+		MPoint(bound.min[0], bound.min[1], bound.min[2]),
+		MPoint(bound.max[0], bound.max[1], bound.max[2]));
+}
+
+
+static const char *kPointsItem = "ribLocatorPoints";
+
+RibLocatorGeometryOverride::RibLocatorGeometryOverride(const MObject& obj)
+: MHWRender::MPxGeometryOverride(obj), generation_(0), uploaded_(0)
 {
 	on_editor_changed_id_ = MEventMessage::addEventCallback(
 		"modelEditorChanged", onModelEditorChanged, this);
@@ -125,9 +172,10 @@ RibLocatorDrawOverride::RibLocatorDrawOverride(const MObject& obj)
 	MStatus status;
 	MFnDependencyNode node(obj, &status);
 	rib_locator_ = status ? dynamic_cast<RibLocator*>(node.userNode()) : NULL;
+	watchPanels();
 }
 
-RibLocatorDrawOverride::~RibLocatorDrawOverride()
+RibLocatorGeometryOverride::~RibLocatorGeometryOverride()
 {
 	rib_locator_ = NULL;
 
@@ -136,241 +184,210 @@ RibLocatorDrawOverride::~RibLocatorDrawOverride()
 		MMessage::removeCallback(on_editor_changed_id_);
 		on_editor_changed_id_ = 0;
 	}
+	MMessage::removeCallbacks(on_render_ids_);
 }
 
-void RibLocatorDrawOverride::onModelEditorChanged(void *clientData)
+void RibLocatorGeometryOverride::onModelEditorChanged(void *clientData)
 {
-	RibLocatorDrawOverride *ovr = static_cast<RibLocatorDrawOverride*>(clientData);
+	RibLocatorGeometryOverride *ovr = static_cast<RibLocatorGeometryOverride*>(clientData);
 	if (ovr && ovr->rib_locator_)
 	{
+		ovr->watchPanels();
 		MHWRender::MRenderer::setGeometryDrawDirty(ovr->rib_locator_->thisMObject());
 	}
 }
 
-MHWRender::DrawAPI RibLocatorDrawOverride::supportedDrawAPIs() const
+// Before a panel draws, asks for updateDG again if its camera has moved
+// since it last ran, it then only uploads what the move brings in.
+void RibLocatorGeometryOverride::onViewRender(const MString &panel,
+						void *clientData)
 {
-	return (MHWRender::kOpenGL | MHWRender::kDirectX11 | MHWRender::kOpenGLCoreProfile);
+	RibLocatorGeometryOverride *ovr = static_cast<RibLocatorGeometryOverride*>(clientData);
+	if (ovr == NULL || ovr->rib_locator_ == NULL)
+		return;
+	rib::View view;
+	if (!ovr->camera(panel, &view))
+		return;
+	for (unsigned i = 0; i < ovr->panels_.length(); i++) {
+		if (ovr->panels_[i] != panel)
+			continue;
+		const rib::View &saw = ovr->views_[i];
+		if (saw.width == view.width && saw.height == view.height &&
+		    memcmp(saw.clip.m, view.clip.m, sizeof(view.clip.m)) == 0)
+			return;
+		break;
+	}
+	MHWRender::MRenderer::setGeometryDrawDirty(
+			ovr->rib_locator_->thisMObject(), false);
 }
 
-void RibLocatorDrawOverride::drawPoints(MHWRender::MUIDrawManager& drawManager,
-				 MPointArray& points) {
-	for (int i = 0; i < points.length(); i++) {
-		points[i] *= basis_.asMatrix();
-		if (min_point_.x > points[i].x) min_point_.x = points[i].x;
-		if (min_point_.y > points[i].y) min_point_.y = points[i].y;
-		if (min_point_.z > points[i].z) min_point_.z = points[i].z;
-		if (max_point_.x < points[i].x) max_point_.x = points[i].x;
-		if (max_point_.y < points[i].y) max_point_.y = points[i].y;
-		if (max_point_.z < points[i].z) max_point_.x = points[i].x;
+void RibLocatorGeometryOverride::watchPanels()
+{
+	MMessage::removeCallbacks(on_render_ids_);
+	on_render_ids_.clear();
+	panels_.clear();
+	MGlobal::executeCommand("getPanel -type modelPanel", panels_);
+	views_.assign(panels_.length(), rib::View());
+	for (unsigned i = 0; i < panels_.length(); i++) {
+		views_[i].width = 0;
+		MStatus status;
+		MCallbackId id = MUiMessage::add3dViewPreRenderMsgCallback(
+					panels_[i], onViewRender, this, &status);
+		if (status)
+			on_render_ids_.append(id);
 	}
-	drawManager.points(points, false);
 }
 
-void RibLocatorDrawOverride::processNode(MHWRender::MUIDrawManager& drawManager,
-					rib::Node *node) {
-	switch (node->type) {
-	case rib::kTranslate:
-		{
-			rib::TranslateNode *n = (rib::TranslateNode *) node;
-			MVector translation(n->x, n->y, n->z);
-			basis_.addTranslation(translation, MSpace::kObject);
-		}
-		break;
-	case rib::kRotate:
-		{
-			rib::RotateNode *n = (rib::RotateNode *) node;
-			const double rotation[] = {
-				quadrics::radians(n->r * n->x),
-				quadrics::radians(n->r * n->y),
-				quadrics::radians(n->r * n->z)
-			};
-			basis_.addRotation(
-				rotation,
-				basis_.rotationOrder(),
-				MSpace::kObject
-			);
-		}
-		break;
-	case rib::kScale:
-		{
-			rib::ScaleNode *n = (rib::ScaleNode *) node;
-			const double scale[] = {n->x, n->y, n->z};
-			basis_.addScale(scale, MSpace::kObject);
-		}
-		break;
-	case rib::kConcatTransform:
-		{
-			rib::ConcatTransformNode *n =
-					(rib::ConcatTransformNode *) node;
-			float matrix[4][4] = {
-		{ n->matrix[0],  n->matrix[1],  n->matrix[2],  n->matrix[3]  },
-		{ n->matrix[4],  n->matrix[5],  n->matrix[6],  n->matrix[7]  },
-		{ n->matrix[8],  n->matrix[9],  n->matrix[10], n->matrix[11] },
-		{ n->matrix[12], n->matrix[13], n->matrix[14], n->matrix[15] }
-			};
-			MMatrix transformed(matrix);
-			basis_ = basis_.asMatrix() * transformed;
-		}
-		break;
-	case rib::kSphere:
-		{
-			rib::SphereNode *n = (rib::SphereNode *) node;
-			MPointArray points = SpherePoints(
-				50, 30, n->radius, n->zmin,
-				n->zmax, n->thetamax
-			);
-			drawPoints(drawManager, points);
-		}
-		break;
-	case rib::kCone:
-		{
-			rib::ConeNode *n = (rib::ConeNode *) node;
-			MPointArray points = ConePoints(
-				50, 30, n->height, n->radius, n->thetamax
-			);
-			drawPoints(drawManager, points);
-		}
-		break;
-	case rib::kCylinder:
-		{
-			rib::CylinderNode *n = (rib::CylinderNode *) node;
-			MPointArray points = CylinderPoints(
-				50, 30, n->radius, n->zmin, n->zmax, n->thetamax
-			);
-			drawPoints(drawManager, points);
-		}
-		break;
-	case rib::kHyperboloid:
-		{
-			rib::HyperboloidNode *n = (rib::HyperboloidNode *) node;
-			MPointArray points = HyperboloidPoints(
-				60, 60, n->x1, n->y1, n->z1,
-				n->x2, n->y2, n->z2, n->thetamax
-			);
-			drawPoints(drawManager, points);
-		}
-		break;
-	case rib::kParaboloid:
-		{
-			rib::ParaboloidNode *n = (rib::ParaboloidNode *) node;
-			MPointArray points = ParaboloidPoints(
-				60, 60, n->rmax, n->zmin, n->zmax, n->thetamax
-			);
-			drawPoints(drawManager, points);
-		}
-		break;
-	case rib::kDisk:
-		{
-			rib::DiskNode *n = (rib::DiskNode *) node;
-			MPointArray points = DiskPoints(
-				40, 40, n->height, n->radius, n->thetamax
-			);
-			drawPoints(drawManager, points);
-		}
-		break;
-	case rib::kTorus:
-		{
-			rib::TorusNode *n = (rib::TorusNode *) node;
-			MPointArray points = TorusPoints(
-				60, 30, n->rmajor, n->rminor,
-				n->phimin, n->phimax, n->thetamax
-			);
-			drawPoints(drawManager, points);
-		}
-		break;
-	case rib::kPointsPolygons:
-		{
-			rib::PointsPolygonsNode *n =
-				(rib::PointsPolygonsNode *) node;
-			MPointArray points;
-			for(int i = 0; i < n->params["P"].size() / 3; i++) {
-				MPoint p;
-			    	p.x = n->params["P"][i * 3];
-			    	p.y = n->params["P"][i * 3 + 1];
-			    	p.z = n->params["P"][i * 3 + 2];
-				points.append(p);
-			}
-			drawPoints(drawManager, points);
-		}
-		break;
-	case rib::kPointsGeneralPolygons:
-		{
-			rib::PointsGeneralPolygonsNode *n =
-				(rib::PointsGeneralPolygonsNode *) node;
-			MPointArray points;
-			for(int i = 0; i < n->params["P"].size() / 3; i++) {
-				MPoint p;
-			    	p.x = n->params["P"][i * 3];
-			    	p.y = n->params["P"][i * 3 + 1];
-			    	p.z = n->params["P"][i * 3 + 2];
-				points.append(p);
-			}
-			drawPoints(drawManager, points);
-		}
-		break;
-	case rib::kJoint:
-		break;
-	case rib::kAttribute:
-		break;
-	case rib::kPattern:
-		break;
-	case rib::kBxdf:
-		break;
-	case rib::kLight:
-		break;
+bool RibLocatorGeometryOverride::camera(const MString &panel,
+						rib::View *out) const
+{
+	M3dView view;
+	if (!M3dView::getM3dViewFromModelPanel(panel, view) ||
+	    !view.isVisible())
+		return false;
+	MDagPath path;
+	if (!MDagPath::getAPathTo(rib_locator_->thisMObject(), path))
+		return false;
+	MMatrix model_view, projection;
+	view.modelViewMatrix(model_view);
+	view.projectionMatrix(projection);
+	// the locator's space, the scene's, to the camera's
+	MMatrix matrix = path.inclusiveMatrix() * model_view * projection;
+	for (int i = 0; i < 4; i++) {
+		for (int j = 0; j < 4; j++)
+			out->clip.m[i][j] = (float) matrix(i, j);
 	}
+	out->width = view.portWidth();
+	out->height = view.portHeight();
+	return true;
 }
 
-void RibLocatorDrawOverride::DFS(MHWRender::MUIDrawManager& drawManager,
-					rib::Node *node) {
-	processNode(drawManager, node);
-	for(std::vector<rib::Node *>::iterator it =
-	    node->children.begin();
-	    it != node->children.end(); ++it) {
-		if (it == node->children.begin()) {
-			MTransformationMatrix t = basis_;
-			transform_stack_.push(t);
-		}
-		DFS(drawManager, *it);
-		if(std::next(it) == node->children.end()) {
-			basis_ = transform_stack_.top();
-			transform_stack_.pop();
+MHWRender::DrawAPI RibLocatorGeometryOverride::supportedDrawAPIs() const
+{
+	return (MHWRender::kOpenGL | MHWRender::kDirectX11 | MHWRender::kOpenGLCoreProfile);
+}
+
+void RibLocatorGeometryOverride::updateDG()
+{
+	if (rib_locator_ == NULL)
+		return;
+	const rib::FlatScene &scene = rib_locator_->flat_;
+	if (generation_ != rib_locator_->generation_) {
+		generation_ = rib_locator_->generation_;
+		// the nodes a reparse kept keep their points
+		buffer_.carry(scene);
+	}
+	rib::Detail detail;
+	MObject locator = rib_locator_->thisMObject();
+	detail.density = MPlug(locator, RibLocator::density_).asFloat();
+	detail.least = MPlug(locator, RibLocator::min_samples_).asInt();
+	detail.most = std::max(detail.least,
+			MPlug(locator, RibLocator::max_samples_).asInt());
+	// every shown panel, they all draw what the buffer holds
+	std::vector<rib::View> shown;
+	for (unsigned i = 0; i < panels_.length(); i++) {
+		if (!camera(panels_[i], &views_[i])) {
+			views_[i].width = 0;
+			continue;
 		}
+		shown.push_back(views_[i]);
 	}
+	if (shown.empty())
+		return;
+	rib::Refresh(scene, rib_locator_->bvh_, shown, detail, &pool_,
+							&buffer_);
 }
 
-void RibLocatorDrawOverride::addUIDrawables(
-		const MDagPath& objPath,
-		MHWRender::MUIDrawManager& drawManager,
-		const MHWRender::MFrameContext& frameContext,
-		const MUserData* data)
+bool RibLocatorGeometryOverride::requiresGeometryUpdate() const
 {
+	return buffer_.version() != uploaded_;
+}
 
-	unsigned int displayStyle = frameContext.getDisplayStyle();
-	bool filled = !(displayStyle & MHWRender::MFrameContext::kWireFrame);
-
-	drawManager.beginDrawable();
+void RibLocatorGeometryOverride::updateRenderItems(const MDagPath& path,
+				MHWRender::MRenderItemList& list)
+{
+	MHWRender::MRenderer *renderer = MHWRender::MRenderer::theRenderer();
+	if (renderer == NULL)
+		return;
+	const MHWRender::MShaderManager *shaders =
+					renderer->getShaderManager();
+	if (shaders == NULL)
+		return;
+
+	MHWRender::MRenderItem *item = NULL;
+	int index = list.indexOf(kPointsItem);
+	if (index < 0) {
+		item = MHWRender::MRenderItem::Create(kPointsItem,
+				MHWRender::MRenderItem::NonMaterialSceneItem,
+				MHWRender::MGeometry::kPoints);
+		item->setDrawMode(MHWRender::MGeometry::kAll);
+		list.append(item);
+	} else {
+		item = list.itemAt(index);
+	}
 
-	MColor color = MHWRender::MGeometryUtilities::wireframeColor(objPath);
-	drawManager.setColor(color);
-	
-	drawManager.setPaintStyle(MHWRender::MUIDrawManager::kFlat);
-	drawManager.setPointSize(1);
-	
-	MVector translation(0, 0, 0);
-	basis_.setTranslation(translation, MSpace::kWorld);
-	double rotation[] = {0, 0, 0};
-	basis_.setRotation(
-		rotation,
-		basis_.rotationOrder(),
-		MSpace::kWorld
-	);
-	double scale[] = {1, 1, 1};
-	basis_.setScale(scale, MSpace::kWorld);
-
-	DFS(drawManager, &rib_locator_->root_);
-
-	drawManager.endDrawable();
+	MHWRender::MShaderInstance *shader = shaders->getStockShader(
+			MHWRender::MShaderManager::k3dSolidShader);
+	if (shader == NULL)
+		return;
+	MColor color = MHWRender::MGeometryUtilities::wireframeColor(path);
+	const float solid[] = { color.r, color.g, color.b, color.a };
+	shader->setParameter("solidColor", solid);
+	item->setShader(shader);
+	shaders->releaseShader(shader);
+	item->enable(true);
 }
 
+void RibLocatorGeometryOverride::populateGeometry(
+		const MHWRender::MGeometryRequirements& requirements,
+		const MHWRender::MRenderItemList& renderItems,
+		MHWRender::MGeometry& data)
+{
+	uploaded_ = buffer_.version();
+	const std::vector<float> &vertices = buffer_.vertices();
+	const std::vector<uint32_t> &indices = buffer_.indices();
+	if (indices.empty())
+		return;
+
+	const MHWRender::MVertexBufferDescriptorList &descriptors =
+					requirements.vertexRequirements();
+	for (int i = 0; i < descriptors.length(); i++) {
+		MHWRender::MVertexBufferDescriptor descriptor;
+		if (!descriptors.getDescriptor(i, descriptor) ||
+		    descriptor.semantic() != MHWRender::MGeometry::kPosition)
+			continue;
+		if (!vertices_)
+			buffer_.lose();
+		rib::PointBuffer::Upload upload = buffer_.sync();
+		if (upload.capacity != 0) {
+			vertices_.reset(new MHWRender::MVertexBuffer(descriptor));
+			float *out = (float*) vertices_->acquire(
+					(unsigned) upload.capacity, true);
+			if (out == NULL) {
+				vertices_.reset();
+				continue;
+			}
+			std::copy(vertices.begin(), vertices.end(), out);
+			vertices_->commit(out);
+		} else if (upload.end > upload.begin) {
+			vertices_->update(vertices.data() + upload.begin * 3,
+				(unsigned) upload.begin,
+				(unsigned) (upload.end - upload.begin), false);
+		}
+		data.addVertexBuffer(vertices_.get());
+	}
 
+	int index = renderItems.indexOf(kPointsItem);
+	if (index < 0)
+		return;
+	const MHWRender::MRenderItem *item = renderItems.itemAt(index);
+	MHWRender::MIndexBuffer *buffer = data.createIndexBuffer(
+				MHWRender::MGeometry::kUnsignedInt32);
+	uint32_t *out = (uint32_t*) buffer->acquire(
+				(unsigned) indices.size(), true);
+	if (out == NULL)
+		return;
+	std::copy(indices.begin(), indices.end(), out);
+	buffer->commit(out);
+	item->associateWithIndexBuffer(buffer);
+}
@@ -29,21 +29,30 @@
 #include <maya/MDataHandle.h> 
 #include <maya/MFnTypedAttribute.h> 
 #include <maya/MFnNumericAttribute.h> 
+#include <maya/MFnNumericData.h>
 #include <maya/MFnStringData.h>
 #include <maya/MNodeMessage.h>
 
 #include <maya/MDrawRegistry.h>
-#include <maya/MPxDrawOverride.h>
-#include <maya/MUserData.h>
-#include <maya/MDrawContext.h>
+#include <maya/MPxGeometryOverride.h>
+#include <maya/MHWGeometry.h>
+#include <maya/MShaderManager.h>
+#include <maya/MViewport2Renderer.h>
 #include <maya/MHWGeometryUtilities.h>
-#include <maya/MPointArray.h>
+#include <maya/MBoundingBox.h>
 #include <maya/MGlobal.h>
+#include <maya/MCallbackIdArray.h>
 #include <maya/MEventMessage.h>
+#include <maya/MUiMessage.h>
 #include <maya/MFnDependencyNode.h>
 
-#include <stack>
+#include <memory>
+#include <utility>
+#include <vector>
+#include "parser/rib_bvh.h"
 #include "parser/rib_driver.h"
+#include "parser/rib_flat.h"
+#include "utils/point_buffer.h"
 
 #define kRibLocatorID 0x8000C
 #define kRibLocatorDbClassification "drawdb/geometry/ribLocator"
@@ -56,6 +65,8 @@ public:
 	virtual ~RibLocator();
 	virtual void postConstructor();
 	virtual MStatus compute( const MPlug&, MDataBlock& );
+	virtual bool isBounded() const { return true; }
+	virtual MBoundingBox boundingBox() const;
 	virtual void draw( M3dView & view, const MDagPath & path, 
 					   M3dView::DisplayStyle style,
 					   M3dView::DisplayStatus status );
@@ -66,7 +77,18 @@ public:
 	static MString drawDbClassification;
 	static MString drawRegistrantId;
 	static MObject file_;
-	rib::Node root_;
+	// Samples across a quadric per pixel it covers, and the least
+	// and most there may be.
+	static MObject density_;
+	static MObject min_samples_;
+	static MObject max_samples_;
+	std::unique_ptr<rib::Scene> scene_;
+	// the tree laid out for drawing, again after every parse
+	rib::FlatScene flat_;
+	// the boxes of what flat_ draws, to cull against the camera
+	rib::Bvh bvh_;
+	// counts the parses that changed flat_
+	unsigned generation_;
 private:
  	static void attributeChangedCB(MNodeMessage::AttributeMessage msg,
 					MPlug &plug, MPlug &otherPlug, void*);
@@ -76,79 +98,74 @@ private:
 	int attribute_changed_id_;
 };
 
-class RibLocatorData : public MUserData
+// Draws the points of the scene from a vertex buffer that stays on the
+// GPU and an index buffer of what is in view. Every model panel draws
+// the same geometry, so what is in view is what any of their cameras
+// sees, sampled for the panel it looks largest in. When a camera moves
+// the indices are sent again, the vertices only for the nodes it
+// brings in or sees at another distance, appended to what is there.
+// Looking again at what was seen uploads only the indices.
+class RibLocatorGeometryOverride : public MHWRender::MPxGeometryOverride
 {
 public:
-	RibLocatorData() : MUserData(false) {}
-	virtual ~RibLocatorData() {}
-};
-
-class RibLocatorDrawOverride : public MHWRender::MPxDrawOverride
-{
-public:
-	static MHWRender::MPxDrawOverride* Creator(const MObject& obj)
+	static MHWRender::MPxGeometryOverride* Creator(const MObject& obj)
 	{
-		return new RibLocatorDrawOverride(obj);
+		return new RibLocatorGeometryOverride(obj);
 	}
 
-	virtual ~RibLocatorDrawOverride();
+	virtual ~RibLocatorGeometryOverride();
 
 	virtual MHWRender::DrawAPI supportedDrawAPIs() const;
 
-	virtual MUserData* prepareForDraw(
-		const MDagPath& objPath,
-		const MDagPath& cameraPath,
-		const MHWRender::MFrameContext& frameContext,
-		MUserData* oldData)
-	{
-		return oldData;
-	}
-
-	virtual bool hasUIDrawables() const { return true; }
-
-	virtual void addUIDrawables(
-		const MDagPath& objPath,
-		MHWRender::MUIDrawManager& drawManager,
-		const MHWRender::MFrameContext& frameContext,
-		const MUserData* data);
+	virtual void updateDG();
+	virtual bool requiresGeometryUpdate() const;
+	virtual void updateRenderItems(const MDagPath& path,
+				MHWRender::MRenderItemList& list);
+	virtual void populateGeometry(
+		const MHWRender::MGeometryRequirements& requirements,
+		const MHWRender::MRenderItemList& renderItems,
+		MHWRender::MGeometry& data);
+	virtual void cleanUp() {}
 
 	virtual bool traceCallSequence() const
 	{
 		return false;
 	}
 
-	virtual bool isBounded() const
-	{
-		return true;
-	}
-	virtual MBoundingBox boundingBox() const
-	{
-		return MBoundingBox(min_point_, max_point_);
-	}
 	virtual void handleTraceMessage( const MString &message ) const
 	{
-		MGlobal::displayInfo("RibLocatorDrawOverride: " + message);
-		fprintf(stderr, "RibLocatorDrawOverride: ");
+		MGlobal::displayInfo("RibLocatorGeometryOverride: " + message);
+		fprintf(stderr, "RibLocatorGeometryOverride: ");
 		fprintf(stderr, "%s", message.asChar());
 		fprintf(stderr, "\n");
 	}
 
 private:
-	RibLocatorDrawOverride(const MObject& obj);
+	RibLocatorGeometryOverride(const MObject& obj);
 	static void onModelEditorChanged(void *clientData);
-	void DFS(MHWRender::MUIDrawManager& drawManager, rib::Node *root);
-	void processNode(MHWRender::MUIDrawManager& drawManager,
-				rib::Node *node);
-	void drawPoints(MHWRender::MUIDrawManager& drawManager,
-				 MPointArray& points);
-
-	MTransformationMatrix basis_;
-	std::stack<MTransformationMatrix> transform_stack_;
+	static void onViewRender(const MString &panel, void *clientData);
+	// where a model panel's camera is, the scene's space to clip space,
+	// false if the panel isn't shown
+	bool camera(const MString &panel, rib::View *view) const;
+	void watchPanels();
+
 	RibLocator*  rib_locator_;
 	MCallbackId on_editor_changed_id_;
-
-	MPoint min_point_;
-	MPoint max_point_;
+	MCallbackIdArray on_render_ids_;
+	rib::PointBuffer buffer_;
+	// the GPU copy of buffer_'s vertices, kept between populateGeometry
+	// calls so that only what they append is sent
+	std::unique_ptr<MHWRender::MVertexBuffer> vertices_;
+	// one thread a core, started once rather than on every refresh
+	rib::ThreadPool pool_;
+	// the locator's generation_ buffer_ is of
+	unsigned generation_;
+	// the buffer_ version on the GPU
+	unsigned uploaded_;
+	// the model panels watched, and what updateDG last saw of each,
+	// a width of 0 for one that wasn't shown
+	MStringArray panels_;
+	std::vector<rib::View> views_;
 };
 
 #endif // MAYAPLUGIN_RIBLOCATOR_H_
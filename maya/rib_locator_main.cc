@@ -33,12 +33,12 @@ MStatus initializePlugin(MObject obj)
 		return status;
 	}
 
-	status = MHWRender::MDrawRegistry::registerDrawOverrideCreator(
+	status = MHWRender::MDrawRegistry::registerGeometryOverrideCreator(
 		RibLocator::drawDbClassification,
 		RibLocator::drawRegistrantId,
-		RibLocatorDrawOverride::Creator);
+		RibLocatorGeometryOverride::Creator);
 	if (!status) {
-		status.perror("registerDrawOverrideCreator");
+		status.perror("registerGeometryOverrideCreator");
 		return status;
 	}
 	return status;
@@ -49,11 +49,11 @@ MStatus uninitializePlugin(MObject obj)
 	MStatus status;
 	MFnPlugin plugin(obj);
 
-	status = MHWRender::MDrawRegistry::deregisterDrawOverrideCreator(
+	status = MHWRender::MDrawRegistry::deregisterGeometryOverrideCreator(
 		RibLocator::drawDbClassification,
 		RibLocator::drawRegistrantId);
 	if (!status) {
-		status.perror("deregisterDrawOverrideCreator");
+		status.perror("deregisterGeometryOverrideCreator");
 		return status;
 	}
 
@@ -0,0 +1,141 @@
+/* ************************************************************************
+ * Copyright 2017 Alexander Mishurov
+ * 
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ * 
+ * http://www.apache.org/licenses/LICENSE-2.0
+ * 
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ * ************************************************************************/
+
+#include <algorithm>
+#include <cstring>
+#include <vector>
+#include "rib_archive.h"
+
+using namespace rib;
+
+namespace {
+
+#ifdef _WIN32
+const char kSeparators[] = "/\\";
+#else
+const char kSeparators[] = "/";
+#endif
+
+// archives this thread is reading, innermost last
+thread_local std::vector<std::string> t_loading;
+
+class Loading {
+public:
+	Loading(const std::string &path) { t_loading.push_back(path); }
+	~Loading() { t_loading.pop_back(); }
+};
+
+std::shared_ptr<const Scene> Parse(const std::string &path)
+{
+	Loading loading(path);
+	std::shared_ptr<Scene> scene(new Scene);
+	if (Driver().parse(path.c_str(), scene.get()) != kSuccess)
+		return nullptr;
+	return scene;
+}
+
+} // namespace
+
+struct ArchiveCache::Entry {
+	FileStamp stamp;
+	std::mutex mutex;
+	bool done = false;
+	std::shared_ptr<const Scene> scene;
+};
+
+ArchiveCache &ArchiveCache::instance()
+{
+	static ArchiveCache cache;
+	return cache;
+}
+
+std::shared_ptr<const Scene> ArchiveCache::load(const std::string &filename)
+{
+	FileStamp stamp;
+	if (!StampFile(filename.c_str(), &stamp))
+		return nullptr;
+	// one file reached by different paths, say "../c/a.rib" from
+	// inside c, is one archive
+	std::string path = FullPath(filename.c_str());
+	if (std::find(t_loading.begin(), t_loading.end(), path) !=
+	    t_loading.end())
+		return nullptr;
+
+	std::shared_ptr<Entry> entry;
+	{
+		std::lock_guard<std::mutex> lock(mutex_);
+		std::shared_ptr<Entry> &slot = entries_[path];
+		if (!slot || slot->stamp != stamp) {
+			slot = std::make_shared<Entry>();
+			slot->stamp = stamp;
+		}
+		entry = slot;
+	}
+
+	// Whoever parses an archive holds its entry until done, others
+	// wait for the result. A thread already inside an archive doesn't
+	// wait, it parses a copy of its own, so two threads reading two
+	// archives which read each other can't wait on one another.
+	std::unique_lock<std::mutex> lock(entry->mutex, std::defer_lock);
+	if (t_loading.empty())
+		lock.lock();
+	else if (!lock.try_lock())
+		return Parse(path);
+	if (!entry->done) {
+		entry->scene = Parse(path);
+		entry->done = true;
+	}
+	return entry->scene;
+}
+
+void ArchiveCache::clear()
+{
+	std::lock_guard<std::mutex> lock(mutex_);
+	entries_.clear();
+}
+
+size_t ArchiveCache::size() const
+{
+	std::lock_guard<std::mutex> lock(mutex_);
+	return entries_.size();
+}
+
+std::shared_ptr<const Scene> ArchiveNode::contents()
+{
+	std::call_once(once_, [this]() {
+		contents_ = ArchiveCache::instance().load(filename);
+		loaded_ = true;
+	});
+	return contents_;
+}
+
+std::string rib::DirectoryOf(const std::string &path)
+{
+	size_t separator = path.find_last_of(kSeparators);
+	return separator == std::string::npos ? std::string()
+					: path.substr(0, separator + 1);
+}
+
+std::string rib::ResolveArchive(const std::string &directory,
+				const std::string &filename)
+{
+	if (directory.empty() || filename.empty() ||
+	    strchr(kSeparators, filename[0]) != nullptr)
+		return filename;
+	std::string beside = directory + filename;
+	FileStamp stamp;
+	return StampFile(beside.c_str(), &stamp) ? beside : filename;
+}
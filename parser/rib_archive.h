@@ -0,0 +1,58 @@
+/* ************************************************************************
+ * Copyright 2017 Alexander Mishurov
+ * 
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ * 
+ * http://www.apache.org/licenses/LICENSE-2.0
+ * 
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ * ************************************************************************/
+
+#ifndef MAYAPLUGIN_RIBARCHIVE_H_
+#define MAYAPLUGIN_RIBARCHIVE_H_
+
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include "parser/rib_driver.h"
+
+namespace rib {
+
+// Archives parsed so far, shared by the whole process. A file is parsed
+// once for as long as its modification time and size stay the same,
+// however many nodes name it and from however many threads.
+class ArchiveCache {
+public:
+	static ArchiveCache &instance();
+
+	// The parsed file, null if it can't be read or parsed or if it
+	// reads itself. Files are known by their full paths.
+	std::shared_ptr<const Scene> load(const std::string &filename);
+	// Forgets every archive, scenes still in use stay alive.
+	void clear();
+	size_t size() const;
+private:
+	struct Entry;
+
+	mutable std::mutex mutex_;
+	std::map<std::string, std::shared_ptr<Entry>> entries_;
+};
+
+// The directory part of a path, empty if there is none.
+std::string DirectoryOf(const std::string &path);
+
+// A file named in a RIB: next to the RIB if it is there, otherwise as
+// written, which is relative to the working directory.
+std::string ResolveArchive(const std::string &directory,
+				const std::string &filename);
+
+} /* namespace rib */
+
+#endif  // MAYAPLUGIN_RIBARCHIVE_H_
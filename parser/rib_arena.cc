@@ -0,0 +1,188 @@
+/* ************************************************************************
+ * Copyright 2017 Alexander Mishurov
+ * 
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ * 
+ * http://www.apache.org/licenses/LICENSE-2.0
+ * 
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ * ************************************************************************/
+
+#include <cstdlib>
+#include <cstring>
+#include "rib_arena.h"
+
+using namespace rib;
+
+namespace {
+
+// Blocks double from the first size up to the last, anything bigger
+// than a quarter of that gets a block of its own.
+const size_t kFirstBlock = 1 << 12;
+const size_t kLastBlock = 1 << 20;
+const size_t kLargeSize = kLastBlock / 4;
+
+const size_t kAlign = alignof(std::max_align_t);
+// keeps what follows a block's header aligned for anything
+const size_t kHeader = (sizeof(void *) * 2 + kAlign - 1) & ~(kAlign - 1);
+
+} // namespace
+
+Arena::Block *Arena::newBlock(size_t size)
+{
+	Block *block = (Block *) malloc(kHeader + size);
+	if (block == nullptr)
+		throw std::bad_alloc();
+	block->size = size;
+	blocks_count_++;
+	reserved_ += size;
+	return block;
+}
+
+void *Arena::allocateSlow(size_t size, size_t align)
+{
+	if (size + align > kLargeSize) {
+		Block *block = newBlock(size + align);
+		block->next = large_;
+		large_ = block;
+		char *data = (char *) block + kHeader;
+		if (align > kAlign)
+			data = (char *) (((uintptr_t) data + align - 1) &
+							~(uintptr_t) (align - 1));
+		last_ = data;
+		return data;
+	}
+
+	next_size_ = next_size_ == 0 ? kFirstBlock
+				: std::min(next_size_ * 2, kLastBlock);
+	while (next_size_ < size + align)
+		next_size_ *= 2;
+	Block *block = newBlock(next_size_);
+	block->next = small_;
+	small_ = block;
+	pos_ = (char *) block + kHeader;
+	end_ = pos_ + block->size;
+
+	char *data = (char *) (((uintptr_t) pos_ + align - 1) &
+						~(uintptr_t) (align - 1));
+	pos_ = data + size;
+	last_ = data;
+	return data;
+}
+
+void *Arena::reallocate(void *data, size_t size, size_t new_size,
+				size_t align)
+{
+	if (data == nullptr)
+		return allocate(new_size, align);
+
+	// the last bump can simply go on
+	char *bytes = (char *) data;
+	if (bytes == last_ && bytes + size == pos_ &&
+	    new_size <= (size_t) (end_ - bytes)) {
+		pos_ = bytes + new_size;
+		return data;
+	}
+	// and the last large block can move as a whole
+	if (large_ != nullptr && bytes == (char *) large_ + kHeader &&
+	    align <= kAlign) {
+		Block *block = (Block *) realloc(large_, kHeader + new_size);
+		if (block == nullptr)
+			throw std::bad_alloc();
+		reserved_ += new_size - block->size;
+		block->size = new_size;
+		large_ = block;
+		last_ = (char *) block + kHeader;
+		return last_;
+	}
+
+	void *moved = allocate(new_size, align);
+	memcpy(moved, data, std::min(size, new_size));
+	return moved;
+}
+
+void Arena::addFinalizer(void *object, void (*destroy)(void *))
+{
+	Finalizer *finalizer = (Finalizer *) allocate(sizeof(Finalizer),
+							alignof(Finalizer));
+	finalizer->next = finalizers_;
+	finalizer->destroy = destroy;
+	finalizer->object = object;
+	finalizers_ = finalizer;
+}
+
+// The other arena's blocks go behind the current ones, so the last
+// allocation here stays the last.
+void Arena::absorb(Arena *other)
+{
+	if (small_ == nullptr) {
+		small_ = other->small_;
+		pos_ = other->pos_;
+		end_ = other->end_;
+		next_size_ = other->next_size_;
+	} else if (other->small_ != nullptr) {
+		Block *tail = other->small_;
+		while (tail->next != nullptr)
+			tail = tail->next;
+		tail->next = small_->next;
+		small_->next = other->small_;
+	}
+	if (large_ == nullptr) {
+		large_ = other->large_;
+	} else if (other->large_ != nullptr) {
+		Block *tail = other->large_;
+		while (tail->next != nullptr)
+			tail = tail->next;
+		tail->next = large_->next;
+		large_->next = other->large_;
+	}
+	if (other->finalizers_ != nullptr) {
+		Finalizer *tail = other->finalizers_;
+		while (tail->next != nullptr)
+			tail = tail->next;
+		tail->next = finalizers_;
+		finalizers_ = other->finalizers_;
+	}
+	allocations_ += other->allocations_;
+	blocks_count_ += other->blocks_count_;
+	reserved_ += other->reserved_;
+
+	other->small_ = nullptr;
+	other->large_ = nullptr;
+	other->finalizers_ = nullptr;
+	other->pos_ = other->end_ = other->last_ = nullptr;
+	other->next_size_ = 0;
+	other->allocations_ = 0;
+	other->blocks_count_ = 0;
+	other->reserved_ = 0;
+}
+
+void Arena::release()
+{
+	// latest first, as they would be if they were on the stack
+	for (Finalizer *f = finalizers_; f != nullptr; f = f->next)
+		f->destroy(f->object);
+	finalizers_ = nullptr;
+
+	Block *lists[] = { small_, large_ };
+	for (size_t i = 0; i < 2; i++) {
+		for (Block *block = lists[i]; block != nullptr; ) {
+			Block *next = block->next;
+			free(block);
+			block = next;
+		}
+	}
+	small_ = nullptr;
+	large_ = nullptr;
+	pos_ = end_ = last_ = nullptr;
+	next_size_ = 0;
+	allocations_ = 0;
+	blocks_count_ = 0;
+	reserved_ = 0;
+}
@@ -0,0 +1,249 @@
+/* ************************************************************************
+ * Copyright 2017 Alexander Mishurov
+ * 
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ * 
+ * http://www.apache.org/licenses/LICENSE-2.0
+ * 
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ * ************************************************************************/
+
+#ifndef MAYAPLUGIN_RIBARENA_H_
+#define MAYAPLUGIN_RIBARENA_H_
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <new>
+#include <type_traits>
+#include <utility>
+
+namespace rib {
+
+// Hands out memory by bumping a pointer through blocks taken from the
+// heap, and gives it all back at once. Objects that need destroying
+// are destroyed then too, those that don't are never visited. Not
+// safe to share between threads, a thread fills one arena of its own
+// and absorb() hands it over.
+class Arena {
+public:
+	Arena() = default;
+	Arena(const Arena &) = delete;
+	Arena &operator=(const Arena &) = delete;
+	~Arena() { release(); }
+
+	void *allocate(size_t size, size_t align = alignof(std::max_align_t))
+	{
+		allocations_++;
+		char *data = (char *) (((uintptr_t) pos_ + align - 1) &
+							~(uintptr_t) (align - 1));
+		if (pos_ == nullptr || size > (size_t) (end_ - data))
+			return allocateSlow(size, align);
+		pos_ = data + size;
+		last_ = data;
+		return data;
+	}
+	// Resizes what allocate() returned last in place if it can,
+	// elsewhere otherwise, the old copy is given up.
+	void *reallocate(void *data, size_t size, size_t new_size,
+				size_t align = alignof(std::max_align_t));
+	// whether reallocate() would resize the data in place
+	bool isLast(const void *data) const
+		{ return data != nullptr && data == last_; }
+
+	template<typename T, typename... Args>
+	T *create(Args&&... args)
+	{
+		void *memory = allocate(sizeof(T), alignof(T));
+		T *object = new (memory) T(std::forward<Args>(args)...);
+		if (!std::is_trivially_destructible<T>::value)
+			addFinalizer(object, &Destroy<T>);
+		return object;
+	}
+
+	// Takes over everything the other arena holds, which is left
+	// empty.
+	void absorb(Arena *other);
+	// Destroys the objects and frees the blocks.
+	void release();
+
+	// allocate() calls and blocks taken from the heap so far
+	size_t allocations() const { return allocations_; }
+	size_t blocks() const { return blocks_count_; }
+	// bytes taken from the heap
+	size_t reserved() const { return reserved_; }
+private:
+	struct Block {
+		Block *next;
+		size_t size;
+	};
+	struct Finalizer {
+		Finalizer *next;
+		void (*destroy)(void *);
+		void *object;
+	};
+
+	template<typename T>
+	static void Destroy(void *object) { ((T *) object)->~T(); }
+
+	void *allocateSlow(size_t size, size_t align);
+	Block *newBlock(size_t size);
+	void addFinalizer(void *object, void (*destroy)(void *));
+
+	// the blocks pointers are bumped through, the current one first
+	Block *small_ = nullptr;
+	// allocations too large to share a block, the latest first
+	Block *large_ = nullptr;
+	Finalizer *finalizers_ = nullptr;
+	char *pos_ = nullptr;
+	char *end_ = nullptr;
+	char *last_ = nullptr;
+	size_t next_size_ = 0;
+	size_t allocations_ = 0;
+	size_t blocks_count_ = 0;
+	size_t reserved_ = 0;
+};
+
+// A vector whose elements live in an arena. Whatever grows it passes
+// the arena along, readers need nothing but the array. It owns no
+// memory, so it has nothing to destroy and a node made of arrays
+// doesn't either.
+template<typename T>
+class Array {
+	static_assert(std::is_trivially_destructible<T>::value,
+			"arena arrays are never destroyed");
+public:
+	typedef T value_type;
+	typedef T *iterator;
+	typedef const T *const_iterator;
+
+	Array() = default;
+	Array(const Array &) = delete;
+	Array &operator=(const Array &) = delete;
+	Array(Array &&other)
+	: data_(other.data_), size_(other.size_), capacity_(other.capacity_)
+		{ other.data_ = nullptr; other.size_ = other.capacity_ = 0; }
+	Array &operator=(Array &&other)
+	{
+		std::swap(data_, other.data_);
+		std::swap(size_, other.size_);
+		std::swap(capacity_, other.capacity_);
+		return *this;
+	}
+
+	iterator begin() { return data_; }
+	iterator end() { return data_ + size_; }
+	const_iterator begin() const { return data_; }
+	const_iterator end() const { return data_ + size_; }
+	T *data() { return data_; }
+	const T *data() const { return data_; }
+	size_t size() const { return size_; }
+	bool empty() const { return size_ == 0; }
+	T &operator[](size_t i) { return data_[i]; }
+	const T &operator[](size_t i) const { return data_[i]; }
+	T &back() { return data_[size_ - 1]; }
+	const T &back() const { return data_[size_ - 1]; }
+
+	void push_back(const T &value, Arena *arena)
+	{
+		if (size_ == capacity_)
+			grow(size_ + 1, arena);
+		new (data_ + size_++) T(value);
+	}
+	void push_back(T &&value, Arena *arena)
+	{
+		if (size_ == capacity_)
+			grow(size_ + 1, arena);
+		new (data_ + size_++) T(std::move(value));
+	}
+	void assign(const T *values, size_t count, Arena *arena)
+	{
+		clear();
+		reserve(count, arena);
+		std::uninitialized_copy(values, values + count, data_);
+		size_ = count;
+	}
+	void reserve(size_t count, Arena *arena)
+	{
+		if (count > capacity_)
+			setCapacity(count, arena);
+	}
+	void resize(size_t count, Arena *arena)
+	{
+		reserve(count, arena);
+		for (size_t i = size_; i < count; i++)
+			new (data_ + i) T();
+		size_ = count;
+	}
+	// keeps the memory for what is added next
+	void clear() { size_ = 0; }
+	// Gives the capacity beyond the size back to the arena, which can
+	// only take back what it handed out last.
+	void shrink(Arena *arena)
+	{
+		if (std::is_trivially_copyable<T>::value &&
+		    size_ < capacity_ && arena->isLast(data_))
+			setCapacity(size_, arena);
+	}
+	// The elements converted where they are to a type of the same
+	// size, this array is left empty.
+	template<typename U>
+	Array<U> convert();
+private:
+	template<typename U> friend class Array;
+
+	void grow(size_t count, Arena *arena)
+		{ setCapacity(std::max(count, capacity_ * 2 + 4), arena); }
+	void setCapacity(size_t capacity, Arena *arena);
+
+	T *data_ = nullptr;
+	size_t size_ = 0;
+	size_t capacity_ = 0;
+};
+
+template<typename T>
+template<typename U>
+Array<U> Array<T>::convert()
+{
+	static_assert(sizeof(U) == sizeof(T) && alignof(U) <= alignof(T),
+			"elements are converted in place");
+	for (size_t i = 0; i < size_; i++) {
+		U value = (U) data_[i];
+		new (data_ + i) U(value);
+	}
+	Array<U> converted;
+	converted.data_ = (U *) data_;
+	converted.size_ = size_;
+	converted.capacity_ = capacity_;
+	data_ = nullptr;
+	size_ = capacity_ = 0;
+	return converted;
+}
+
+template<typename T>
+void Array<T>::setCapacity(size_t capacity, Arena *arena)
+{
+	// only what can be copied bytewise may move with the memory
+	if (std::is_trivially_copyable<T>::value) {
+		data_ = (T *) arena->reallocate(data_, capacity_ * sizeof(T),
+					capacity * sizeof(T), alignof(T));
+	} else {
+		T *data = (T *) arena->allocate(capacity * sizeof(T),
+							alignof(T));
+		for (size_t i = 0; i < size_; i++)
+			new (data + i) T(std::move(data_[i]));
+		data_ = data;
+	}
+	capacity_ = capacity;
+}
+
+} /* namespace rib */
+
+#endif  // MAYAPLUGIN_RIBARENA_H_
@@ -0,0 +1,479 @@
+/* ************************************************************************
+ * Copyright 2017 Alexander Mishurov
+ * 
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ * 
+ * http://www.apache.org/licenses/LICENSE-2.0
+ * 
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ * ************************************************************************/
+
+#include <algorithm>
+#include <climits>
+#include <cstdint>
+#include <cstring>
+#include "rib_binary.h"
+#include "rib_number.h"
+
+using namespace rib;
+using token = rib::Parser::token;
+
+namespace {
+
+const size_t kChunkSize = 1 << 16;
+// enough for any number written by a sane exporter, longer ones
+// just take another refill
+const size_t kNumberSize = 64;
+// how far into a stream to look for binary tokens
+const size_t kSniffSize = 4096;
+
+// the requests rib_lexer.l knows about
+const std::map<std::string, int> &Keywords()
+{
+	static const std::map<std::string, int> keywords = {
+		{ "Display", token::DISPLAY },
+		{ "Format", token::FORMAT },
+		{ "Projection", token::PROJECTION },
+		{ "Option", token::OPTION },
+		{ "version", token::VERSION },
+		{ "Hider", token::HIDER },
+		{ "Integrator", token::INTEGRATOR },
+		{ "Exposure", token::EXPOSURE },
+		{ "PixelVariance", token::PIXEL_VARIANCE },
+		{ "PixelSamples", token::PIXEL_SAMPLES },
+		{ "PixelFilter", token::PIXEL_FILTER },
+		{ "ShadingRate", token::SHADING_RATE },
+		{ "ScopedCoordinateSystem", token::SCOPED_COORDINATE_SYSTEM },
+		{ "Translate", token::TRANSLATE },
+		{ "Rotate", token::ROTATE },
+		{ "Scale", token::SCALE },
+		{ "ConcatTransform", token::CONCAT_TRANSFORM },
+		{ "WorldBegin", token::WORLD_BEGIN },
+		{ "WorldEnd", token::WORLD_END },
+		{ "AttributeBegin", token::ATTRIBUTE_BEGIN },
+		{ "AttributeEnd", token::ATTRIBUTE_END },
+		{ "Attribute", token::ATTRIBUTE },
+		{ "TransformBegin", token::TRANSFORM_BEGIN },
+		{ "TransformEnd", token::TRANSFORM_END },
+		{ "LightSource", token::LIGHT_SOURCE },
+		{ "AreaLightSource", token::AREA_LIGHT_SOURCE },
+		{ "Surface", token::SURFACE },
+		{ "Geometry", token::GEOMETRY },
+		{ "Color", token::COLOR },
+		{ "Opacity", token::OPACITY },
+		{ "Sides", token::SIDES },
+		{ "Orientation", token::ORIENTATION },
+		{ "Hyperboloid", token::HYPERBOLOID },
+		{ "Paraboloid", token::PARABOLOID },
+		{ "Torus", token::TORUS },
+		{ "Cylinder", token::CYLINDER },
+		{ "Sphere", token::SPHERE },
+		{ "Disk", token::DISK },
+		{ "Cone", token::CONE },
+		{ "PointsGeneralPolygons", token::POINTS_GENERAL_POLYGONS },
+		{ "PointsPolygons", token::POINTS_POLYGONS },
+		{ "Pattern", token::PATTERN },
+		{ "Bxdf", token::BXDF },
+		{ "Light", token::LIGHT },
+		{ "ReadArchive", token::READ_ARCHIVE },
+		{ "Procedural", token::PROCEDURAL },
+		{ "Procedural2", token::PROCEDURAL2 }
+	};
+	return keywords;
+}
+
+inline bool IsDigit(char c)
+{
+	return (unsigned char) (c - '0') < 10;
+}
+
+inline bool IsWordChar(char c)
+{
+	return (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') ||
+		IsDigit(c) || c == '_';
+}
+
+inline float BigEndianFloat(const char *p)
+{
+	const unsigned char *u = (const unsigned char *) p;
+	uint32_t bits = ((uint32_t) u[0] << 24) | ((uint32_t) u[1] << 16) |
+			((uint32_t) u[2] << 8) | (uint32_t) u[3];
+	float value;
+	memcpy(&value, &bits, sizeof(value));
+	return value;
+}
+
+inline double BigEndianDouble(const char *p)
+{
+	const unsigned char *u = (const unsigned char *) p;
+	uint64_t bits = 0;
+	for (int i = 0; i < 8; i++)
+		bits = (bits << 8) | u[i];
+	double value;
+	memcpy(&value, &bits, sizeof(value));
+	return value;
+}
+
+} // namespace
+
+bool rib::IsBinaryRib(const char *data, size_t size)
+{
+	const char *p = data;
+	const char *end = data + std::min(size, kSniffSize);
+	while (p < end) {
+		if ((unsigned char) *p >= 0x80)
+			return true;
+		// comments and strings may well hold UTF-8
+		if (*p == '#') {
+			while (p < end && *p != '\n')
+				p++;
+		} else if (*p == '"') {
+			for (p++; p < end && *p != '"'; p++) {
+				if (*p == '\\')
+					p++;
+			}
+			p++;
+		} else {
+			p++;
+		}
+	}
+	return false;
+}
+
+bool BinaryLexer::ensure(size_t count)
+{
+	if (end_ - pos_ >= count)
+		return true;
+	if (pos_ > 0) {
+		memmove(buf_.data(), buf_.data() + pos_, end_ - pos_);
+		end_ -= pos_;
+		pos_ = 0;
+	}
+	if (buf_.size() < kChunkSize)
+		buf_.resize(kChunkSize);
+	// grown as the input fills it rather than to count up front, a
+	// corrupt length can't ask for more than the input holds
+	while (end_ < count && !eof_) {
+		if (end_ == buf_.size())
+			buf_.resize(std::min(count, buf_.size() * 2));
+		size_t room = std::min(buf_.size() - end_, (size_t) INT_MAX);
+		int read = LexerInput(buf_.data() + end_, (int) room);
+		if (read <= 0)
+			eof_ = true;
+		else
+			end_ += read;
+	}
+	return end_ >= count;
+}
+
+unsigned long BinaryLexer::readUnsigned(size_t count)
+{
+	unsigned long value = 0;
+	for (size_t i = 0; i < count; i++)
+		value = (value << 8) | (unsigned char) buf_[pos_++];
+	return value;
+}
+
+bool BinaryLexer::readString(size_t size, std::string *str)
+{
+	if (!ensure(size))
+		return false;
+	str->assign(buf_.data() + pos_, size);
+	pos_ += size;
+	return true;
+}
+
+// the string operand of a definition, binary or quoted
+bool BinaryLexer::readStringToken(std::string *str)
+{
+	while (ensure(1)) {
+		unsigned char c = buf_[pos_];
+		if (c == ' ' || c == '\t' || c == '\r' || c == '\n') {
+			pos_++;
+			continue;
+		}
+		if (c == '"') {
+			size_t size;
+			if (!readQuoted(&size, nullptr))
+				return false;
+			str->assign(buf_.data() + pos_ + 1, size);
+			pos_ += size + 2;
+			return true;
+		}
+		pos_++;
+		if (c >= 0x90 && c <= 0x9F)
+			return readString(c & 0x0F, str);
+		if (c >= 0xA0 && c <= 0xA3) {
+			size_t count = (c & 0x03) + 1;
+			return ensure(count) && readString(readUnsigned(count), str);
+		}
+		return false;
+	}
+	return false;
+}
+
+int BinaryLexer::readFloatArray(rib::Parser::semantic_type * const lval,
+				size_t count)
+{
+	// not reserved from count, which comes from the stream, the
+	// array grows as the floats arrive
+	Array<float> *values = newArray<float>();
+	while (values->size() < count) {
+		if (!ensure(sizeof(float))) {
+			drop(values);
+			return token::UNKNOWN;
+		}
+		size_t take = std::min(count - values->size(),
+					(end_ - pos_) / sizeof(float));
+		for (size_t i = 0; i < take; i++) {
+			values->push_back(BigEndianFloat(buf_.data() + pos_),
+								arena());
+			pos_ += sizeof(float);
+		}
+	}
+	lval->build<Array<float>*>(values);
+	return token::FLOAT_ARRAY;
+}
+
+int BinaryLexer::readNumber(rib::Parser::semantic_type * const lval,
+				rib::Parser::location_type *loc)
+{
+	Decimal d;
+	const char *begin;
+	const char *p;
+	for (size_t want = kNumberSize;; want *= 2) {
+		ensure(want);
+		d = Decimal();
+		begin = buf_.data() + pos_;
+		const char *end = buf_.data() + end_;
+		p = ScanDecimal(begin, end, &d);
+		if (p < end || eof_)
+			break;
+	}
+	if (std::find_if(begin, p, IsDigit) == p) {
+		pos_++;
+		loc->columns();
+		return token::UNKNOWN;
+	}
+	pos_ += p - begin;
+	loc->columns(p - begin);
+
+	int value;
+	if (DecimalToInt(d, &value)) {
+		lval->build<int>(value);
+		return token::INT;
+	}
+	lval->build<float>(DecimalToFloat(d, begin, p));
+	return token::FLOAT;
+}
+
+int BinaryLexer::readWord(rib::Parser::location_type *loc)
+{
+	size_t size = 0;
+	for (size_t want = kNumberSize;; want *= 2) {
+		ensure(want);
+		while (pos_ + size < end_ && IsWordChar(buf_[pos_ + size]))
+			size++;
+		if (pos_ + size < end_ || eof_)
+			break;
+	}
+	std::string word(buf_.data() + pos_, size);
+	pos_ += size;
+	loc->columns(size);
+	return requestToken(word);
+}
+
+// Buffers a whole quoted string, its text starts at pos_ + 1
+bool BinaryLexer::readQuoted(size_t *size, rib::Parser::location_type *loc)
+{
+	size_t end = 1;
+	for (;;) {
+		if (!ensure(end + 1))
+			return false;
+		char c = buf_[pos_ + end];
+		if (c == '"')
+			break;
+		if (c == '\n' && loc != nullptr)
+			loc->lines();
+		end += c == '\\' ? 2 : 1;
+	}
+	*size = end - 1;
+	if (loc != nullptr)
+		loc->columns(end + 1);
+	return true;
+}
+
+int BinaryLexer::requestToken(const std::string &name)
+{
+	const std::map<std::string, int> &keywords = Keywords();
+	std::map<std::string, int>::const_iterator it = keywords.find(name);
+	return it == keywords.end() ? (int) token::UNKNOWN : it->second;
+}
+
+int BinaryLexer::yylex(rib::Parser::semantic_type * const lval,
+			rib::Parser::location_type *loc)
+{
+	for (;;) {
+		loc->step();
+		if (!ensure(1))
+			return token::END;
+
+		unsigned char c = buf_[pos_];
+		if (c < 0x80) {
+			switch (c) {
+			case '\n':
+				pos_++;
+				loc->lines();
+				continue;
+			case ' ':
+			case '\t':
+			case '\r':
+				pos_++;
+				loc->columns();
+				continue;
+			case '#':
+				while (ensure(1) && buf_[pos_] != '\n')
+					pos_++;
+				continue;
+			case '[':
+				pos_++;
+				loc->columns();
+				return token::LEFT_SQUARE_BRACKET;
+			case ']':
+				pos_++;
+				loc->columns();
+				return token::RIGHT_SQUARE_BRACKET;
+			case '"':
+				{
+					size_t size;
+					if (!readQuoted(&size, loc))
+						return token::UNKNOWN;
+					lval->build<Symbol>(symbols_.intern(
+						buf_.data() + pos_ + 1, size));
+					pos_ += size + 2;
+					return token::STRING;
+				}
+			}
+			if (IsDigit(c) || c == '-' || c == '+' || c == '.')
+				return readNumber(lval, loc);
+			if (IsWordChar(c))
+				return readWord(loc);
+			pos_++;
+			loc->columns();
+			return token::UNKNOWN;
+		}
+
+		pos_++;
+		loc->columns();
+		if (c <= 0x8F) {
+			// integer or fixed point, w + 1 bytes,
+			// d of them after the binary point
+			size_t w = (c & 0x03) + 1;
+			int d = (c >> 2) & 0x03;
+			if (!ensure(w))
+				return token::UNKNOWN;
+			int64_t sign = (int64_t) 1 << (8 * w - 1);
+			int64_t value = ((int64_t) readUnsigned(w) ^ sign) - sign;
+			if (d == 0 && value >= INT_MIN && value <= INT_MAX) {
+				lval->build<int>((int) value);
+				return token::INT;
+			}
+			lval->build<float>((float) value / (float) (1 << (8 * d)));
+			return token::FLOAT;
+		}
+		if (c <= 0xA3) {
+			// short strings carry the length in the code itself
+			size_t size = c & 0x0F;
+			if (c >= 0xA0) {
+				size_t count = (c & 0x03) + 1;
+				if (!ensure(count))
+					return token::UNKNOWN;
+				size = readUnsigned(count);
+			}
+			if (!ensure(size))
+				return token::UNKNOWN;
+			lval->build<Symbol>(
+				symbols_.intern(buf_.data() + pos_, size));
+			pos_ += size;
+			return token::STRING;
+		}
+		switch (c) {
+		case 0xA4:
+			if (!ensure(4))
+				return token::UNKNOWN;
+			lval->build<float>(BigEndianFloat(buf_.data() + pos_));
+			pos_ += 4;
+			return token::FLOAT;
+		case 0xA5:
+			if (!ensure(8))
+				return token::UNKNOWN;
+			lval->build<float>((float) BigEndianDouble(buf_.data() + pos_));
+			pos_ += 8;
+			return token::FLOAT;
+		case 0xA6:
+			{
+				if (!ensure(1))
+					return token::UNKNOWN;
+				int code = (unsigned char) buf_[pos_++];
+				std::map<int, std::string>::const_iterator it =
+							requests_.find(code);
+				if (it == requests_.end())
+					return token::UNKNOWN;
+				return requestToken(it->second);
+			}
+		case 0xC8:
+		case 0xC9:
+		case 0xCA:
+		case 0xCB:
+			{
+				size_t count = (c & 0x03) + 1;
+				if (!ensure(count))
+					return token::UNKNOWN;
+				return readFloatArray(lval, readUnsigned(count));
+			}
+		case 0xCC:
+			{
+				if (!ensure(1))
+					return token::UNKNOWN;
+				int code = (unsigned char) buf_[pos_++];
+				if (!readStringToken(&requests_[code]))
+					return token::UNKNOWN;
+				continue;
+			}
+		case 0xCD:
+		case 0xCE:
+			{
+				size_t count = c - 0xCD + 1;
+				if (!ensure(count))
+					return token::UNKNOWN;
+				unsigned long id = readUnsigned(count);
+				std::string str;
+				if (!readStringToken(&str))
+					return token::UNKNOWN;
+				strings_[id] = symbols_.intern(str);
+				continue;
+			}
+		case 0xCF:
+		case 0xD0:
+			{
+				size_t count = c - 0xCF + 1;
+				if (!ensure(count))
+					return token::UNKNOWN;
+				std::map<unsigned long, Symbol>::const_iterator
+					it = strings_.find(readUnsigned(count));
+				if (it == strings_.end())
+					return token::UNKNOWN;
+				lval->build<Symbol>(it->second);
+				return token::STRING;
+			}
+		}
+		// reserved codes
+		return token::UNKNOWN;
+	}
+}
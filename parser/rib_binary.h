@@ -0,0 +1,65 @@
+/* ************************************************************************
+ * Copyright 2017 Alexander Mishurov
+ * 
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ * 
+ * http://www.apache.org/licenses/LICENSE-2.0
+ * 
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ * ************************************************************************/
+
+#ifndef MAYAPLUGIN_RIBBINARY_H_
+#define MAYAPLUGIN_RIBBINARY_H_
+
+#include <map>
+#include <string>
+#include <vector>
+#include "parser/rib_lexer.h"
+
+namespace rib {
+
+// True if the start of a stream contains binary encoded tokens.
+bool IsBinaryRib(const char *data, size_t size);
+
+// Lexer for the binary RIB encoding, RenderMan Interface Specification
+// 3.2, appendix C. It hands the parser the same tokens the flex lexer
+// does. The spec lets binary and ASCII tokens mix in one stream, so
+// plain text is lexed here as well.
+class BinaryLexer : public Lexer {
+public:
+	BinaryLexer(Input *input, SymbolTable *symbols)
+	: Lexer(input, symbols) {}
+	virtual ~BinaryLexer() {}
+
+	virtual int yylex(rib::Parser::semantic_type * const lval,
+			  rib::Parser::location_type *loc);
+private:
+	bool ensure(size_t count);
+	unsigned long readUnsigned(size_t count);
+	bool readString(size_t size, std::string *str);
+	bool readStringToken(std::string *str);
+	int readFloatArray(rib::Parser::semantic_type * const lval,
+				size_t count);
+	int readNumber(rib::Parser::semantic_type * const lval,
+			rib::Parser::location_type *loc);
+	int readWord(rib::Parser::location_type *loc);
+	bool readQuoted(size_t *size, rib::Parser::location_type *loc);
+	int requestToken(const std::string &name);
+
+	std::vector<char> buf_;
+	size_t pos_ = 0;
+	size_t end_ = 0;
+	bool eof_ = false;
+	std::map<int, std::string> requests_;
+	std::map<unsigned long, Symbol> strings_;
+};
+
+} /* namespace rib */
+
+#endif  // MAYAPLUGIN_RIBBINARY_H_
@@ -0,0 +1,316 @@
+/* ************************************************************************
+ * Copyright 2017 Alexander Mishurov
+ * 
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ * 
+ * http://www.apache.org/licenses/LICENSE-2.0
+ * 
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ * ************************************************************************/
+
+#include <algorithm>
+#include <cmath>
+#include "rib_bvh.h"
+
+using namespace rib;
+
+namespace {
+
+// nodes a leaf holds at most
+const size_t kLeafSize = 4;
+
+// about the z axis, radius out and from zmin to zmax
+Bound Sweep(float radius, float zmin, float zmax)
+{
+	radius = std::fabs(radius);
+	const float low[] = { -radius, -radius, std::min(zmin, zmax) };
+	const float high[] = { radius, radius, std::max(zmin, zmax) };
+	Bound bound;
+	bound.add(low);
+	bound.add(high);
+	return bound;
+}
+
+Bound SphereBound(const float *row)
+{
+	float radius = std::fabs(row[0]);
+	float zmin = std::max(std::min(row[1], row[2]), -radius);
+	float zmax = std::min(std::max(row[1], row[2]), radius);
+	if (zmin > zmax)
+		return Sweep(radius, -radius, radius);
+	return Sweep(radius, zmin, zmax);
+}
+
+Bound ParaboloidBound(const float *row)
+{
+	// r = rmax sqrt(z / zmax) grows past rmax if zmin is further out
+	float zmax = std::fabs(row[2]);
+	float reach = std::max(std::fabs(row[1]), zmax);
+	float radius = row[0];
+	if (zmax > 0.0f)
+		radius *= std::sqrt(reach / zmax);
+	return Sweep(radius, row[1], row[2]);
+}
+
+Bound HyperboloidBound(const float *row)
+{
+	// the line's distance from the axis is largest at an end
+	float radius = std::max(std::hypot(row[0], row[1]),
+				std::hypot(row[3], row[4]));
+	return Sweep(radius, row[2], row[5]);
+}
+
+Bound MeshBound(const FlatScene &scene, size_t node)
+{
+	Bound bound;
+	const FlatMesh &mesh = scene.meshes[scene.items[node]];
+	const FlatPrimvar *P = scene.findPrimvar(mesh, kSymbolP);
+	if (P == nullptr || P->declaration.type == kString)
+		return bound;
+	const float *values = scene.data.data() + P->values.begin;
+	for (size_t i = 0; i + 3 <= P->values.size(); i += 3)
+		bound.add(values + i);
+	return bound;
+}
+
+Bound ArchiveBound(const FlatScene &scene, size_t node)
+{
+	Bound bound;
+	const FlatArchive &archive = scene.archives[scene.items[node]];
+	// what a read archive holds has bounds of its own
+	if (scene.ends[node] > node + 1 || archive.bound.size() != 6)
+		return bound;
+	const float *values = scene.data.data() + archive.bound.begin;
+	const float low[] = { values[0], values[2], values[4] };
+	const float high[] = { values[1], values[3], values[5] };
+	bound.add(low);
+	bound.add(high);
+	return bound;
+}
+
+float Center(const Bound &bound, int axis)
+{
+	return (bound.min[axis] + bound.max[axis]) * 0.5f;
+}
+
+} // namespace
+
+void Bound::add(const float *point)
+{
+	for (int i = 0; i < 3; i++) {
+		min[i] = std::min(min[i], point[i]);
+		max[i] = std::max(max[i], point[i]);
+	}
+}
+
+void Bound::add(const Bound &other)
+{
+	if (other.empty())
+		return;
+	add(other.min);
+	add(other.max);
+}
+
+Bound Bound::transformed(const Matrix &matrix) const
+{
+	Bound bound;
+	if (empty())
+		return bound;
+	for (int i = 0; i < 8; i++) {
+		const float corner[] = {
+			(i & 1) ? max[0] : min[0],
+			(i & 2) ? max[1] : min[1],
+			(i & 4) ? max[2] : min[2]
+		};
+		float point[3];
+		matrix.transform(corner, point);
+		bound.add(point);
+	}
+	return bound;
+}
+
+Bound rib::LocalBound(const FlatScene &scene, size_t node)
+{
+	const float *row = scene.row(node);
+	switch (scene.type(node)) {
+	case kSphere:
+		return SphereBound(row);
+	case kCone:
+		return Sweep(row[1], 0.0f, row[0]);
+	case kCylinder:
+		return Sweep(row[0], row[1], row[2]);
+	case kHyperboloid:
+		return HyperboloidBound(row);
+	case kParaboloid:
+		return ParaboloidBound(row);
+	case kDisk:
+		return Sweep(row[1], row[0], row[0]);
+	case kTorus:
+		return Sweep(std::fabs(row[0]) + std::fabs(row[1]),
+						-row[1], row[1]);
+	case kPointsPolygons:
+	case kPointsGeneralPolygons:
+		return MeshBound(scene, node);
+	case kArchive:
+		return ArchiveBound(scene, node);
+	default:
+		return Bound();
+	}
+}
+
+// Points are row vectors, so a point's clip coordinates are dot
+// products with the matrix's columns. A plane is w plus or minus one
+// of x, y and z.
+Frustum::Frustum(const Matrix &clip)
+{
+	for (int plane = 0; plane < 6; plane++) {
+		int axis = plane / 2;
+		float sign = (plane & 1) ? -1.0f : 1.0f;
+		for (int i = 0; i < 4; i++) {
+			planes_[plane][i] = clip.m[i][3] +
+						sign * clip.m[i][axis];
+		}
+	}
+}
+
+bool Frustum::overlaps(const Bound &bound) const
+{
+	if (bound.empty())
+		return false;
+	for (int plane = 0; plane < 6; plane++) {
+		const float *p = planes_[plane];
+		// the corner furthest in front
+		float distance = p[3];
+		for (int i = 0; i < 3; i++)
+			distance += p[i] * (p[i] > 0.0f ? bound.max[i]
+							: bound.min[i]);
+		if (distance < 0.0f)
+			return false;
+	}
+	return true;
+}
+
+void Bvh::clear()
+{
+	boxes_.clear();
+	nodes_.clear();
+	bounds_.clear();
+	where_.clear();
+}
+
+const Bound &Bvh::bound() const
+{
+	return boxes_.empty() ? empty_ : boxes_[0].bound;
+}
+
+const Bound &Bvh::bound(size_t node) const
+{
+	if (node >= where_.size() || where_[node] == 0)
+		return empty_;
+	return bounds_[where_[node] - 1];
+}
+
+// Splits the nodes of a box in half along the widest spread of their
+// centers until a box has few enough.
+void Bvh::build(const FlatScene &scene)
+{
+	clear();
+	for (size_t node = 0; node < scene.size(); node++) {
+		Bound bound = LocalBound(scene, node);
+		if (bound.empty())
+			continue;
+		nodes_.push_back((uint32_t) node);
+		bounds_.push_back(bound.transformed(scene.world(node)));
+	}
+	if (nodes_.empty())
+		return;
+
+	std::vector<uint32_t> order(nodes_.size());
+	for (size_t i = 0; i < order.size(); i++)
+		order[i] = (uint32_t) i;
+	boxes_.push_back({Bound(), 0, (uint32_t) order.size(), 0});
+	std::vector<uint32_t> stack(1, 0);
+	while (!stack.empty()) {
+		uint32_t index = stack.back();
+		stack.pop_back();
+		uint32_t begin = boxes_[index].begin;
+		uint32_t end = boxes_[index].end;
+		Bound bound;
+		Bound centers;
+		for (uint32_t i = begin; i < end; i++) {
+			const Bound &item = bounds_[order[i]];
+			bound.add(item);
+			const float center[] = {
+				Center(item, 0),
+				Center(item, 1),
+				Center(item, 2)
+			};
+			centers.add(center);
+		}
+		boxes_[index].bound = bound;
+		if (end - begin <= kLeafSize)
+			continue;
+		int axis = 0;
+		for (int i = 1; i < 3; i++) {
+			if (centers.max[i] - centers.min[i] >
+			    centers.max[axis] - centers.min[axis])
+				axis = i;
+		}
+		uint32_t middle = begin + (end - begin) / 2;
+		auto less = [&](uint32_t a, uint32_t b) {
+			return Center(bounds_[a], axis) <
+						Center(bounds_[b], axis);
+		};
+		std::nth_element(order.begin() + begin,
+				order.begin() + middle,
+				order.begin() + end, less);
+		uint32_t left = (uint32_t) boxes_.size();
+		boxes_[index].left = left;
+		boxes_.push_back({Bound(), begin, middle, 0});
+		boxes_.push_back({Bound(), middle, end, 0});
+		stack.push_back(left);
+		stack.push_back(left + 1);
+	}
+
+	std::vector<uint32_t> nodes(order.size());
+	std::vector<Bound> bounds(order.size());
+	for (size_t i = 0; i < order.size(); i++) {
+		nodes[i] = nodes_[order[i]];
+		bounds[i] = bounds_[order[i]];
+	}
+	nodes_.swap(nodes);
+	bounds_.swap(bounds);
+	where_.assign(scene.size(), 0);
+	for (size_t i = 0; i < nodes_.size(); i++)
+		where_[nodes_[i]] = (uint32_t) i + 1;
+}
+
+void Bvh::cull(const Frustum &frustum, std::vector<uint32_t> *nodes) const
+{
+	nodes->clear();
+	if (boxes_.empty())
+		return;
+	std::vector<uint32_t> stack(1, 0);
+	while (!stack.empty()) {
+		const Box &box = boxes_[stack.back()];
+		stack.pop_back();
+		if (!frustum.overlaps(box.bound))
+			continue;
+		if (box.left != 0) {
+			stack.push_back(box.left);
+			stack.push_back(box.left + 1);
+			continue;
+		}
+		for (uint32_t i = box.begin; i < box.end; i++) {
+			if (frustum.overlaps(bounds_[i]))
+				nodes->push_back(nodes_[i]);
+		}
+	}
+	std::sort(nodes->begin(), nodes->end());
+}
@@ -0,0 +1,97 @@
+/* ************************************************************************
+ * Copyright 2017 Alexander Mishurov
+ * 
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ * 
+ * http://www.apache.org/licenses/LICENSE-2.0
+ * 
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ * ************************************************************************/
+
+#ifndef MAYAPLUGIN_RIBBVH_H_
+#define MAYAPLUGIN_RIBBVH_H_
+
+#include <cfloat>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+#include "parser/rib_flat.h"
+#include "parser/rib_transform.h"
+
+namespace rib {
+
+// An axis aligned box, empty until a point is added.
+struct Bound {
+	float min[3] = { FLT_MAX, FLT_MAX, FLT_MAX };
+	float max[3] = { -FLT_MAX, -FLT_MAX, -FLT_MAX };
+
+	bool empty() const { return min[0] > max[0]; }
+	void add(const float *point);
+	void add(const Bound &other);
+	// the box around this one once the matrix has moved it
+	Bound transformed(const Matrix &matrix) const;
+};
+
+// What a node draws in its own space, worked out from its parameters
+// for a quadric and from P for a mesh. A delayed archive is its bound,
+// the rest are empty. A quadric's box is the one of its whole sweep.
+Bound LocalBound(const FlatScene &scene, size_t node);
+
+// The space a camera sees, as the six planes a box has to be in front
+// of to be seen.
+class Frustum {
+public:
+	// from a matrix taking points to clip space, a view and a
+	// projection in one
+	explicit Frustum(const Matrix &clip);
+	// false only if the box is wholly outside, a box across a corner
+	// may be kept
+	bool overlaps(const Bound &bound) const;
+private:
+	float planes_[6][4];
+};
+
+// A bounding volume hierarchy over the nodes of a flat scene that draw
+// something, in the scene's space.
+class Bvh {
+public:
+	// again whenever the scene changes
+	void build(const FlatScene &scene);
+	void clear();
+	// around everything, empty if nothing draws
+	const Bound &bound() const;
+	// around a node, empty if it draws nothing
+	const Bound &bound(size_t node) const;
+	// nodes with bounds
+	size_t size() const { return nodes_.size(); }
+	// The nodes the frustum may see, in the scene's order, replacing
+	// what was there.
+	void cull(const Frustum &frustum, std::vector<uint32_t> *nodes) const;
+private:
+	// a leaf holds the nodes from begin to end, the children of the
+	// others are left and left + 1
+	struct Box {
+		Bound bound;
+		uint32_t begin;
+		uint32_t end;
+		uint32_t left;
+	};
+
+	std::vector<Box> boxes_;
+	// scene nodes and their boxes, in the order of the leaves
+	std::vector<uint32_t> nodes_;
+	std::vector<Bound> bounds_;
+	// 1 + where each scene node is in nodes_, 0 if it isn't
+	std::vector<uint32_t> where_;
+	Bound empty_;
+};
+
+} /* namespace rib */
+
+#endif  // MAYAPLUGIN_RIBBVH_H_
@@ -0,0 +1,699 @@
+/* ************************************************************************
+ * Copyright 2017 Alexander Mishurov
+ * 
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ * 
+ * http://www.apache.org/licenses/LICENSE-2.0
+ * 
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ * ************************************************************************/
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <functional>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+#include "rib_cache.h"
+#include "rib_hash.h"
+#include "rib_walk.h"
+
+#ifdef _WIN32
+#include <process.h>
+#define getpid _getpid
+#else
+#include <unistd.h>
+#endif
+
+using namespace rib;
+
+namespace {
+
+// Bumped whenever the layout or the meaning of a node changes.
+const uint32_t kVersion = 2;
+const char kMagic[4] = { 'R', 'I', 'B', 'C' };
+// reads back differently on a machine of the other byte order
+const uint32_t kByteOrder = 0x01020304;
+
+// Nodes go out in preorder as their type, hash, values and child
+// count. Symbols are indices into a table of strings written first,
+// 0 is the empty symbol.
+class Writer {
+public:
+	void put(const void *data, size_t size)
+		{ out_.append((const char *) data, size); }
+	template<typename T>
+	void put(T value) { put(&value, sizeof(value)); }
+	void put(const std::string &str)
+	{
+		put((uint32_t) str.size());
+		put(str.data(), str.size());
+	}
+	void put(Symbol symbol)
+	{
+		uint32_t &index = indices_[symbol.id()];
+		if (index == 0 && !symbol.empty()) {
+			symbols_.push_back(symbol);
+			index = (uint32_t) symbols_.size();
+		}
+		put(index);
+	}
+	template<typename T>
+	void put(const Array<T> &values)
+	{
+		put((uint64_t) values.size());
+		put(values.data(), values.size() * sizeof(T));
+	}
+	void put(const Array<Symbol> &values)
+	{
+		put((uint64_t) values.size());
+		for (size_t i = 0; i < values.size(); i++)
+			put(values[i]);
+	}
+	template<typename T>
+	void put(const SymbolMap<T> &params)
+	{
+		put((uint32_t) params.size());
+		for (typename SymbolMap<T>::const_iterator it = params.begin();
+		     it != params.end(); ++it) {
+			put(it->first);
+			put(it->second);
+		}
+	}
+
+	void put(const PrimvarTable &primvars)
+	{
+		put((uint32_t) primvars.size());
+		for (PrimvarTable::const_iterator it = primvars.begin();
+		     it != primvars.end(); ++it) {
+			const Declaration &declaration = it->declaration;
+			put(declaration.key);
+			put(declaration.name);
+			put((uint8_t) declaration.storage);
+			put((uint8_t) declaration.type);
+			put(declaration.arity);
+			put(it->numbers);
+			put(it->strings);
+		}
+	}
+
+	// without its children
+	void putNode(const Node *node);
+
+	const std::string &bytes() const { return out_; }
+	const std::vector<Symbol> &symbols() const { return symbols_; }
+private:
+	std::string out_;
+	std::unordered_map<unsigned, uint32_t> indices_;
+	std::vector<Symbol> symbols_;
+};
+
+void Writer::putNode(const Node *node)
+{
+	put((uint8_t) node->type);
+	put(node->hash);
+	switch (node->type) {
+	case kJoint:
+		break;
+	case kTranslate:
+		{
+			const TranslateNode *n = (const TranslateNode *) node;
+			put(n->x); put(n->y); put(n->z);
+		}
+		break;
+	case kRotate:
+		{
+			const RotateNode *n = (const RotateNode *) node;
+			put(n->r); put(n->x); put(n->y); put(n->z);
+		}
+		break;
+	case kScale:
+		{
+			const ScaleNode *n = (const ScaleNode *) node;
+			put(n->x); put(n->y); put(n->z);
+		}
+		break;
+	case kConcatTransform:
+		put(((const ConcatTransformNode *) node)->matrix);
+		break;
+	case kHyperboloid:
+		{
+			const HyperboloidNode *n = (const HyperboloidNode *) node;
+			put(n->x1); put(n->y1); put(n->z1);
+			put(n->x2); put(n->y2); put(n->z2);
+			put(n->thetamax);
+		}
+		break;
+	case kParaboloid:
+		{
+			const ParaboloidNode *n = (const ParaboloidNode *) node;
+			put(n->rmax); put(n->zmin); put(n->zmax);
+			put(n->thetamax);
+		}
+		break;
+	case kTorus:
+		{
+			const TorusNode *n = (const TorusNode *) node;
+			put(n->rmajor); put(n->rminor);
+			put(n->phimin); put(n->phimax);
+			put(n->thetamax);
+		}
+		break;
+	case kCylinder:
+		{
+			const CylinderNode *n = (const CylinderNode *) node;
+			put(n->radius); put(n->zmin); put(n->zmax);
+			put(n->thetamax);
+		}
+		break;
+	case kSphere:
+		{
+			const SphereNode *n = (const SphereNode *) node;
+			put(n->radius); put(n->zmin); put(n->zmax);
+			put(n->thetamax);
+		}
+		break;
+	case kDisk:
+		{
+			const DiskNode *n = (const DiskNode *) node;
+			put(n->height); put(n->radius); put(n->thetamax);
+		}
+		break;
+	case kCone:
+		{
+			const ConeNode *n = (const ConeNode *) node;
+			put(n->height); put(n->radius); put(n->thetamax);
+		}
+		break;
+	case kPointsGeneralPolygons:
+		{
+			const PointsGeneralPolygonsNode *n =
+				(const PointsGeneralPolygonsNode *) node;
+			put(n->nloops);
+			put(n->nvertices);
+			put(n->vertices);
+			put(n->primvars);
+		}
+		break;
+	case kPointsPolygons:
+		{
+			const PointsPolygonsNode *n =
+				(const PointsPolygonsNode *) node;
+			put(n->nvertices);
+			put(n->vertices);
+			put(n->primvars);
+		}
+		break;
+	case kAttribute:
+	case kPattern:
+	case kBxdf:
+	case kLight:
+		{
+			const AttributeNode *n = (const AttributeNode *) node;
+			put(n->item_type);
+			put(n->name);
+			put(n->string_params);
+			put(n->float_params);
+		}
+		break;
+	case kArchive:
+		{
+			const ArchiveNode *n = (const ArchiveNode *) node;
+			put(n->filename);
+			put(n->bound);
+			put((uint8_t) n->delayed);
+		}
+		break;
+	}
+	put((uint64_t) node->children.size());
+}
+
+// the children follow their parent
+class TreeWriter : public Visitor {
+public:
+	TreeWriter(Writer *out) : out_(out) {}
+	bool enter(const Node *node)
+	{
+		out_->putNode(node);
+		return true;
+	}
+private:
+	Writer *out_;
+};
+
+// Reads from a mapping, every read is checked against its end and
+// the first one that doesn't fit fails the rest.
+class Reader {
+public:
+	Reader(const char *data, size_t size, Arena *arena)
+	: pos_(data), end_(data + size), arena_(arena) {}
+
+	bool ok() const { return ok_; }
+	bool atEnd() const { return pos_ == end_; }
+
+	bool get(void *data, size_t size)
+	{
+		if (!ok_ || size > (size_t) (end_ - pos_))
+			return ok_ = false;
+		memcpy(data, pos_, size);
+		pos_ += size;
+		return true;
+	}
+	template<typename T>
+	T get()
+	{
+		T value = T();
+		get(&value, sizeof(value));
+		return value;
+	}
+	std::string getString()
+	{
+		uint32_t size = get<uint32_t>();
+		if (!ok_ || size > (size_t) (end_ - pos_)) {
+			ok_ = false;
+			return std::string();
+		}
+		std::string str(pos_, size);
+		pos_ += size;
+		return str;
+	}
+	Symbol getSymbol()
+	{
+		uint32_t index = get<uint32_t>();
+		if (index > symbols_.size()) {
+			ok_ = false;
+			return Symbol();
+		}
+		return index == 0 ? Symbol() : symbols_[index - 1];
+	}
+	template<typename T>
+	Array<T> getArray()
+	{
+		uint64_t count = get<uint64_t>();
+		if (!ok_ || count > (uint64_t) (end_ - pos_) / sizeof(T)) {
+			ok_ = false;
+			return Array<T>();
+		}
+		Array<T> values;
+		values.resize((size_t) count, arena_);
+		get(values.data(), values.size() * sizeof(T));
+		return values;
+	}
+	Array<Symbol> getSymbols()
+	{
+		uint64_t count = get<uint64_t>();
+		// every symbol takes four bytes
+		if (!ok_ || count > (uint64_t) (end_ - pos_) / 4) {
+			ok_ = false;
+			return Array<Symbol>();
+		}
+		Array<Symbol> values;
+		values.reserve((size_t) count, arena_);
+		for (uint64_t i = 0; i < count && ok_; i++)
+			values.push_back(getSymbol(), arena_);
+		return values;
+	}
+	template<typename T>
+	void getParams(SymbolMap<T> *params, T (Reader::*read)())
+	{
+		uint32_t count = get<uint32_t>();
+		for (uint32_t i = 0; i < count && ok_; i++) {
+			Symbol key = getSymbol();
+			params->insert({key, (this->*read)()}, arena_);
+		}
+	}
+
+	void getPrimvars(PrimvarTable *primvars)
+	{
+		uint32_t count = get<uint32_t>();
+		for (uint32_t i = 0; i < count && ok_; i++) {
+			Declaration declaration;
+			declaration.key = getSymbol();
+			declaration.name = getSymbol();
+			uint8_t storage = get<uint8_t>();
+			uint8_t type = get<uint8_t>();
+			declaration.arity = get<uint32_t>();
+			if (storage > kFaceVertex || type > kMatrix ||
+			    declaration.arity == 0) {
+				ok_ = false;
+				return;
+			}
+			declaration.storage = (PrimvarClass) storage;
+			declaration.type = (PrimvarType) type;
+			Array<float> numbers = getArray<float>();
+			Array<Symbol> strings = getSymbols();
+			if (type == kString)
+				primvars->add(declaration, strings, arena_);
+			else
+				primvars->add(declaration, numbers, arena_);
+		}
+	}
+
+	void readSymbols(SymbolTable *table)
+	{
+		uint32_t count = get<uint32_t>();
+		for (uint32_t i = 0; i < count && ok_; i++)
+			symbols_.push_back(table->intern(getString()));
+	}
+	// Null once the data runs out or makes no sense, what was made
+	// so far goes with the arena.
+	Node *getTree(std::vector<ArchiveNode *> *archives);
+private:
+	const char *pos_;
+	const char *end_;
+	Arena *arena_;
+	bool ok_ = true;
+	std::vector<Symbol> symbols_;
+
+	// a node without its children
+	Node *getNode(Node *parent, std::vector<ArchiveNode *> *archives);
+};
+
+Node *Reader::getNode(Node *parent, std::vector<ArchiveNode *> *archives)
+{
+	uint8_t type = get<uint8_t>();
+	uint64_t hash = get<uint64_t>();
+	if (!ok_)
+		return nullptr;
+
+	Node *node = nullptr;
+	switch (type) {
+	case kJoint:
+		node = arena_->create<Node>(parent);
+		break;
+	case kTranslate:
+		{
+			float x = get<float>(), y = get<float>(), z = get<float>();
+			node = arena_->create<TranslateNode>(parent, x, y, z);
+		}
+		break;
+	case kRotate:
+		{
+			float r = get<float>(), x = get<float>();
+			float y = get<float>(), z = get<float>();
+			node = arena_->create<RotateNode>(parent, r, x, y, z);
+		}
+		break;
+	case kScale:
+		{
+			float x = get<float>(), y = get<float>(), z = get<float>();
+			node = arena_->create<ScaleNode>(parent, x, y, z);
+		}
+		break;
+	case kConcatTransform:
+		node = arena_->create<ConcatTransformNode>(parent,
+							getArray<float>());
+		break;
+	case kHyperboloid:
+		{
+			float x1 = get<float>(), y1 = get<float>();
+			float z1 = get<float>(), x2 = get<float>();
+			float y2 = get<float>(), z2 = get<float>();
+			float thetamax = get<float>();
+			node = arena_->create<HyperboloidNode>(parent,
+					x1, y1, z1, x2, y2, z2, thetamax);
+		}
+		break;
+	case kParaboloid:
+		{
+			float rmax = get<float>(), zmin = get<float>();
+			float zmax = get<float>(), thetamax = get<float>();
+			node = arena_->create<ParaboloidNode>(parent,
+						rmax, zmin, zmax, thetamax);
+		}
+		break;
+	case kTorus:
+		{
+			float rmajor = get<float>(), rminor = get<float>();
+			float phimin = get<float>(), phimax = get<float>();
+			float thetamax = get<float>();
+			node = arena_->create<TorusNode>(parent, rmajor,
+					rminor, phimin, phimax, thetamax);
+		}
+		break;
+	case kCylinder:
+		{
+			float radius = get<float>(), zmin = get<float>();
+			float zmax = get<float>(), thetamax = get<float>();
+			node = arena_->create<CylinderNode>(parent,
+						radius, zmin, zmax, thetamax);
+		}
+		break;
+	case kSphere:
+		{
+			float radius = get<float>(), zmin = get<float>();
+			float zmax = get<float>(), thetamax = get<float>();
+			node = arena_->create<SphereNode>(parent,
+						radius, zmin, zmax, thetamax);
+		}
+		break;
+	case kDisk:
+		{
+			float height = get<float>(), radius = get<float>();
+			float thetamax = get<float>();
+			node = arena_->create<DiskNode>(parent,
+						height, radius, thetamax);
+		}
+		break;
+	case kCone:
+		{
+			float height = get<float>(), radius = get<float>();
+			float thetamax = get<float>();
+			node = arena_->create<ConeNode>(parent,
+						height, radius, thetamax);
+		}
+		break;
+	case kPointsGeneralPolygons:
+		{
+			Array<int> nloops = getArray<int>();
+			Array<int> nvertices = getArray<int>();
+			Array<int> vertices = getArray<int>();
+			PointsGeneralPolygonsNode *n =
+				arena_->create<PointsGeneralPolygonsNode>(
+					parent, std::move(nloops),
+					std::move(nvertices),
+					std::move(vertices));
+			getPrimvars(&n->primvars);
+			node = n;
+		}
+		break;
+	case kPointsPolygons:
+		{
+			Array<int> nvertices = getArray<int>();
+			Array<int> vertices = getArray<int>();
+			PointsPolygonsNode *n =
+				arena_->create<PointsPolygonsNode>(parent,
+					std::move(nvertices),
+					std::move(vertices));
+			getPrimvars(&n->primvars);
+			node = n;
+		}
+		break;
+	case kAttribute:
+	case kPattern:
+	case kBxdf:
+	case kLight:
+		{
+			Symbol item_type = getSymbol();
+			Symbol name = getSymbol();
+			AttributeNode *n;
+			if (type == kPattern)
+				n = arena_->create<PatternNode>(parent,
+							item_type, name);
+			else if (type == kBxdf)
+				n = arena_->create<BxdfNode>(parent,
+							item_type, name);
+			else if (type == kLight)
+				n = arena_->create<LightNode>(parent,
+							item_type, name);
+			else
+				n = arena_->create<AttributeNode>(parent,
+							item_type, name);
+			getParams(&n->string_params, &Reader::getSymbols);
+			getParams(&n->float_params, &Reader::getArray<float>);
+			node = n;
+		}
+		break;
+	case kArchive:
+		{
+			std::string filename = getString();
+			Array<float> bound = getArray<float>();
+			bool delayed = get<uint8_t>() != 0;
+			ArchiveNode *n = arena_->create<ArchiveNode>(parent,
+					filename, std::move(bound), delayed);
+			archives->push_back(n);
+			node = n;
+		}
+		break;
+	default:
+		ok_ = false;
+		return nullptr;
+	}
+	node->hash = hash;
+	return node;
+}
+
+// with a stack of its own, however deep the tree
+Node *Reader::getTree(std::vector<ArchiveNode *> *archives)
+{
+	// the nodes read, with the children still to come
+	struct Frame {
+		Node *node;
+		uint64_t left;
+	};
+	std::vector<Frame> stack;
+	Node *top = getNode(nullptr, archives);
+	if (top == nullptr)
+		return nullptr;
+	stack.push_back({top, get<uint64_t>()});
+	while (!stack.empty() && ok_) {
+		Frame &frame = stack.back();
+		if (frame.left == 0) {
+			stack.pop_back();
+			continue;
+		}
+		frame.left--;
+		Node *child = getNode(frame.node, archives);
+		if (child == nullptr)
+			break;
+		frame.node->children.push_back(child, arena_);
+		stack.push_back({child, get<uint64_t>()});
+	}
+	return ok_ ? top : nullptr;
+}
+
+void PutHeader(Writer *out, const SourceKey &key)
+{
+	out->put(kMagic, sizeof(kMagic));
+	out->put(kVersion);
+	out->put(kByteOrder);
+	out->put(key.path);
+	out->put((int64_t) key.stamp.mtime);
+	out->put((int64_t) key.stamp.size);
+	out->put(key.hash);
+}
+
+} // namespace
+
+bool rib::ReadSourceKey(const char * const filename, SourceKey *key)
+{
+	MappedFile mapped;
+	if (!StampFile(filename, &key->stamp) || !mapped.open(filename))
+		return false;
+	key->path = FullPath(filename);
+	key->hash = HashBytes(mapped.data(), mapped.size());
+	return true;
+}
+
+std::string rib::CachePath(const std::string &directory,
+				const std::string &filename)
+{
+	std::string path = FullPath(filename.c_str());
+	char name[32];
+	snprintf(name, sizeof(name), "%016llx.ribc", (unsigned long long)
+				HashBytes(path.data(), path.size()));
+	if (directory.empty() || directory.back() == '/')
+		return directory + name;
+	return directory + "/" + name;
+}
+
+bool rib::ReadSceneCache(const std::string &cache_path, const SourceKey &key,
+				SymbolTable *symbols, Arena *arena, Node *root)
+{
+	MappedFile mapped;
+	if (!mapped.open(cache_path.c_str()))
+		return false;
+
+	// the header has to be exactly the one this key would write
+	Writer header;
+	PutHeader(&header, key);
+	const std::string &expected = header.bytes();
+	if (mapped.size() < expected.size() ||
+	    memcmp(mapped.data(), expected.data(), expected.size()) != 0)
+		return false;
+
+	// a flipped byte in a value would still read back as a tree
+	uint64_t checksum;
+	if (mapped.size() < expected.size() + sizeof(checksum))
+		return false;
+	memcpy(&checksum, mapped.data() + expected.size(), sizeof(checksum));
+	const char *body = mapped.data() + expected.size() + sizeof(checksum);
+	size_t size = mapped.data() + mapped.size() - body;
+	if (checksum != HashBytes(body, size))
+		return false;
+
+	Reader in(body, size, arena);
+	in.readSymbols(symbols);
+	std::vector<ArchiveNode *> archives;
+	Node *top = in.getTree(&archives);
+	if (top == nullptr || !in.atEnd() || top->type != kJoint)
+		return false;
+
+	root->children = std::move(top->children);
+	for (size_t i = 0; i < root->children.size(); i++)
+		root->children[i]->parent = root;
+	root->hash = top->hash;
+
+	// an archive read while parsing is read again, it may have changed
+	// since, and so may the hashes of everything above it
+	for (size_t i = 0; i < archives.size(); i++) {
+		if (archives[i]->delayed)
+			continue;
+		archives[i]->contents();
+		for (Node *up = archives[i]; up != nullptr; up = up->parent)
+			up->hash = 0;
+	}
+	if (root->hash == 0)
+		SealHash(root);
+	return true;
+}
+
+bool rib::WriteSceneCache(const std::string &cache_path, const SourceKey &key,
+				const Node &root)
+{
+	Writer nodes;
+	TreeWriter writer(&nodes);
+	Walk(&root, writer);
+
+	Writer body;
+	body.put((uint32_t) nodes.symbols().size());
+	for (size_t i = 0; i < nodes.symbols().size(); i++)
+		body.put(nodes.symbols()[i].str());
+	body.put(nodes.bytes().data(), nodes.bytes().size());
+
+	Writer out;
+	PutHeader(&out, key);
+	out.put(HashBytes(body.bytes().data(), body.bytes().size()));
+
+	// readers never see half a file
+	char suffix[48];
+	snprintf(suffix, sizeof(suffix), ".%d.%zu.tmp", (int) getpid(),
+		std::hash<std::thread::id>()(std::this_thread::get_id()));
+	std::string temp = cache_path + suffix;
+	{
+		std::ofstream file(temp.c_str(), std::ios::binary);
+		file.write(out.bytes().data(), out.bytes().size());
+		file.write(body.bytes().data(), body.bytes().size());
+		if (!file.good()) {
+			file.close();
+			std::remove(temp.c_str());
+			return false;
+		}
+	}
+#ifdef _WIN32
+	std::remove(cache_path.c_str());
+#endif
+	if (std::rename(temp.c_str(), cache_path.c_str()) != 0) {
+		std::remove(temp.c_str());
+		return false;
+	}
+	return true;
+}
@@ -0,0 +1,55 @@
+/* ************************************************************************
+ * Copyright 2017 Alexander Mishurov
+ * 
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ * 
+ * http://www.apache.org/licenses/LICENSE-2.0
+ * 
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ * ************************************************************************/
+
+#ifndef MAYAPLUGIN_RIBCACHE_H_
+#define MAYAPLUGIN_RIBCACHE_H_
+
+#include <cstdint>
+#include <string>
+#include "parser/rib_driver.h"
+#include "parser/rib_input.h"
+
+namespace rib {
+
+// What a cached tree was parsed from. The content hash catches edits
+// that keep the size and the modification time.
+struct SourceKey {
+	std::string path;
+	FileStamp stamp;
+	uint64_t hash = 0;
+};
+
+// Hashes the file as it is now, false if it can't be mapped.
+bool ReadSourceKey(const char * const filename, SourceKey *key);
+
+// The cache file for a source, named after the source's full path.
+std::string CachePath(const std::string &directory,
+				const std::string &filename);
+
+// Rebuilds the tree written for the same key under root, in the
+// arena, interning its strings into symbols. False, with root left
+// empty, if the cache is missing, stale, from another version or
+// damaged, whatever was read by then stays in the arena.
+bool ReadSceneCache(const std::string &cache_path, const SourceKey &key,
+				SymbolTable *symbols, Arena *arena, Node *root);
+
+// Replaces the cache file whole or not at all.
+bool WriteSceneCache(const std::string &cache_path, const SourceKey &key,
+				const Node &root);
+
+} /* namespace rib */
+
+#endif  // MAYAPLUGIN_RIBCACHE_H_
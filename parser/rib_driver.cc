@@ -14,294 +14,751 @@
  * limitations under the License.
  * ************************************************************************/
 
+#include <algorithm>
+#include <chrono>
 #include <fstream>
+#include <sstream>
+#include <type_traits>
+#include <unordered_map>
 #include "rib_driver.h"
+#include "rib_archive.h"
+#include "rib_input.h"
+#include "rib_binary.h"
+#include "rib_cache.h"
+#include "rib_flat.h"
+#include "rib_gzip.h"
+#include "rib_hash.h"
+#include "rib_parallel.h"
+#include "rib_split.h"
 
 using namespace rib;
 
-Driver::~Driver()
+// a scene's arena frees its nodes without visiting them
+static_assert(std::is_trivially_destructible<PointsGeneralPolygonsNode>::value
+	&& std::is_trivially_destructible<AttributeNode>::value,
+	"nodes must not own memory outside their arena");
+
+// smaller chunks cost more in setup than they gain in balance
+static const size_t kMinChunkSize = 1 << 18;
+
+// Hangs a chunk's nodes under the innermost open node. A chunk that
+// opens the world leaves its node open for the chunks after it.
+template<typename Nodes>
+static void Attach(const Nodes &nodes, int depth, std::vector<Node *> *open,
+				Arena *arena)
 {
-	delete(lexer);
-	lexer = nullptr;
-	delete(parser);
-	parser = nullptr;
+	Node *parent = open->back();
+	for (size_t i = 0; i < nodes.size(); i++) {
+		nodes[i]->parent = parent;
+		parent->children.push_back(nodes[i], arena);
+	}
+	if (depth > 0 && !parent->children.empty())
+		open->push_back(parent->children.back());
+	else if (depth < 0 && open->size() > 1)
+		open->pop_back();
 }
 
-Node Driver::parse(const char * const filename)
+void Scene::clearTree()
 {
-	printf("Parsing...\n");
-	std::ifstream in_file(filename);
-	if (!in_file.good()) {
-		printf("The file is bad\n");
-		exit( EXIT_FAILURE );
+	root.children = Array<Node *>();
+	root.hash = 0;
+	blocks.clear();
+	arena.release();
+}
+
+void Scene::clear()
+{
+	clearTree();
+	stats = InputStats();
+	message.clear();
+}
+
+ParseError Driver::parse(const char * const filename, Scene *scene,
+				unsigned threads) const
+{
+	SourceKey key;
+	std::string cache_path;
+	bool cached = cacheKey(filename, &key, &cache_path);
+	if (cached) {
+		std::chrono::steady_clock::time_point start =
+					std::chrono::steady_clock::now();
+		scene->clear();
+		scene->directory = DirectoryOf(filename);
+		if (ReadSceneCache(cache_path, key, &scene->symbols,
+					&scene->arena, &scene->root)) {
+			scene->stats.parse_seconds =
+				std::chrono::duration<double>(
+				std::chrono::steady_clock::now() - start).count();
+			return kSuccess;
+		}
 	}
 
-	delete lexer ;
-	lexer = new Lexer(&in_file);
+	ParseError ret = parseText(filename, scene, threads);
+	if (ret == kSuccess && cached)
+		WriteSceneCache(cache_path, key, scene->root);
+	return ret;
+}
 
-	delete parser;
-	parser = new Parser((*lexer), (*this));
+bool Driver::cacheKey(const char * const filename, SourceKey *key,
+				std::string *cache_path) const
+{
+	if (cache_directory_.empty() || !ReadSourceKey(filename, key))
+		return false;
+	*cache_path = CachePath(cache_directory_, filename);
+	return true;
+}
 
-	current = &root;
-	
-	const int accept = 0;
-	if (parser->parse() != accept) {
-		printf("Parse failed\n");
+ParseError Driver::parseText(const char * const filename, Scene *scene,
+				unsigned threads) const
+{
+	scene->directory = DirectoryOf(filename);
+	MappedFile mapped;
+	if (threads != 1 && mapped.open(filename))
+		return parseBuffer(mapped.data(), mapped.size(), scene,
+								threads);
+
+	scene->clear();
+	TreeBuilder builder(&scene->root, &scene->arena, false,
+							&scene->message);
+	builder.setDirectory(scene->directory);
+	ParseError ret = parseFile(filename, &builder, &scene->symbols,
+							&scene->stats);
+	if (ret != kSuccess)
+		scene->clearTree();
+	SealHash(&scene->root);
+	return ret;
+}
+
+ParseError Driver::parseBuffer(const char *data, size_t size, Scene *scene,
+				unsigned threads) const
+{
+	scene->clear();
+	threads = DefaultThreads(threads);
+	// a few chunks a thread even out blocks of different sizes
+	size_t min_size = std::max(size / (threads * 8), kMinChunkSize);
+	std::vector<Chunk> chunks;
+	if (threads == 1 || IsGzip(data, size) || IsBinaryRib(data, size) ||
+	    !SplitBlocks(data, size, min_size, &chunks) || chunks.size() < 2)
+		return parseSerial(data, size, scene);
+
+	std::chrono::steady_clock::time_point start =
+					std::chrono::steady_clock::now();
+
+	std::vector<Node> roots(chunks.size());
+	std::vector<Arena> arenas(chunks.size());
+	std::vector<std::string> messages(chunks.size());
+	std::vector<ParseError> results(chunks.size(), kParseFailed);
+	ParallelFor(chunks.size(), threads, [&](size_t i) {
+		bool archives;
+		results[i] = parseChunk(data, chunks[i], scene, &roots[i],
+					&arenas[i], &messages[i], &archives);
+	});
+
+	// stitch the pieces together in file order
+	ParseError ret = kSuccess;
+	Node *node = &scene->root;
+	std::vector<Node *> open(1, node);
+	for (size_t i = 0; i < chunks.size(); i++) {
+		if (results[i] != kSuccess)
+			ret = kParseFailed;
+		if (scene->message.empty())
+			scene->message = messages[i];
+		scene->arena.absorb(&arenas[i]);
+		Attach(roots[i].children, chunks[i].depth, &open,
+							&scene->arena);
 	}
-	return root;
+	if (ret != kSuccess)
+		scene->clearTree();
+	SealHash(node);
+
+	scene->stats.bytes = size;
+	scene->stats.parse_seconds = std::chrono::duration<double>(
+			std::chrono::steady_clock::now() - start).count();
+	return ret;
 }
 
-ParseError Driver::parseMaya(const char * const filename, Node *node)
+ParseError Driver::reparse(const char * const filename, Scene *scene,
+				unsigned threads) const
 {
-	std::ifstream in_file(filename);
+	std::chrono::steady_clock::time_point start =
+					std::chrono::steady_clock::now();
+	scene->directory = DirectoryOf(filename);
+	std::string message;
+	InputStats stats;
+
+	// with no blocks to keep a cached tree is as good and cheaper
+	SourceKey key;
+	std::string cache_path;
+	bool cached = cacheKey(filename, &key, &cache_path);
+	if (cached && scene->blocks.empty()) {
+		Node fresh;
+		Arena arena;
+		if (ReadSceneCache(cache_path, key, &scene->symbols, &arena,
+								&fresh)) {
+			scene->clear();
+			scene->arena.absorb(&arena);
+			std::vector<Node *> open(1, &scene->root);
+			Attach(fresh.children, 0, &open, &scene->arena);
+			scene->root.hash = fresh.hash;
+			scene->stats.parse_seconds =
+				std::chrono::duration<double>(
+				std::chrono::steady_clock::now() - start).count();
+			return kSuccess;
+		}
+	}
+
+	// every block is a chunk of its own, so an edit doesn't move the
+	// boundaries of the blocks after it
+	MappedFile mapped;
+	std::vector<Chunk> chunks;
+	bool split = mapped.open(filename) &&
+		!IsGzip(mapped.data(), mapped.size()) &&
+		!IsBinaryRib(mapped.data(), mapped.size()) &&
+		SplitBlocks(mapped.data(), mapped.size(), 1, &chunks);
+	if (!split) {
+		// nothing to keep, parse it all aside
+		Node fresh;
+		Arena arena;
+		TreeBuilder builder(&fresh, &arena, false, &message);
+		builder.setDirectory(scene->directory);
+		ParseError ret = parseFile(filename, &builder,
+					&scene->symbols, &stats);
+		if (ret != kSuccess) {
+			scene->message = message;
+			return ret;
+		}
+		scene->clear();
+		scene->arena.absorb(&arena);
+		std::vector<Node *> open(1, &scene->root);
+		Attach(fresh.children, 0, &open, &scene->arena);
+		SealHash(&scene->root);
+		scene->stats = stats;
+		if (cached)
+			WriteSceneCache(cache_path, key, scene->root);
+		return kSuccess;
+	}
+
+	// match the blocks against the last parse by their text, the
+	// world's opening and closing are always parsed again
+	const char *data = mapped.data();
+	std::unordered_multimap<uint64_t, size_t> previous;
+	for (size_t i = 0; i < scene->blocks.size(); i++) {
+		if (scene->blocks[i].hash != 0)
+			previous.insert({scene->blocks[i].hash, i});
+	}
+	std::vector<Scene::Block> blocks(chunks.size());
+	// the previous block each one keeps, or npos if it is parsed
+	std::vector<size_t> kept_from(chunks.size(), std::string::npos);
+	std::vector<size_t> parsed;
+	for (size_t i = 0; i < chunks.size(); i++) {
+		const Chunk &chunk = chunks[i];
+		blocks[i].hash = HashBytes(data + chunk.begin,
+					chunk.end - chunk.begin, chunk.nested);
+		auto found = previous.find(blocks[i].hash);
+		if (chunk.depth == 0 && found != previous.end()) {
+			kept_from[i] = found->second;
+			previous.erase(found);
+		} else {
+			parsed.push_back(i);
+		}
+	}
+
+	std::vector<Node> roots(chunks.size());
+	std::vector<std::string> messages(chunks.size());
+	std::vector<ParseError> results(chunks.size(), kSuccess);
+	ParallelFor(parsed.size(), threads, [&](size_t k) {
+		size_t i = parsed[k];
+		bool archives = false;
+		blocks[i].arena.reset(new Arena);
+		results[i] = parseChunk(data, chunks[i], scene, &roots[i],
+					blocks[i].arena.get(), &messages[i],
+					&archives);
+		// what an archive holds may have changed by the next time
+		if (archives || chunks[i].depth != 0)
+			blocks[i].hash = 0;
+		blocks[i].nodes.assign(roots[i].children.begin(),
+					roots[i].children.end());
+	});
+
+	ParseError ret = kSuccess;
+	for (size_t i = 0; i < chunks.size(); i++) {
+		if (results[i] != kSuccess)
+			ret = kParseFailed;
+		if (message.empty())
+			message = messages[i];
+	}
+	if (ret != kSuccess) {
+		scene->message = message;
+		return ret;
+	}
+
+	// the kept blocks bring their arenas along, the rest of the old
+	// tree goes with the old blocks and the scene's own arena
+	for (size_t i = 0; i < chunks.size(); i++) {
+		if (kept_from[i] == std::string::npos)
+			continue;
+		Scene::Block &old = scene->blocks[kept_from[i]];
+		blocks[i].nodes.swap(old.nodes);
+		blocks[i].arena = std::move(old.arena);
+	}
+	scene->root.children = Array<Node *>();
+	scene->arena.release();
+	scene->message.clear();
+	std::vector<Node *> open(1, &scene->root);
+	for (size_t i = 0; i < chunks.size(); i++)
+		Attach(blocks[i].nodes, chunks[i].depth, &open,
+							&scene->arena);
+	SealHash(&scene->root);
+	scene->blocks.swap(blocks);
+
+	scene->stats = InputStats();
+	scene->stats.bytes = mapped.size();
+	scene->stats.parse_seconds = std::chrono::duration<double>(
+			std::chrono::steady_clock::now() - start).count();
+	if (cached)
+		WriteSceneCache(cache_path, key, scene->root);
+	return kSuccess;
+}
+
+ParseError Driver::parse(const char * const filename, FlatScene *scene) const
+{
+	scene->clear();
+	scene->message.clear();
+	FlatBuilder builder(scene, &scene->message);
+	builder.setDirectory(DirectoryOf(filename));
+	ParseError ret = parseFile(filename, &builder, &scene->symbols,
+							&scene->stats);
+	builder.finish();
+	if (ret != kSuccess)
+		scene->clear();
+	return ret;
+}
+
+ParseError Driver::parseSerial(const char *data, size_t size,
+				Scene *scene) const
+{
+	TreeBuilder builder(&scene->root, &scene->arena, false,
+							&scene->message);
+	builder.setDirectory(scene->directory);
+	ParseError ret = parseBuffer(data, size, &builder, &scene->symbols,
+							&scene->stats);
+	if (ret != kSuccess)
+		scene->clearTree();
+	SealHash(&scene->root);
+	return ret;
+}
+
+ParseError Driver::parseChunk(const char *data, const Chunk &chunk,
+				Scene *scene, Node *root, Arena *arena,
+				std::string *message, bool *archives) const
+{
+	MemoryInput input(data + chunk.begin, chunk.end - chunk.begin);
+	Lexer lexer(&input, &scene->symbols);
+	lexer.setFirstLine(chunk.first_line);
+	TreeBuilder builder(root, arena, chunk.nested, message);
+	builder.setDirectory(scene->directory);
+	lexer.setArena(builder.arena());
+	Parser parser(lexer, builder);
+	const int accept = 0;
+	ParseError ret = parser.parse() == accept ? kSuccess : kParseFailed;
+	*archives = builder.readArchives();
+	return ret;
+}
+
+std::vector<ParseResult> Driver::parseMany(
+			const std::vector<std::string> &filenames,
+			unsigned threads, bool keep_scenes) const
+{
+	std::vector<ParseResult> results(filenames.size());
+	// the files are shared out, each one is parsed serially
+	ParallelFor(filenames.size(), threads, [&](size_t i) {
+		ParseResult &result = results[i];
+		std::unique_ptr<Scene> scene(new Scene);
+		result.filename = filenames[i];
+		result.error = parse(filenames[i].c_str(), scene.get());
+		result.message = scene->message;
+		result.stats = scene->stats;
+		// otherwise the tree goes as soon as the file is done
+		if (keep_scenes)
+			result.scene = std::move(scene);
+	});
+	return results;
+}
+
+ParseError Driver::parseFile(const char * const filename,
+				RibHandler *handler, SymbolTable *symbols,
+				InputStats *stats) const
+{
+	InputStats unused;
+	if (stats == nullptr)
+		stats = &unused;
+	*stats = InputStats();
+
+	MappedFile mapped;
+	if (mapped.open(filename)) {
+		MemoryInput input(mapped.data(), mapped.size());
+		return parseInput(&input, handler, symbols, stats);
+	}
+
+	// pipes and other things that can't be mapped
+	std::ifstream in_file(filename, std::ios::binary);
 	if (!in_file.good()) {
 		return kBadFile;
 	}
+	StreamInput input(&in_file);
+	return parseInput(&input, handler, symbols, stats);
+}
+
+ParseError Driver::parseBuffer(const char *data, size_t size,
+				RibHandler *handler, SymbolTable *symbols,
+				InputStats *stats) const
+{
+	InputStats unused;
+	if (stats == nullptr)
+		stats = &unused;
+	*stats = InputStats();
+
+	MemoryInput input(data, size);
+	return parseInput(&input, handler, symbols, stats);
+}
 
-	delete lexer ;
-	lexer = new Lexer(&in_file);
+ParseError Driver::parseInput(Input *input, RibHandler *handler,
+				SymbolTable *symbols, InputStats *stats) const
+{
+	const char *head;
+	size_t size = input->peek(&head, 4096);
+	if (IsGzip(head, size)) {
+		GzipInput gzip(input);
+		ParseError ret = parseInput(&gzip, handler, symbols, stats);
+		gzip.addStats(stats);
+		return gzip.failed() ? kBadFile : ret;
+	}
 
-	delete parser;
-	parser = new Parser((*lexer), (*this));
+	std::chrono::steady_clock::time_point start =
+					std::chrono::steady_clock::now();
+	ParseError ret;
+	if (IsBinaryRib(head, size)) {
+		BinaryLexer lexer(input, symbols);
+		ret = parseWith(&lexer, handler);
+	} else {
+		Lexer lexer(input, symbols);
+		ret = parseWith(&lexer, handler);
+	}
+	stats->bytes = input->consumed();
+	stats->parse_seconds = std::chrono::duration<double>(
+			std::chrono::steady_clock::now() - start).count();
+	return ret;
+}
 
-	current = node;
-	
+ParseError Driver::parseWith(Lexer *lexer, RibHandler *handler) const
+{
+	lexer->setArena(handler->arena());
+	Parser parser(*lexer, *handler);
 	const int accept = 0;
-	if (parser->parse() != accept) {
-		return kParseFailed;
+	return parser.parse() == accept ? kSuccess : kParseFailed;
+}
+
+void TreeBuilder::onError(const Parser::location_type &location,
+				const std::string &message)
+{
+	if (message_ == nullptr) {
+		RibHandler::onError(location, message);
+		return;
+	}
+	// the parser gives up at the first one
+	if (message_->empty()) {
+		std::ostringstream out;
+		out << message << " at " << location;
+		*message_ = out.str();
 	}
-	
-	return kSuccess;
 }
 
-void Driver::clean(Node *node)
+void TreeBuilder::addNode()
 {
-	for(std::vector<Node *>::iterator it = node->children.begin();
-	    it != node->children.end();
-	    ++it) {
-		clean(*it);
-		delete *it;
+	current_ = add<Node>();
+}
+
+void TreeBuilder::selectParent()
+{
+	// an unbalanced end stays at the top
+	if (current_ != root_) {
+		SealHash(current_);
+		current_ = current_->parent;
 	}
 }
 
-void Driver::addNode()
+void TreeBuilder::onTranslate(float x, float y, float z)
 {
-	Node *node = new Node;
-	node->parent = current;
-	current->children.push_back(node);
-	current = current->children.back();
+	// the top level has nowhere to keep them
+	if (!keepsTransforms())
+		return;
+	add<TranslateNode>(x, y, z);
 }
 
-void Driver::selectParent()
+void TreeBuilder::onRotate(float angle, float x, float y, float z)
 {
-	current = current->parent;
+	// the top level has nowhere to keep them
+	if (!keepsTransforms())
+		return;
+	add<RotateNode>(angle, x, y, z);
 }
 
-void Driver::addTranslate(const float x, const float y, const float z)
+void TreeBuilder::onScale(float x, float y, float z)
 {
-	TranslateNode *node = new TranslateNode(current, x, y, z);
-	if (current->parent != nullptr)
-		current->children.push_back(node);
+	// the top level has nowhere to keep them
+	if (!keepsTransforms())
+		return;
+	add<ScaleNode>(x, y, z);
 }
 
-void Driver::addRotate(const float x, const float y, const float z, const float w)
+void TreeBuilder::onConcatTransform(Array<float> &matrix)
 {
-	RotateNode *node = new RotateNode(current, x, y, z, w);
-	if (current->parent != nullptr)
-		current->children.push_back(node);
+	// the top level has nowhere to keep them
+	if (!keepsTransforms())
+		return;
+	add<ConcatTransformNode>(std::move(matrix));
 }
 
-void Driver::addScale(const float x, const float y, const float z)
+void TreeBuilder::onHyperboloid(float x1, float y1, float z1,
+			float x2, float y2, float z2, float thetamax)
 {
-	ScaleNode *node = new ScaleNode(current, x, y, z);
-	if (current->parent != nullptr)
-		current->children.push_back(node);
+	add<HyperboloidNode>(x1, y1, z1, x2, y2, z2, thetamax);
 }
 
-void Driver::addConcatTransform(const std::vector<float> matrix)
+void TreeBuilder::onParaboloid(float rmax, float zmin, float zmax,
+				float thetamax)
 {
-	ConcatTransformNode *node = new ConcatTransformNode(current, matrix);
-	if (current->parent != nullptr)
-		current->children.push_back(node);
+	add<ParaboloidNode>(rmax, zmin, zmax, thetamax);
 }
 
-void Driver::addHyperboloid(const float x1, const float y1, const float z1,
-			const float x2, const float y2, const float z2,
-			const float thetamax)
+void TreeBuilder::onTorus(float rmajor, float rminor, float phimin,
+				float phimax, float thetamax)
 {
-	HyperboloidNode *node = new HyperboloidNode(
-		current, x1, y1, z1, x2, y2, z2, thetamax);
-	current->children.push_back(node);
+	add<TorusNode>(rmajor, rminor, phimin, phimax, thetamax);
 }
 
-void Driver::addParaboloid(const float rmax, const float zmin,
-				const float zmax, const float thetamax)
+void TreeBuilder::onCylinder(float radius, float zmin, float zmax,
+				float thetamax)
 {
-	ParaboloidNode *node = new ParaboloidNode(current,
-						rmax, zmin, zmax, thetamax);
-	current->children.push_back(node);
+	add<CylinderNode>(radius, zmin, zmax, thetamax);
 }
 
-void Driver::addTorus(const float rmajor, const float rminor,
-			const float phimin, const float phimax,
-			const float thetamax)
+void TreeBuilder::onSphere(float radius, float zmin, float zmax,
+				float thetamax)
 {
-	TorusNode *node = new TorusNode(current, rmajor, rminor,
-						phimin, phimax, thetamax);
-	current->children.push_back(node);
+	add<SphereNode>(radius, zmin, zmax, thetamax);
 }
 
-void Driver::addCylinder(const float radius, const float zmin,
-				const float zmax, const float thetamax)
+void TreeBuilder::onDisk(float height, float radius, float thetamax)
 {
-	CylinderNode *node = new CylinderNode(current, radius,
-						zmin, zmax, thetamax);
-	current->children.push_back(node);
+	add<DiskNode>(height, radius, thetamax);
 }
 
-void Driver::addSphere(const float radius, const float zmin,
-			const float zmax, const float thetamax)
+void TreeBuilder::onCone(float height, float radius, float thetamax)
 {
-	SphereNode *node = new SphereNode(current, radius,
-					zmin, zmax, thetamax);
-	current->children.push_back(node);
+	add<ConeNode>(height, radius, thetamax);
 }
 
-void Driver::addDisk(const float height, const float radius,
-			const float thetamax)
+void TreeBuilder::onPointsGeneralPolygons(Array<int> &nloops,
+				Array<int> &nvertices,
+				Array<int> &vertices)
 {
-	DiskNode *node = new DiskNode(current, height, radius, thetamax);
-	current->children.push_back(node);
+	add<PointsGeneralPolygonsNode>(std::move(nloops),
+				std::move(nvertices), std::move(vertices));
 }
 
-void Driver::addCone(const float height, const float radius,
-			const float thetamax)
+// the last child of the current node if it is a mesh of the given type
+template<typename T>
+static T *LastMesh(Node *current, NodeType type)
 {
-	ConeNode *node = new ConeNode(current, height, radius, thetamax);
-	current->children.push_back(node);
+	if (current->children.empty() ||
+	    current->children.back()->type != type)
+		return nullptr;
+	return (T *) current->children.back();
 }
 
-void Driver::addPGP(std::vector<int> nloops, std::vector<int> nvertices,
-			std::vector<int> vertices)
+void TreeBuilder::onPointsGeneralPolygonsParam(
+				const Declaration &declaration,
+				Array<float> &value)
 {
-	PointsGeneralPolygonsNode *node = 
-		new PointsGeneralPolygonsNode(current, nloops,
-						nvertices, vertices);
-	current->children.push_back(node);
+	PointsGeneralPolygonsNode *node = LastMesh<PointsGeneralPolygonsNode>(
+				current_, kPointsGeneralPolygons);
+	if (node != nullptr)
+		node->primvars.add(declaration, value, arena_);
 }
 
-void Driver::addPGPparam(const std::string &key, std::vector<float> value) {
-	if (current->children.back()->type == kPointsGeneralPolygons) {
-		PointsGeneralPolygonsNode *node =
-			(PointsGeneralPolygonsNode *) current->children.back();
-		node->params.insert({key, value});
-	}
+void TreeBuilder::onPointsGeneralPolygonsParam(
+				const Declaration &declaration,
+				Array<Symbol> &value)
+{
+	PointsGeneralPolygonsNode *node = LastMesh<PointsGeneralPolygonsNode>(
+				current_, kPointsGeneralPolygons);
+	if (node != nullptr)
+		node->primvars.add(declaration, value, arena_);
 }
 
-void Driver::addPP(std::vector<int> nvertices, std::vector<int> vertices)
+void TreeBuilder::onPointsPolygons(Array<int> &nvertices,
+				Array<int> &vertices)
 {
-	PointsPolygonsNode *node = 
-		new PointsPolygonsNode(current, nvertices, vertices);
-	current->children.push_back(node);
+	add<PointsPolygonsNode>(std::move(nvertices), std::move(vertices));
 }
 
-void Driver::addPPparam(const std::string &key, std::vector<float> value) {
-	if (current->children.back()->type == kPointsPolygons) {
-		PointsPolygonsNode *node =
-			(PointsPolygonsNode *) current->children.back();
-		node->params.insert({key, value});
-	}
+void TreeBuilder::onPointsPolygonsParam(const Declaration &declaration,
+				Array<float> &value)
+{
+	PointsPolygonsNode *node = LastMesh<PointsPolygonsNode>(
+				current_, kPointsPolygons);
+	if (node != nullptr)
+		node->primvars.add(declaration, value, arena_);
+}
+
+void TreeBuilder::onPointsPolygonsParam(const Declaration &declaration,
+				Array<Symbol> &value)
+{
+	PointsPolygonsNode *node = LastMesh<PointsPolygonsNode>(
+				current_, kPointsPolygons);
+	if (node != nullptr)
+		node->primvars.add(declaration, value, arena_);
+}
+
+void AttributeNode::addStringParam(const Symbol key,
+				Array<Symbol> value, Arena *arena) {
+	string_params.insert({key, std::move(value)}, arena);
 }
 
-void AttributeNode::addStringParam(const std::string &key,
-				std::vector<std::string> value) {
-	string_params.insert({key, value});
+void AttributeNode::addFloatParam(const Symbol key,
+				Array<float> value, Arena *arena) {
+	float_params.insert({key, std::move(value)}, arena);
 }
 
-void Driver::addAttribute(std::string name)
+AttributeNode *TreeBuilder::lastAttribute(NodeType type)
 {
-	AttributeNode *node = new AttributeNode(current, "", name);
-	current->children.push_back(node);
+	if (current_->children.empty() ||
+	    current_->children.back()->type != type)
+		return nullptr;
+	return (AttributeNode *) current_->children.back();
 }
 
-void Driver::addAttrFlParam(const std::string &key, std::vector<float> value)
+void TreeBuilder::onAttribute(Symbol name)
 {
-	if (current->children.back()->type == kAttribute) {
-		AttributeNode *node =
-				(AttributeNode *) current->children.back();
-		node->addFloatParam(key, value);
-	}
+	add<AttributeNode>(Symbol(), name);
 }
 
-void AttributeNode::addFloatParam(const std::string &key,
-				std::vector<float> value) {
-	float_params.insert({key, value});
+void TreeBuilder::onAttributeParam(Symbol key,
+				Array<float> &value)
+{
+	AttributeNode *node = lastAttribute(kAttribute);
+	if (node != nullptr)
+		node->addFloatParam(key, std::move(value), arena_);
 }
 
-void Driver::addPattern(std::string item_type, std::string name)
+void TreeBuilder::onPattern(Symbol item_type, Symbol name)
 {
-	PatternNode *node = new PatternNode(current, item_type, name);
-	current->children.push_back(node);
+	add<PatternNode>(item_type, name);
 }
 
-void Driver::addBxdf(std::string item_type, std::string name)
+void TreeBuilder::onPatternParam(Symbol key, Array<float> &value)
 {
-	BxdfNode *node = new BxdfNode(current, item_type, name);
-	current->children.push_back(node);
+	AttributeNode *node = lastAttribute(kPattern);
+	if (node != nullptr)
+		node->addFloatParam(key, std::move(value), arena_);
 }
 
-void Driver::addLight(std::string item_type, std::string name)
+void TreeBuilder::onPatternParam(Symbol key, Array<Symbol> &value)
 {
-	LightNode *node = new LightNode(current, item_type, name);
-	current->children.push_back(node);
+	AttributeNode *node = lastAttribute(kPattern);
+	if (node != nullptr)
+		node->addStringParam(key, std::move(value), arena_);
 }
 
+void TreeBuilder::onBxdf(Symbol item_type, Symbol name)
+{
+	add<BxdfNode>(item_type, name);
+}
 
-void Driver::addPatternStrParam(const std::string &key,
-				std::vector<std::string> value) {
-	if (current->children.back()->type == kPattern) {
-		PatternNode *node = (PatternNode *) current->children.back();
-		node->addStringParam(key, value);
-	}
+void TreeBuilder::onBxdfParam(Symbol key, Array<float> &value)
+{
+	AttributeNode *node = lastAttribute(kBxdf);
+	if (node != nullptr)
+		node->addFloatParam(key, std::move(value), arena_);
 }
 
-void Driver::addPatternFlParam(const std::string &key,
-				std::vector<float> value) {
-	if (current->children.back()->type == kPattern) {
-		PatternNode *node = (PatternNode *) current->children.back();
-		node->addFloatParam(key, value);
-	}
+void TreeBuilder::onBxdfParam(Symbol key, Array<Symbol> &value)
+{
+	AttributeNode *node = lastAttribute(kBxdf);
+	if (node != nullptr)
+		node->addStringParam(key, std::move(value), arena_);
 }
 
-void Driver::addBxdfStrParam(const std::string &key,
-				std::vector<std::string> value) {
-	if (current->children.back()->type == kBxdf) {
-		BxdfNode *node = (BxdfNode *) current->children.back();
-		node->addStringParam(key, value);
-	}
+void TreeBuilder::onLight(Symbol item_type, Symbol name)
+{
+	add<LightNode>(item_type, name);
 }
 
-void Driver::addBxdfFlParam(const std::string &key,
-				std::vector<float> value) {
-	if (current->children.back()->type == kBxdf) {
-		BxdfNode *node = (BxdfNode *) current->children.back();
-		node->addFloatParam(key, value);
-	}
+void TreeBuilder::onLightParam(Symbol key, Array<float> &value)
+{
+	AttributeNode *node = lastAttribute(kLight);
+	if (node != nullptr)
+		node->addFloatParam(key, std::move(value), arena_);
 }
 
-void Driver::addLightStrParam(const std::string &key,
-				std::vector<std::string> value) {
-	if (current->children.back()->type == kLight) {
-		LightNode *node = (LightNode *) current->children.back();
-		node->addStringParam(key, value);
-	}
+void TreeBuilder::onLightParam(Symbol key, Array<Symbol> &value)
+{
+	AttributeNode *node = lastAttribute(kLight);
+	if (node != nullptr)
+		node->addStringParam(key, std::move(value), arena_);
 }
 
-void Driver::addLightFlParam(const std::string &key,
-				std::vector<float> value) {
-	if (current->children.back()->type == kLight) {
-		LightNode *node = (LightNode *) current->children.back();
-		node->addFloatParam(key, value);
-	}
+void TreeBuilder::onReadArchive(Symbol filename)
+{
+	ArchiveNode *node = add<ArchiveNode>(
+				ResolveArchive(directory_, filename.str()),
+				Array<float>(), false);
+	archives_ = true;
+	// only the delayed kind waits to be asked
+	node->contents();
+}
+
+void TreeBuilder::onProcedural(Symbol name, Array<Symbol> &args,
+				Array<float> &bound)
+{
+	// the other procedurals run programs or load plugins
+	if (name.str() != "DelayedReadArchive" || args.empty())
+		return;
+	add<ArchiveNode>(ResolveArchive(directory_, args[0].str()),
+				std::move(bound), true);
+	archives_ = true;
+}
+
+void TreeBuilder::onProcedural2(Symbol name, Symbol bound_function)
+{
+	procedural_ = nullptr;
+	if (name.str() != "DelayedReadArchive2")
+		return;
+	procedural_ = add<ArchiveNode>(std::string(), Array<float>(), true);
+	archives_ = true;
+}
+
+// "float[6] bound" names the same parameter as "bound"
+static std::string ParamName(Symbol key)
+{
+	size_t space = key.str().find_last_of(' ');
+	return space == std::string::npos ? key.str()
+					: key.str().substr(space + 1);
+}
+
+void TreeBuilder::onProcedural2Param(Symbol key,
+				Array<float> &value)
+{
+	if (procedural_ != nullptr && ParamName(key) == "bound")
+		procedural_->bound = std::move(value);
 }
 
+void TreeBuilder::onProcedural2Param(Symbol key,
+				Array<Symbol> &value)
+{
+	if (procedural_ != nullptr && ParamName(key) == "filename" &&
+	    !value.empty())
+		procedural_->filename = ResolveArchive(directory_,
+							value[0].str());
+}
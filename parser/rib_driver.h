@@ -17,10 +17,21 @@
 #ifndef MAYAPLUGIN_RIBDRIVER_H_
 #define MAYAPLUGIN_RIBDRIVER_H_
 
+#include <atomic>
+#include <cstdint>
 #include <istream>
 #include <vector>
 #include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include "parser/rib_arena.h"
 #include "parser/rib_lexer.h"
+#include "parser/rib_handler.h"
+#include "parser/rib_input.h"
+#include "parser/rib_primvar.h"
+#include "parser/rib_split.h"
+#include "parser/rib_symbol.h"
 #include "rib_parser.tab.hh"
 
 namespace rib {
@@ -49,19 +60,25 @@ enum NodeType {
 	kPointsPolygons,
 	kPattern,
 	kBxdf,
-	kLight
+	kLight,
+	kArchive
 };
 
+// Nodes and everything in them live in the arena of the scene or
+// the block they were parsed into and are never destroyed one by one,
+// so apart from archives they have nothing to destroy.
 class Node {
 public:
-	std::vector<Node *> children;
+	Array<Node *> children;
 	Node *parent = nullptr;
-	NodeType type;
+	NodeType type = kJoint;
+	// Of the subtree's contents, equal for equal subtrees whichever
+	// file or format they came from. 0 until the node is complete.
+	uint64_t hash = 0;
 
 public:
 	Node() = default;
 	Node(Node *parent) : parent(parent) { type = kJoint; }
-	~Node() {}
 };
 
 class TranslateNode : public Node {
@@ -72,7 +89,6 @@ public:
 public:
 	TranslateNode(Node *parent, float x, float y, float z)
 	: Node(parent), x(x), y(y), z(z) { type = kTranslate; }
-	~TranslateNode() {}
 };
 
 class RotateNode : public Node {
@@ -84,7 +100,6 @@ public:
 public:
 	RotateNode(Node *parent, float r, float x, float y, float z)
 	: Node(parent), r(r), x(x), y(y), z(z) { type = kRotate; }
-	~RotateNode() {}
 };
 
 class ScaleNode : public Node {
@@ -95,16 +110,14 @@ public:
 public:
 	ScaleNode(Node *parent, float x, float y, float z)
 	: Node(parent), x(x), y(y), z(z) { type = kScale; }
-	~ScaleNode() {}
 };
 
 class ConcatTransformNode : public Node {
 public:
-	std::vector<float> matrix;
+	Array<float> matrix;
 public:
-	ConcatTransformNode(Node *parent, std::vector<float> matrix)
-	: Node(parent), matrix(matrix) { type = kConcatTransform; }
-	~ConcatTransformNode() {}
+	ConcatTransformNode(Node *parent, Array<float> matrix)
+	: Node(parent), matrix(std::move(matrix)) { type = kConcatTransform; }
 };
 
 /* quadrics */
@@ -124,7 +137,6 @@ public:
 	: Node(parent), x1(x1), y1(y1), z1(z1),
 			x2(x2), y2(y2), z2(z2), thetamax(thetamax)
 		{ type = kHyperboloid; }
-	~HyperboloidNode() {}
 };
 
 class ParaboloidNode : public Node {
@@ -138,7 +150,6 @@ public:
 					float zmax, float thetamax)
 	: Node(parent), rmax(rmax), zmin(zmin), zmax(zmax),
 				thetamax(thetamax) { type = kParaboloid; }
-	~ParaboloidNode() {}
 };
 
 class TorusNode : public Node {
@@ -154,7 +165,6 @@ public:
 	: Node(parent), rmajor(rmajor), rminor(rminor),
 			phimin(phimin), phimax(phimax), thetamax(thetamax)
 		{ type = kTorus; }
-	~TorusNode() {}
 };
 
 
@@ -170,7 +180,6 @@ public:
 	: Node(parent), radius(radius), zmin(zmin),
 			zmax(zmax), thetamax(thetamax)
 		{ type = kCylinder; }
-	~CylinderNode() {}
 };
 
 class SphereNode : public Node {
@@ -185,7 +194,6 @@ public:
 	: Node(parent), radius(radius), zmin(zmin),
 			zmax(zmax), thetamax(thetamax)
 		{ type = kSphere; }
-	~SphereNode() {}
 };
 
 class DiskNode : public Node {
@@ -197,7 +205,6 @@ public:
 	DiskNode(Node *parent, float height, float radius, float thetamax)
 	: Node(parent), height(height), radius(radius), thetamax(thetamax)
 		{ type = kDisk; }
-	~DiskNode() {}
 };
 
 class ConeNode : public Node {
@@ -209,149 +216,344 @@ public:
 	ConeNode(Node *parent, float height, float radius, float thetamax)
 	: Node(parent), height(height), radius(radius), thetamax(thetamax)
 		{ type = kCone; }
-	~ConeNode() {}
 };
 
 class PointsGeneralPolygonsNode : public Node {
 public:
-	std::vector<int> nloops;
-	std::vector<int> nvertices;
-	std::vector<int> vertices;
-	std::map<std::string,std::vector<float>> params;
-public:
-	PointsGeneralPolygonsNode(Node *parent, std::vector<int> nloops,
-			std::vector<int> nvertices, std::vector<int> vertices)
-	: Node(parent), nloops(nloops), nvertices(nvertices),
-			vertices(vertices) { type = kPointsGeneralPolygons; }
-	~PointsGeneralPolygonsNode() {}
+	Array<int> nloops;
+	Array<int> nvertices;
+	Array<int> vertices;
+	PrimvarTable primvars;
+public:
+	PointsGeneralPolygonsNode(Node *parent, Array<int> nloops,
+			Array<int> nvertices, Array<int> vertices)
+	: Node(parent), nloops(std::move(nloops)),
+			nvertices(std::move(nvertices)),
+			vertices(std::move(vertices))
+		{ type = kPointsGeneralPolygons; }
 };
 
 class PointsPolygonsNode : public Node {
 public:
-	std::vector<int> nvertices;
-	std::vector<int> vertices;
-	std::map<std::string,std::vector<float>> params;
+	Array<int> nvertices;
+	Array<int> vertices;
+	PrimvarTable primvars;
 public:
-	PointsPolygonsNode(Node *parent, std::vector<int> nvertices,
-			std::vector<int> vertices)
-	: Node(parent), nvertices(nvertices), vertices(vertices)
-			{ type = kPointsPolygons; }
-	~PointsPolygonsNode() {}
+	PointsPolygonsNode(Node *parent, Array<int> nvertices,
+			Array<int> vertices)
+	: Node(parent), nvertices(std::move(nvertices)),
+			vertices(std::move(vertices))
+		{ type = kPointsPolygons; }
 };
 
 class AttributeNode : public Node {
 public:
-	std::string item_type;
-	std::string name;
-	std::map<std::string,std::vector<std::string>> string_params;
-	std::map<std::string,std::vector<float>> float_params;
+	Symbol item_type;
+	Symbol name;
+	SymbolMap<Array<Symbol>> string_params;
+	SymbolMap<Array<float>> float_params;
 public:
 	AttributeNode(Node *parent,
-			std::string item_type,
-			std::string name)
+			Symbol item_type,
+			Symbol name)
 	: Node(parent), item_type(item_type), name(name)
 			{ type = kAttribute; }
-	~AttributeNode() {}
-	void addStringParam(const std::string &key,
-					std::vector<std::string> value);
-	void addFloatParam(const std::string &key,std::vector<float> value);
+	void addStringParam(const Symbol key, Array<Symbol> value,
+					Arena *arena);
+	void addFloatParam(const Symbol key, Array<float> value,
+					Arena *arena);
 };
 
 class PatternNode : public AttributeNode {
 public:
 	PatternNode(Node *parent,
-			std::string item_type,
-			std::string name)
+			Symbol item_type,
+			Symbol name)
 	: AttributeNode(parent, item_type, name)
 			{ type = kPattern; }
-	~PatternNode() {}
 };
 
 class BxdfNode : public AttributeNode {
 public:
 	BxdfNode(Node *parent,
-			std::string item_type,
-			std::string name)
+			Symbol item_type,
+			Symbol name)
 	: AttributeNode(parent, item_type, name)
 			{ type = kBxdf; }
-	~BxdfNode() {}
 };
 
 class LightNode : public AttributeNode {
 public:
 	LightNode(Node *parent,
-			std::string item_type,
-			std::string name)
+			Symbol item_type,
+			Symbol name)
 	: AttributeNode(parent, item_type, name)
 			{ type = kLight; }
-	~LightNode() {}
 };
 
-class Driver {
-public:
-	Parser *parser = nullptr;
-	Lexer *lexer = nullptr;
-	Node root;
-	Node *current = nullptr;
-public:
-	Driver() = default;
-	virtual ~Driver();
-	
-	Node parse(const char * const filename);
-	ParseError parseMaya(const char * const filename, Node *node);
-	void clean(Node *node);
+class Scene;
+
+// A ReadArchive, read while the file naming it is parsed, or a
+// DelayedReadArchive procedural, which stays a placeholder with a bound
+// until someone asks for what is inside. The contents come from the
+// ArchiveCache, every node naming the same file shares them. The only
+// node the arena has to destroy.
+class ArchiveNode : public Node {
+public:
+	std::string filename;
+	// xmin xmax ymin ymax zmin zmax, empty if not given
+	Array<float> bound;
+	bool delayed;
+public:
+	ArchiveNode(Node *parent,
+			std::string filename,
+			Array<float> bound,
+			bool delayed)
+	: Node(parent), filename(filename), bound(std::move(bound)),
+			delayed(delayed) { type = kArchive; }
+	// Reads the archive on the first call, null if it can't be read
+	// or parsed. Safe to call from several threads.
+	std::shared_ptr<const Scene> contents();
+	// What has been read so far, never reads anything.
+	std::shared_ptr<const Scene> loaded() const
+		{ return loaded_ ? contents_ : nullptr; }
+private:
+	std::once_flag once_;
+	std::atomic<bool> loaded_{false};
+	std::shared_ptr<const Scene> contents_;
+};
+
+// Builds the node tree under the given node, in the given arena.
+class TreeBuilder : public RibHandler {
+public:
+	// nested means the root stands in for a node inside the world,
+	// so transforms the top level drops are kept. Errors go to the
+	// message if there is one, to stderr otherwise.
+	TreeBuilder(Node *root, Arena *arena, bool nested = false,
+				std::string *message = nullptr)
+	: root_(root), current_(root), arena_(arena), nested_(nested),
+			message_(message) {}
+	virtual ~TreeBuilder() {}
 	// hierarchy
-	void addNode();
-	void selectParent();
+	virtual void onWorldBegin() { addNode(); }
+	virtual void onWorldEnd() { selectParent(); }
+	virtual void onAttributeBegin() { addNode(); }
+	virtual void onAttributeEnd() { selectParent(); }
+	virtual void onTransformBegin() { addNode(); }
+	virtual void onTransformEnd() { selectParent(); }
 	// transforms
-	void addTranslate(const float x, const float y, const float z);
-	void addRotate(const float r, const float x, const float y, const float z);
-	void addScale(const float x, const float y, const float z);
-	void addConcatTransform(const std::vector<float> matrix);
+	virtual void onTranslate(float x, float y, float z);
+	virtual void onRotate(float angle, float x, float y, float z);
+	virtual void onScale(float x, float y, float z);
+	virtual void onConcatTransform(Array<float> &matrix);
 	// quadrics
-	void addHyperboloid(const float x1, const float y1, const float z1,
-			const float x2, const float y2, const float z2,
-			const float thetamax);
-	void addParaboloid(const float rmax, const float zmin,
-			const float zmax, const float thetamax);
-	void addTorus(const float rmajor, const float rminor,
-		const float phimin, const float phimax,
-		const float thetamax);
-	void addCylinder(const float radius, const float zmin,
-			const float zmax, const float thetamax);
-	void addSphere(const float radius, const float zmin,
-		const float zmax, const float thetamax);
-	void addDisk(const float height, const float radius,
-		const float thetamax);
-	void addCone(const float height, const float radius,
-		const float thetamax);
+	virtual void onHyperboloid(float x1, float y1, float z1,
+				float x2, float y2, float z2,
+				float thetamax);
+	virtual void onParaboloid(float rmax, float zmin, float zmax,
+				float thetamax);
+	virtual void onTorus(float rmajor, float rminor, float phimin,
+				float phimax, float thetamax);
+	virtual void onCylinder(float radius, float zmin, float zmax,
+				float thetamax);
+	virtual void onSphere(float radius, float zmin, float zmax,
+				float thetamax);
+	virtual void onDisk(float height, float radius, float thetamax);
+	virtual void onCone(float height, float radius, float thetamax);
 	// primitives
-	void addPGP(std::vector<int> nloops, std::vector<int> nvertices,
-			std::vector<int> vertices);
-	void addPGPparam(const std::string &key, std::vector<float> value);
-
-	void addPP(std::vector<int> nvertices, std::vector<int> vertices);
-	void addPPparam(const std::string &key, std::vector<float> value);
+	virtual void onPointsGeneralPolygons(Array<int> &nloops,
+				Array<int> &nvertices,
+				Array<int> &vertices);
+	virtual void onPointsGeneralPolygonsParam(
+				const Declaration &declaration,
+				Array<float> &value);
+	virtual void onPointsGeneralPolygonsParam(
+				const Declaration &declaration,
+				Array<Symbol> &value);
+	virtual void onPointsPolygons(Array<int> &nvertices,
+				Array<int> &vertices);
+	virtual void onPointsPolygonsParam(const Declaration &declaration,
+				Array<float> &value);
+	virtual void onPointsPolygonsParam(const Declaration &declaration,
+				Array<Symbol> &value);
 	// rendering
-	void addAttribute(std::string name);
-	void addAttrFlParam(const std::string &key,
-						std::vector<float> value);
-
-	void addPattern(std::string item_type, std::string name);
-	void addPatternFlParam(const std::string &key,
-						std::vector<float> value);
-	void addPatternStrParam(const std::string &key,
-						std::vector<std::string> value);
-	void addBxdf(std::string item_type, std::string name);
-	void addBxdfFlParam(const std::string &key,
-						std::vector<float> value);
-	void addBxdfStrParam(const std::string &key,
-						std::vector<std::string> value);
-	void addLight(std::string item_type, std::string name);
-	void addLightFlParam(const std::string &key,
-						std::vector<float> value);
-	void addLightStrParam(const std::string &key,
-						std::vector<std::string> value);
+	virtual void onAttribute(Symbol name);
+	virtual void onAttributeParam(Symbol key,
+				Array<float> &value);
+	using RibHandler::onAttributeParam;
+	virtual void onPattern(Symbol item_type, Symbol name);
+	virtual void onPatternParam(Symbol key,
+				Array<float> &value);
+	virtual void onPatternParam(Symbol key,
+				Array<Symbol> &value);
+	virtual void onBxdf(Symbol item_type, Symbol name);
+	virtual void onBxdfParam(Symbol key,
+				Array<float> &value);
+	virtual void onBxdfParam(Symbol key,
+				Array<Symbol> &value);
+	virtual void onLight(Symbol item_type, Symbol name);
+	virtual void onLightParam(Symbol key,
+				Array<float> &value);
+	virtual void onLightParam(Symbol key,
+				Array<Symbol> &value);
+	// archives
+	virtual void onReadArchive(Symbol filename);
+	virtual void onProcedural(Symbol name, Array<Symbol> &args,
+				Array<float> &bound);
+	virtual void onProcedural2(Symbol name, Symbol bound_function);
+	virtual void onProcedural2Param(Symbol key,
+				Array<float> &value);
+	virtual void onProcedural2Param(Symbol key,
+				Array<Symbol> &value);
+
+	// the arrays go to the nodes as they are
+	virtual Arena *arena() { return arena_; }
+
+	// relative archive paths are looked up here first
+	void setDirectory(const std::string &directory)
+		{ directory_ = directory; }
+	// whether anything read, or will read, an archive
+	bool readArchives() const { return archives_; }
+
+	virtual void onError(const Parser::location_type &location,
+				const std::string &message);
+private:
+	void addNode();
+	void selectParent();
+	// the last child of the current node if it is of the given type
+	AttributeNode *lastAttribute(NodeType type);
+	bool keepsTransforms() const
+		{ return current_ != root_ || nested_; }
+	// hangs a node made in the arena under the current one
+	template<typename T, typename... Args>
+	T *add(Args&&... args)
+	{
+		T *node = arena_->create<T>(current_,
+					std::forward<Args>(args)...);
+		current_->children.push_back(node, arena_);
+		return node;
+	}
+
+	Node *root_;
+	Node *current_;
+	Arena *arena_;
+	bool nested_;
+	std::string *message_;
+	std::string directory_;
+	// of the last Procedural2 if it reads an archive
+	ArchiveNode *procedural_ = nullptr;
+	bool archives_ = false;
+};
+
+// A tree together with the strings it refers to and the memory it is
+// made of, so it is valid for as long as it lives, whichever driver or
+// thread parsed it.
+class Scene {
+public:
+	Scene() = default;
+	Scene(const Scene &) = delete;
+	Scene &operator=(const Scene &) = delete;
+
+	// frees the tree, the symbols stay
+	void clear();
+	// frees the tree and nothing else
+	void clearTree();
+
+	// what isn't in a block, the root's children included
+	Arena arena;
+	Node root;
+	SymbolTable symbols;
+	InputStats stats;
+	// the parser's complaint, empty if it had none
+	std::string message;
+	// Where relative archive paths are looked up first. parse() sets
+	// it to the file's directory, clear() leaves it.
+	std::string directory;
+
+	// A top level block of the last reparse() and the nodes it made,
+	// which go with their arena when the block does.
+	struct Block {
+		// of the text, 0 if the block can't be kept
+		uint64_t hash = 0;
+		std::vector<Node *> nodes;
+		std::unique_ptr<Arena> arena;
+	};
+	std::vector<Block> blocks;
+};
+
+// How one file of parseMany went.
+struct ParseResult {
+	std::string filename;
+	ParseError error = kParseFailed;
+	std::string message;
+	InputStats stats;
+	// null unless the scenes were kept
+	std::unique_ptr<Scene> scene;
+};
+
+struct SourceKey;
+class FlatScene;
+
+// Holds nothing but its settings, so one driver can be used from any
+// number of threads at once.
+class Driver {
+public:
+	Driver() = default;
+	virtual ~Driver() {}
+
+	// Where parse() and reparse() keep a binary copy of every tree
+	// they parse from text. A file that hasn't changed since is read
+	// back from there instead of being parsed. Empty, the default,
+	// turns the cache off. Not to be changed while parsing.
+	void setCacheDirectory(const std::string &directory)
+		{ cache_directory_ = directory; }
+
+	// Parses into a scene, clearing it first. With more than one
+	// thread an ASCII file is cut into top level blocks which are
+	// parsed side by side, 0 means one per core. The tree is the same
+	// either way, compressed and binary files are parsed serially.
+	ParseError parse(const char * const filename, Scene *scene,
+					unsigned threads = 1) const;
+	ParseError parseBuffer(const char *data, size_t size, Scene *scene,
+					unsigned threads = 1) const;
+	// Parses the file again into a scene reparse() filled before.
+	// Top level blocks whose text is unchanged keep their nodes, only
+	// the others are parsed, on up to threads threads. On failure the
+	// tree is left as it was. The first reparse() parses everything.
+	ParseError reparse(const char * const filename, Scene *scene,
+					unsigned threads = 1) const;
+	// Parses serially into the flat layout, clearing it first. The
+	// nodes are laid out as they are reduced, no tree is built.
+	ParseError parse(const char * const filename, FlatScene *scene) const;
+	// Parses each file on its own on up to threads threads. The
+	// results are in the order of the filenames.
+	std::vector<ParseResult> parseMany(
+				const std::vector<std::string> &filenames,
+				unsigned threads = 0,
+				bool keep_scenes = true) const;
+	// Stream the requests to a handler instead of building a tree.
+	ParseError parseFile(const char * const filename,
+				RibHandler *handler, SymbolTable *symbols,
+				InputStats *stats = nullptr) const;
+	ParseError parseBuffer(const char *data, size_t size,
+				RibHandler *handler, SymbolTable *symbols,
+				InputStats *stats = nullptr) const;
+private:
+	ParseError parseText(const char * const filename, Scene *scene,
+				unsigned threads) const;
+	// false if the cache is off or the file can't be read
+	bool cacheKey(const char * const filename, SourceKey *key,
+				std::string *cache_path) const;
+	ParseError parseSerial(const char *data, size_t size,
+				Scene *scene) const;
+	ParseError parseChunk(const char *data, const Chunk &chunk,
+				Scene *scene, Node *root, Arena *arena,
+				std::string *message, bool *archives) const;
+	ParseError parseInput(Input *input, RibHandler *handler,
+				SymbolTable *symbols, InputStats *stats) const;
+	ParseError parseWith(Lexer *lexer, RibHandler *handler) const;
+
+	std::string cache_directory_;
 };
 
 } /* namespace rib */
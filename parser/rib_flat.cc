@@ -0,0 +1,911 @@
+/* ************************************************************************
+ * Copyright 2017 Alexander Mishurov
+ * 
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ * 
+ * http://www.apache.org/licenses/LICENSE-2.0
+ * 
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ * ************************************************************************/
+
+#include <algorithm>
+#include <sstream>
+#include <type_traits>
+#include <utility>
+#include "rib_flat.h"
+#include "rib_archive.h"
+#include "rib_hash.h"
+#include "rib_walk.h"
+
+namespace rib {
+
+const unsigned kFlatWidth[kNodeTypeCount] = {
+	0,	// kJoint
+	0,	// kAttribute
+	3,	// kTranslate
+	4,	// kRotate
+	3,	// kScale
+	16,	// kConcatTransform
+	7,	// kHyperboloid
+	4,	// kParaboloid
+	5,	// kTorus
+	4,	// kCylinder
+	4,	// kSphere
+	3,	// kDisk
+	3,	// kCone
+	0,	// kPointsGeneralPolygons
+	0,	// kPointsPolygons
+	0,	// kPattern
+	0,	// kBxdf
+	0,	// kLight
+	0	// kArchive
+};
+
+} /* namespace rib */
+
+using namespace rib;
+
+template<typename T>
+static FlatRange Append(std::vector<T> *pool, const T *values, size_t count)
+{
+	FlatRange range;
+	range.begin = pool->size();
+	pool->insert(pool->end(), values, values + count);
+	range.end = pool->size();
+	return range;
+}
+
+// the parameters of a tree node, in the order they were given
+template<typename T>
+static FlatRange CopyParams(const SymbolMap<Array<T>> &map,
+			std::vector<T> *pool, std::vector<FlatParam> *params)
+{
+	FlatRange range;
+	range.begin = params->size();
+	for (auto it = map.begin(); it != map.end(); ++it) {
+		FlatParam param;
+		param.key = it->first;
+		param.values = Append(pool, it->second.data(),
+						it->second.size());
+		params->push_back(param);
+	}
+	range.end = params->size();
+	return range;
+}
+
+static const FlatParam *Find(const std::vector<FlatParam> &params,
+				const FlatRange &range, Symbol key)
+{
+	for (size_t i = range.begin; i < range.end; i++) {
+		if (params[i].key == key)
+			return &params[i];
+	}
+	return nullptr;
+}
+
+void FlatScene::clear()
+{
+	types.assign(1, kJoint);
+	ends.assign(1, 1);
+	items.assign(1, 0);
+	worlds.assign(1, 0);
+	ids.assign(1, 0);
+	matrices.assign(1, Matrix::Identity());
+	for (int i = 0; i < kNodeTypeCount; i++)
+		rows[i].clear();
+	meshes.clear();
+	shaders.clear();
+	archives.clear();
+	params.clear();
+	string_params.clear();
+	primvars.clear();
+	ints.clear();
+	data.clear();
+	strings.clear();
+	contents.clear();
+}
+
+const FlatParam *FlatScene::findParam(const FlatRange &range,
+					Symbol key) const
+{
+	return Find(params, range, key);
+}
+
+const FlatParam *FlatScene::findStringParam(const FlatRange &range,
+					Symbol key) const
+{
+	return Find(string_params, range, key);
+}
+
+const FlatPrimvar *FlatScene::findPrimvar(const FlatMesh &mesh,
+					Symbol name) const
+{
+	unsigned id = name.id();
+	if (id >= 1 && id <= kWellKnownSymbols) {
+		uint32_t slot = mesh.standard[id - 1];
+		return slot != 0 ? &primvars[slot - 1] : nullptr;
+	}
+	for (size_t i = mesh.primvars.begin; i < mesh.primvars.end; i++) {
+		if (primvars[i].declaration.name == name)
+			return &primvars[i];
+	}
+	return nullptr;
+}
+
+// A transform's matrix goes before the one in effect, every block
+// starts from the matrix in effect where it is and is left with it.
+static void PlaceInWorld(FlatScene *scene)
+{
+	struct Placer : public FlatVisitor {
+		FlatScene *scene;
+		uint32_t current;
+		// in effect where each block the walk is in began
+		std::vector<uint32_t> saved;
+
+		bool enter(size_t node)
+		{
+			const float *row = scene->row(node);
+			Matrix local;
+			switch (scene->type(node)) {
+			case kTranslate:
+				local = Matrix::Translate(row[0], row[1], row[2]);
+				break;
+			case kRotate:
+				local = Matrix::Rotate(row[0], row[1], row[2],
+								row[3]);
+				break;
+			case kScale:
+				local = Matrix::Scale(row[0], row[1], row[2]);
+				break;
+			case kConcatTransform:
+				local = Matrix::FromRows(row);
+				break;
+			default:
+				scene->worlds[node] = current;
+				if (scene->ends[node] > node + 1)
+					saved.push_back(current);
+				return true;
+			}
+			scene->matrices.push_back(
+				local * scene->matrices[current]);
+			current = (uint32_t) scene->matrices.size() - 1;
+			scene->worlds[node] = current;
+			return true;
+		}
+		void leave(size_t node)
+		{
+			if (scene->ends[node] == node + 1)
+				return;
+			current = saved.back();
+			saved.pop_back();
+		}
+	};
+	scene->worlds.assign(scene->size(), 0);
+	scene->matrices.assign(1, Matrix::Identity());
+	Placer placer;
+	placer.scene = scene;
+	placer.current = 0;
+	Walk(*scene, placer);
+}
+
+namespace {
+
+class FlatHasher {
+public:
+	FlatHasher(NodeType type) : hash_(HashBytes(&type, sizeof(type))) {}
+
+	void add(const void *data, size_t size)
+		{ hash_ = HashBytes(data, size, hash_); }
+	void add(uint64_t value) { add(&value, sizeof(value)); }
+	// symbols by their strings, the ids differ from table to table
+	void add(Symbol symbol)
+		{ add(symbol.str().data(), symbol.str().size()); }
+	template<typename T>
+	void add(const std::vector<T> &pool, const FlatRange &range)
+	{
+		add((uint64_t) range.size());
+		add(pool.data() + range.begin, range.size() * sizeof(T));
+	}
+	void add(const std::vector<Symbol> &pool, const FlatRange &range)
+	{
+		add((uint64_t) range.size());
+		for (size_t i = range.begin; i < range.end; i++)
+			add(pool[i]);
+	}
+	// with the pool the values are in
+	template<typename T>
+	void add(const FlatRange &params, const std::vector<FlatParam> &from,
+					const std::vector<T> &pool)
+	{
+		add((uint64_t) params.size());
+		for (size_t i = params.begin; i < params.end; i++) {
+			add(from[i].key);
+			add(pool, from[i].values);
+		}
+	}
+
+	uint64_t hash() const { return hash_; }
+private:
+	uint64_t hash_;
+};
+
+} // namespace
+
+// what the node itself holds, not its subtree
+static uint64_t HashContents(const FlatScene &scene, size_t node)
+{
+	NodeType type = scene.type(node);
+	FlatHasher h(type);
+	if (kFlatWidth[type] > 0) {
+		h.add(scene.row(node), kFlatWidth[type] * sizeof(float));
+		return h.hash();
+	}
+	switch (type) {
+	case kPointsGeneralPolygons:
+	case kPointsPolygons:
+		{
+			const FlatMesh &mesh = scene.meshes[scene.items[node]];
+			h.add(scene.ints, mesh.nloops);
+			h.add(scene.ints, mesh.nvertices);
+			h.add(scene.ints, mesh.vertices);
+			h.add((uint64_t) mesh.primvars.size());
+			for (size_t i = mesh.primvars.begin;
+			     i < mesh.primvars.end; i++) {
+				const FlatPrimvar &primvar = scene.primvars[i];
+				const Declaration &declaration =
+							primvar.declaration;
+				h.add(declaration.name);
+				h.add((uint64_t) declaration.storage);
+				h.add((uint64_t) declaration.type);
+				h.add((uint64_t) declaration.arity);
+				if (declaration.type == kString)
+					h.add(scene.strings, primvar.values);
+				else
+					h.add(scene.data, primvar.values);
+			}
+		}
+		break;
+	case kAttribute:
+	case kPattern:
+	case kBxdf:
+	case kLight:
+		{
+			const FlatShader &shader =
+					scene.shaders[scene.items[node]];
+			h.add(shader.item_type);
+			h.add(shader.name);
+			h.add(shader.float_params, scene.params, scene.data);
+			h.add(shader.string_params, scene.string_params,
+							scene.strings);
+		}
+		break;
+	case kArchive:
+		{
+			const FlatArchive &archive =
+					scene.archives[scene.items[node]];
+			h.add(archive.filename.data(), archive.filename.size());
+			h.add(scene.data, archive.bound);
+			h.add((uint64_t) archive.delayed);
+		}
+		break;
+	default:
+		break;
+	}
+	return h.hash();
+}
+
+// Children come after their block, so going backwards every block's
+// children are hashed before it is.
+static void Identify(FlatScene *scene)
+{
+	size_t count = scene->size();
+	std::vector<uint64_t> contents(count);
+	for (size_t node = count; node-- > 0; ) {
+		uint64_t hash = HashContents(*scene, node);
+		for (size_t child = node + 1; child < scene->ends[node];
+		     child = scene->ends[child])
+			hash = HashBytes(&contents[child], sizeof(uint64_t),
+								hash);
+		contents[node] = hash;
+	}
+	scene->ids.assign(count, 0);
+	scene->ids[0] = contents[0];
+	for (size_t node = 0; node < count; node++) {
+		uint32_t place = 0;
+		for (size_t child = node + 1; child < scene->ends[node];
+		     child = scene->ends[child], place++)
+			scene->ids[child] = HashBytes(&place, sizeof(place),
+							contents[child]);
+	}
+}
+
+void FlatBuilder::onError(const Parser::location_type &location,
+				const std::string &message)
+{
+	if (message_ == nullptr) {
+		RibHandler::onError(location, message);
+		return;
+	}
+	// the parser gives up at the first one
+	if (message_->empty()) {
+		std::ostringstream out;
+		out << message << " at " << location;
+		*message_ = out.str();
+	}
+}
+
+size_t FlatBuilder::add(NodeType type, size_t item)
+{
+	size_t node = scene_->types.size();
+	scene_->types.push_back((uint8_t) type);
+	scene_->ends.push_back((uint32_t) node + 1);
+	scene_->items.push_back((uint32_t) item);
+	last_ = node;
+	return node;
+}
+
+void FlatBuilder::open(NodeType type, size_t item)
+{
+	open_.push_back(add(type, item));
+	last_ = std::string::npos;
+}
+
+void FlatBuilder::close()
+{
+	// an unbalanced end stays at the top
+	if (open_.size() < 2)
+		return;
+	last_ = open_.back();
+	scene_->ends[last_] = (uint32_t) scene_->types.size();
+	open_.pop_back();
+}
+
+void FlatBuilder::finish()
+{
+	while (open_.size() > 1)
+		close();
+	scene_->ends[0] = (uint32_t) scene_->types.size();
+	last_ = std::string::npos;
+	PlaceInWorld(scene_);
+	Identify(scene_);
+}
+
+void FlatBuilder::addRow(NodeType type, const float *values, size_t count)
+{
+	std::vector<float> &table = scene_->rows[type];
+	size_t width = kFlatWidth[type];
+	add(type, table.size() / width);
+	// a matrix of another size is cut or padded with zeros
+	count = std::min(count, width);
+	table.insert(table.end(), values, values + count);
+	table.resize(table.size() + width - count, 0.0f);
+}
+
+FlatMesh *FlatBuilder::addMesh(NodeType type)
+{
+	add(type, scene_->meshes.size());
+	scene_->meshes.push_back(FlatMesh());
+	FlatMesh *mesh = &scene_->meshes.back();
+	mesh->primvars.begin = mesh->primvars.end = scene_->primvars.size();
+	return mesh;
+}
+
+FlatShader *FlatBuilder::addShader(NodeType type, Symbol item_type,
+					Symbol name)
+{
+	add(type, scene_->shaders.size());
+	scene_->shaders.push_back(FlatShader());
+	FlatShader *shader = &scene_->shaders.back();
+	shader->item_type = item_type;
+	shader->name = name;
+	shader->float_params.begin = shader->float_params.end =
+						scene_->params.size();
+	shader->string_params.begin = shader->string_params.end =
+						scene_->string_params.size();
+	return shader;
+}
+
+size_t FlatBuilder::addArchive(const std::string &filename, bool delayed)
+{
+	size_t item = scene_->archives.size();
+	add(kArchive, item);
+	scene_->archives.push_back(FlatArchive());
+	scene_->archives.back().filename = filename;
+	scene_->archives.back().delayed = delayed;
+	scene_->archives.back().bound.begin =
+		scene_->archives.back().bound.end = scene_->data.size();
+	return item;
+}
+
+void FlatBuilder::addParam(NodeType type, Symbol key,
+				const Array<float> &value)
+{
+	if (last_ == std::string::npos || scene_->types[last_] != type)
+		return;
+	FlatRange *range = &scene_->shaders[scene_->items[last_]].float_params;
+	// like a tree node's, a key that is already there keeps its value
+	if (scene_->findParam(*range, key) != nullptr)
+		return;
+	FlatParam param;
+	param.key = key;
+	param.values = Append(&scene_->data, value.data(), value.size());
+	scene_->params.push_back(param);
+	range->end = scene_->params.size();
+}
+
+void FlatBuilder::addParam(NodeType type, Symbol key,
+				const Array<Symbol> &value)
+{
+	if (last_ == std::string::npos || scene_->types[last_] != type)
+		return;
+	FlatRange *range =
+		&scene_->shaders[scene_->items[last_]].string_params;
+	if (scene_->findStringParam(*range, key) != nullptr)
+		return;
+	FlatParam param;
+	param.key = key;
+	param.values = Append(&scene_->strings, value.data(), value.size());
+	scene_->string_params.push_back(param);
+	range->end = scene_->string_params.size();
+}
+
+static std::vector<float> *Pool(FlatScene *scene, const Array<float> &)
+{
+	return &scene->data;
+}
+
+static std::vector<Symbol> *Pool(FlatScene *scene, const Array<Symbol> &)
+{
+	return &scene->strings;
+}
+
+template<typename T>
+void FlatBuilder::addPrimvar(NodeType type, const Declaration &declaration,
+				const Array<T> &value)
+{
+	if (last_ == std::string::npos || scene_->types[last_] != type)
+		return;
+	FlatMesh *mesh = &scene_->meshes[scene_->items[last_]];
+	if (scene_->findPrimvar(*mesh, declaration.name) != nullptr)
+		return;
+	FlatPrimvar primvar;
+	primvar.declaration = declaration.holding(
+				std::is_same<T, Symbol>::value);
+	primvar.values = Append(Pool(scene_, value), value.data(),
+							value.size());
+	scene_->primvars.push_back(primvar);
+	mesh->primvars.end = scene_->primvars.size();
+	unsigned id = declaration.name.id();
+	if (id >= 1 && id <= kWellKnownSymbols)
+		mesh->standard[id - 1] = (uint32_t) scene_->primvars.size();
+}
+
+void FlatBuilder::onTranslate(float x, float y, float z)
+{
+	// the top level has nowhere to keep them
+	if (!keepsTransforms())
+		return;
+	const float row[] = {x, y, z};
+	addRow(kTranslate, row, 3);
+}
+
+void FlatBuilder::onRotate(float angle, float x, float y, float z)
+{
+	// the top level has nowhere to keep them
+	if (!keepsTransforms())
+		return;
+	const float row[] = {angle, x, y, z};
+	addRow(kRotate, row, 4);
+}
+
+void FlatBuilder::onScale(float x, float y, float z)
+{
+	// the top level has nowhere to keep them
+	if (!keepsTransforms())
+		return;
+	const float row[] = {x, y, z};
+	addRow(kScale, row, 3);
+}
+
+void FlatBuilder::onConcatTransform(Array<float> &matrix)
+{
+	// the top level has nowhere to keep them
+	if (!keepsTransforms())
+		return;
+	addRow(kConcatTransform, matrix.data(), matrix.size());
+}
+
+void FlatBuilder::onHyperboloid(float x1, float y1, float z1,
+			float x2, float y2, float z2, float thetamax)
+{
+	const float row[] = {x1, y1, z1, x2, y2, z2, thetamax};
+	addRow(kHyperboloid, row, 7);
+}
+
+void FlatBuilder::onParaboloid(float rmax, float zmin, float zmax,
+				float thetamax)
+{
+	const float row[] = {rmax, zmin, zmax, thetamax};
+	addRow(kParaboloid, row, 4);
+}
+
+void FlatBuilder::onTorus(float rmajor, float rminor, float phimin,
+				float phimax, float thetamax)
+{
+	const float row[] = {rmajor, rminor, phimin, phimax, thetamax};
+	addRow(kTorus, row, 5);
+}
+
+void FlatBuilder::onCylinder(float radius, float zmin, float zmax,
+				float thetamax)
+{
+	const float row[] = {radius, zmin, zmax, thetamax};
+	addRow(kCylinder, row, 4);
+}
+
+void FlatBuilder::onSphere(float radius, float zmin, float zmax,
+				float thetamax)
+{
+	const float row[] = {radius, zmin, zmax, thetamax};
+	addRow(kSphere, row, 4);
+}
+
+void FlatBuilder::onDisk(float height, float radius, float thetamax)
+{
+	const float row[] = {height, radius, thetamax};
+	addRow(kDisk, row, 3);
+}
+
+void FlatBuilder::onCone(float height, float radius, float thetamax)
+{
+	const float row[] = {height, radius, thetamax};
+	addRow(kCone, row, 3);
+}
+
+void FlatBuilder::onPointsGeneralPolygons(Array<int> &nloops,
+				Array<int> &nvertices,
+				Array<int> &vertices)
+{
+	FlatMesh *mesh = addMesh(kPointsGeneralPolygons);
+	std::vector<int> *ints = &scene_->ints;
+	mesh->nloops = Append(ints, nloops.data(), nloops.size());
+	mesh->nvertices = Append(ints, nvertices.data(), nvertices.size());
+	mesh->vertices = Append(ints, vertices.data(), vertices.size());
+}
+
+void FlatBuilder::onPointsGeneralPolygonsParam(
+				const Declaration &declaration,
+				Array<float> &value)
+{
+	addPrimvar(kPointsGeneralPolygons, declaration, value);
+}
+
+void FlatBuilder::onPointsGeneralPolygonsParam(
+				const Declaration &declaration,
+				Array<Symbol> &value)
+{
+	addPrimvar(kPointsGeneralPolygons, declaration, value);
+}
+
+void FlatBuilder::onPointsPolygons(Array<int> &nvertices,
+				Array<int> &vertices)
+{
+	FlatMesh *mesh = addMesh(kPointsPolygons);
+	std::vector<int> *ints = &scene_->ints;
+	mesh->nloops.begin = mesh->nloops.end = ints->size();
+	mesh->nvertices = Append(ints, nvertices.data(), nvertices.size());
+	mesh->vertices = Append(ints, vertices.data(), vertices.size());
+}
+
+void FlatBuilder::onPointsPolygonsParam(const Declaration &declaration,
+				Array<float> &value)
+{
+	addPrimvar(kPointsPolygons, declaration, value);
+}
+
+void FlatBuilder::onPointsPolygonsParam(const Declaration &declaration,
+				Array<Symbol> &value)
+{
+	addPrimvar(kPointsPolygons, declaration, value);
+}
+
+void FlatBuilder::onAttribute(Symbol name)
+{
+	addShader(kAttribute, Symbol(), name);
+}
+
+void FlatBuilder::onAttributeParam(Symbol key,
+				Array<float> &value)
+{
+	addParam(kAttribute, key, value);
+}
+
+void FlatBuilder::onPattern(Symbol item_type, Symbol name)
+{
+	addShader(kPattern, item_type, name);
+}
+
+void FlatBuilder::onPatternParam(Symbol key, Array<float> &value)
+{
+	addParam(kPattern, key, value);
+}
+
+void FlatBuilder::onPatternParam(Symbol key, Array<Symbol> &value)
+{
+	addParam(kPattern, key, value);
+}
+
+void FlatBuilder::onBxdf(Symbol item_type, Symbol name)
+{
+	addShader(kBxdf, item_type, name);
+}
+
+void FlatBuilder::onBxdfParam(Symbol key, Array<float> &value)
+{
+	addParam(kBxdf, key, value);
+}
+
+void FlatBuilder::onBxdfParam(Symbol key, Array<Symbol> &value)
+{
+	addParam(kBxdf, key, value);
+}
+
+void FlatBuilder::onLight(Symbol item_type, Symbol name)
+{
+	addShader(kLight, item_type, name);
+}
+
+void FlatBuilder::onLightParam(Symbol key, Array<float> &value)
+{
+	addParam(kLight, key, value);
+}
+
+void FlatBuilder::onLightParam(Symbol key, Array<Symbol> &value)
+{
+	addParam(kLight, key, value);
+}
+
+void FlatBuilder::onReadArchive(Symbol filename)
+{
+	std::string path = ResolveArchive(directory_, filename.str());
+	std::shared_ptr<const Scene> contents =
+				ArchiveCache::instance().load(path);
+	addArchive(path, false);
+	if (contents) {
+		scene_->contents.push_back(contents);
+		open_.push_back(last_);
+		addTree(&contents->root);
+		close();
+	}
+}
+
+void FlatBuilder::onProcedural(Symbol name, Array<Symbol> &args,
+				Array<float> &bound)
+{
+	// the other procedurals run programs or load plugins
+	if (name.str() != "DelayedReadArchive" || args.empty())
+		return;
+	size_t item = addArchive(ResolveArchive(directory_, args[0].str()),
+									true);
+	scene_->archives[item].bound = Append(&scene_->data, bound.data(),
+								bound.size());
+}
+
+void FlatBuilder::onProcedural2(Symbol name, Symbol bound_function)
+{
+	procedural_ = std::string::npos;
+	if (name.str() != "DelayedReadArchive2")
+		return;
+	procedural_ = addArchive(std::string(), true);
+}
+
+// "float[6] bound" names the same parameter as "bound"
+static std::string ParamName(Symbol key)
+{
+	size_t space = key.str().find_last_of(' ');
+	return space == std::string::npos ? key.str()
+					: key.str().substr(space + 1);
+}
+
+void FlatBuilder::onProcedural2Param(Symbol key,
+				Array<float> &value)
+{
+	if (procedural_ != std::string::npos && ParamName(key) == "bound")
+		scene_->archives[procedural_].bound = Append(&scene_->data,
+						value.data(), value.size());
+}
+
+void FlatBuilder::onProcedural2Param(Symbol key,
+				Array<Symbol> &value)
+{
+	if (procedural_ != std::string::npos &&
+	    ParamName(key) == "filename" && !value.empty())
+		scene_->archives[procedural_].filename =
+			ResolveArchive(directory_, value[0].str());
+}
+
+const Node *FlatBuilder::openCopy(const Node *node)
+{
+	std::shared_ptr<const Scene> contents;
+	switch (node->type) {
+	case kJoint:
+		add(kJoint, 0);
+		break;
+	case kTranslate: {
+		const TranslateNode *n = (const TranslateNode *) node;
+		const float row[] = {n->x, n->y, n->z};
+		addRow(kTranslate, row, 3);
+		break;
+	}
+	case kRotate: {
+		const RotateNode *n = (const RotateNode *) node;
+		const float row[] = {n->r, n->x, n->y, n->z};
+		addRow(kRotate, row, 4);
+		break;
+	}
+	case kScale: {
+		const ScaleNode *n = (const ScaleNode *) node;
+		const float row[] = {n->x, n->y, n->z};
+		addRow(kScale, row, 3);
+		break;
+	}
+	case kConcatTransform: {
+		const ConcatTransformNode *n =
+					(const ConcatTransformNode *) node;
+		addRow(kConcatTransform, n->matrix.data(), n->matrix.size());
+		break;
+	}
+	case kHyperboloid: {
+		const HyperboloidNode *n = (const HyperboloidNode *) node;
+		const float row[] = {n->x1, n->y1, n->z1,
+					n->x2, n->y2, n->z2, n->thetamax};
+		addRow(kHyperboloid, row, 7);
+		break;
+	}
+	case kParaboloid: {
+		const ParaboloidNode *n = (const ParaboloidNode *) node;
+		const float row[] = {n->rmax, n->zmin, n->zmax, n->thetamax};
+		addRow(kParaboloid, row, 4);
+		break;
+	}
+	case kTorus: {
+		const TorusNode *n = (const TorusNode *) node;
+		const float row[] = {n->rmajor, n->rminor, n->phimin,
+						n->phimax, n->thetamax};
+		addRow(kTorus, row, 5);
+		break;
+	}
+	case kCylinder: {
+		const CylinderNode *n = (const CylinderNode *) node;
+		const float row[] = {n->radius, n->zmin, n->zmax,
+							n->thetamax};
+		addRow(kCylinder, row, 4);
+		break;
+	}
+	case kSphere: {
+		const SphereNode *n = (const SphereNode *) node;
+		const float row[] = {n->radius, n->zmin, n->zmax,
+							n->thetamax};
+		addRow(kSphere, row, 4);
+		break;
+	}
+	case kDisk: {
+		const DiskNode *n = (const DiskNode *) node;
+		const float row[] = {n->height, n->radius, n->thetamax};
+		addRow(kDisk, row, 3);
+		break;
+	}
+	case kCone: {
+		const ConeNode *n = (const ConeNode *) node;
+		const float row[] = {n->height, n->radius, n->thetamax};
+		addRow(kCone, row, 3);
+		break;
+	}
+	case kPointsGeneralPolygons:
+	case kPointsPolygons: {
+		const Array<int> *nloops = nullptr;
+		const Array<int> *nvertices;
+		const Array<int> *vertices;
+		const PrimvarTable *primvars;
+		if (node->type == kPointsGeneralPolygons) {
+			const PointsGeneralPolygonsNode *n =
+				(const PointsGeneralPolygonsNode *) node;
+			nloops = &n->nloops;
+			nvertices = &n->nvertices;
+			vertices = &n->vertices;
+			primvars = &n->primvars;
+		} else {
+			const PointsPolygonsNode *n =
+				(const PointsPolygonsNode *) node;
+			nvertices = &n->nvertices;
+			vertices = &n->vertices;
+			primvars = &n->primvars;
+		}
+		FlatMesh *mesh = addMesh(node->type);
+		std::vector<int> *ints = &scene_->ints;
+		if (nloops != nullptr)
+			mesh->nloops = Append(ints, nloops->data(),
+							nloops->size());
+		else
+			mesh->nloops.begin = mesh->nloops.end = ints->size();
+		mesh->nvertices = Append(ints, nvertices->data(),
+							nvertices->size());
+		mesh->vertices = Append(ints, vertices->data(),
+							vertices->size());
+		for (PrimvarTable::const_iterator it = primvars->begin();
+		     it != primvars->end(); ++it) {
+			if (it->declaration.type == kString)
+				addPrimvar(node->type, it->declaration,
+							it->strings);
+			else
+				addPrimvar(node->type, it->declaration,
+							it->numbers);
+		}
+		break;
+	}
+	case kAttribute:
+	case kPattern:
+	case kBxdf:
+	case kLight: {
+		const AttributeNode *n = (const AttributeNode *) node;
+		FlatShader *shader = addShader(node->type, n->item_type,
+								n->name);
+		shader->float_params = CopyParams(n->float_params,
+					&scene_->data, &scene_->params);
+		shader->string_params = CopyParams(n->string_params,
+				&scene_->strings, &scene_->string_params);
+		break;
+	}
+	case kArchive: {
+		const ArchiveNode *n = (const ArchiveNode *) node;
+		size_t item = addArchive(n->filename, n->delayed);
+		scene_->archives[item].bound = Append(&scene_->data,
+					n->bound.data(), n->bound.size());
+		// delayed ones are left as they are
+		contents = n->loaded();
+		break;
+	}
+	}
+	open_.push_back(last_);
+	last_ = std::string::npos;
+	if (!contents)
+		return nullptr;
+	scene_->contents.push_back(contents);
+	return &contents->root;
+}
+
+void FlatBuilder::addTree(const Node *node)
+{
+	// an archive's contents come before any children
+	struct Copier : public Visitor {
+		FlatBuilder *builder;
+		const Node *contents;
+
+		bool enter(const Node *node)
+		{
+			contents = builder->openCopy(node);
+			return true;
+		}
+		const Node *inside(const Node *node) { return contents; }
+		void leave(const Node *node) { builder->close(); }
+	};
+	Copier copier;
+	copier.builder = this;
+	copier.contents = nullptr;
+	Walk(node, copier);
+}
+
+void rib::Flatten(const Node &root, FlatScene *scene)
+{
+	scene->clear();
+	FlatBuilder builder(scene);
+	for (size_t i = 0; i < root.children.size(); i++)
+		builder.addTree(root.children[i]);
+	builder.finish();
+}
@@ -0,0 +1,293 @@
+/* ************************************************************************
+ * Copyright 2017 Alexander Mishurov
+ * 
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ * 
+ * http://www.apache.org/licenses/LICENSE-2.0
+ * 
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ * ************************************************************************/
+
+#ifndef MAYAPLUGIN_RIBFLAT_H_
+#define MAYAPLUGIN_RIBFLAT_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+#include "parser/rib_driver.h"
+#include "parser/rib_transform.h"
+
+namespace rib {
+
+const int kNodeTypeCount = kArchive + 1;
+
+// Floats in a row of each type's table, in the order of the members
+// of the type's node class. 0 for the types with tables of their own.
+extern const unsigned kFlatWidth[kNodeTypeCount];
+
+// Where a node's values are in one of the pools.
+struct FlatRange {
+	size_t begin = 0;
+	size_t end = 0;
+	size_t size() const { return end - begin; }
+};
+
+struct FlatParam {
+	Symbol key;
+	FlatRange values;
+};
+
+// values in strings for the string type, in data for the others
+struct FlatPrimvar {
+	Declaration declaration;
+	FlatRange values;
+};
+
+// PointsPolygons and PointsGeneralPolygons, nloops is empty for the
+// first. The ranges are in ints but primvars, which is in primvars.
+struct FlatMesh {
+	FlatRange nloops;
+	FlatRange nvertices;
+	FlatRange vertices;
+	FlatRange primvars;
+	// 1 + where in primvars each standard name is, by its id, 0 if
+	// it isn't there
+	uint32_t standard[kWellKnownSymbols] = {};
+};
+
+// Attribute, Pattern, Bxdf and LightSource, the ranges are in params
+// and string_params.
+struct FlatShader {
+	Symbol item_type;
+	Symbol name;
+	FlatRange float_params;
+	FlatRange string_params;
+};
+
+struct FlatArchive {
+	std::string filename;
+	// in data, xmin xmax ymin ymax zmin zmax or empty
+	FlatRange bound;
+	bool delayed;
+};
+
+// The tree of a Scene laid out for walking instead of editing. Nodes
+// are in one array in depth first order, a node's subtree is the
+// nodes up to its end, and what a node holds is a row in the table of
+// its type. A walk is a loop over the nodes, the blocks still open
+// are those whose end is ahead. What an archive reads is its subtree.
+// Node 0 is the root, a joint holding everything else. Every node
+// has its object to world matrix at hand, so nothing replays the
+// transforms to draw it.
+class FlatScene {
+public:
+	FlatScene() { clear(); }
+	FlatScene(const FlatScene &) = delete;
+	FlatScene &operator=(const FlatScene &) = delete;
+
+	// leaves nothing but the root, the symbols, stats and message stay
+	void clear();
+
+	size_t size() const { return types.size(); }
+	NodeType type(size_t node) const { return (NodeType) types[node]; }
+	// what the transforms before the node in its blocks make of the
+	// world, a transform's own included
+	const Matrix &world(size_t node) const
+		{ return matrices[worlds[node]]; }
+	// the row of a transform or a quadric
+	const float *row(size_t node) const
+	{
+		return rows[types[node]].data() +
+				(size_t) items[node] * kFlatWidth[types[node]];
+	}
+	// the parameter in a range of params or string_params, null if
+	// it isn't there
+	const FlatParam *findParam(const FlatRange &range, Symbol key) const;
+	const FlatParam *findStringParam(const FlatRange &range,
+						Symbol key) const;
+	// a mesh's primitive variable, null if it isn't there
+	const FlatPrimvar *findPrimvar(const FlatMesh &mesh,
+						Symbol name) const;
+
+	// per node
+	std::vector<uint8_t> types;
+	std::vector<uint32_t> ends;
+	// the row in the table of the node's type
+	std::vector<uint32_t> items;
+	// where the node's world matrix is in matrices
+	std::vector<uint32_t> worlds;
+	// What the node is, alike for it in another parse of the file
+	// edited elsewhere: a hash of what it holds, a block's of what its
+	// children hold, mixed with its place among its block's children.
+	std::vector<uint64_t> ids;
+
+	// the tables
+	std::vector<float> rows[kNodeTypeCount];
+	std::vector<FlatMesh> meshes;
+	std::vector<FlatShader> shaders;
+	std::vector<FlatArchive> archives;
+	// the identity, then one for each transform
+	std::vector<Matrix> matrices;
+	// values in data
+	std::vector<FlatParam> params;
+	// values in strings
+	std::vector<FlatParam> string_params;
+	std::vector<FlatPrimvar> primvars;
+
+	// the pools the ranges point into
+	std::vector<int> ints;
+	std::vector<float> data;
+	std::vector<Symbol> strings;
+
+	SymbolTable symbols;
+	InputStats stats;
+	// the parser's complaint, empty if it had none
+	std::string message;
+	// archives whose nodes are copied in, they hold the symbols
+	// those nodes refer to
+	std::vector<std::shared_ptr<const Scene>> contents;
+};
+
+// Lays out the nodes in a FlatScene as the parser reduces them, under
+// the root after what is there. Like the TreeBuilder it drops
+// transforms outside any block, reads archives through the
+// ArchiveCache and leaves delayed ones as they are.
+class FlatBuilder : public RibHandler {
+public:
+	// errors go to the message if there is one, to stderr otherwise
+	FlatBuilder(FlatScene *scene, std::string *message = nullptr)
+	: scene_(scene), message_(message), open_(1, 0) {}
+	virtual ~FlatBuilder() {}
+	// hierarchy
+	virtual void onWorldBegin() { open(kJoint, 0); }
+	virtual void onWorldEnd() { close(); }
+	virtual void onAttributeBegin() { open(kJoint, 0); }
+	virtual void onAttributeEnd() { close(); }
+	virtual void onTransformBegin() { open(kJoint, 0); }
+	virtual void onTransformEnd() { close(); }
+	// transforms
+	virtual void onTranslate(float x, float y, float z);
+	virtual void onRotate(float angle, float x, float y, float z);
+	virtual void onScale(float x, float y, float z);
+	virtual void onConcatTransform(Array<float> &matrix);
+	// quadrics
+	virtual void onHyperboloid(float x1, float y1, float z1,
+				float x2, float y2, float z2,
+				float thetamax);
+	virtual void onParaboloid(float rmax, float zmin, float zmax,
+				float thetamax);
+	virtual void onTorus(float rmajor, float rminor, float phimin,
+				float phimax, float thetamax);
+	virtual void onCylinder(float radius, float zmin, float zmax,
+				float thetamax);
+	virtual void onSphere(float radius, float zmin, float zmax,
+				float thetamax);
+	virtual void onDisk(float height, float radius, float thetamax);
+	virtual void onCone(float height, float radius, float thetamax);
+	// primitives
+	virtual void onPointsGeneralPolygons(Array<int> &nloops,
+				Array<int> &nvertices,
+				Array<int> &vertices);
+	virtual void onPointsGeneralPolygonsParam(
+				const Declaration &declaration,
+				Array<float> &value);
+	virtual void onPointsGeneralPolygonsParam(
+				const Declaration &declaration,
+				Array<Symbol> &value);
+	virtual void onPointsPolygons(Array<int> &nvertices,
+				Array<int> &vertices);
+	virtual void onPointsPolygonsParam(const Declaration &declaration,
+				Array<float> &value);
+	virtual void onPointsPolygonsParam(const Declaration &declaration,
+				Array<Symbol> &value);
+	// rendering
+	virtual void onAttribute(Symbol name);
+	virtual void onAttributeParam(Symbol key,
+				Array<float> &value);
+	using RibHandler::onAttributeParam;
+	virtual void onPattern(Symbol item_type, Symbol name);
+	virtual void onPatternParam(Symbol key,
+				Array<float> &value);
+	virtual void onPatternParam(Symbol key,
+				Array<Symbol> &value);
+	virtual void onBxdf(Symbol item_type, Symbol name);
+	virtual void onBxdfParam(Symbol key,
+				Array<float> &value);
+	virtual void onBxdfParam(Symbol key,
+				Array<Symbol> &value);
+	virtual void onLight(Symbol item_type, Symbol name);
+	virtual void onLightParam(Symbol key,
+				Array<float> &value);
+	virtual void onLightParam(Symbol key,
+				Array<Symbol> &value);
+	// archives
+	virtual void onReadArchive(Symbol filename);
+	virtual void onProcedural(Symbol name, Array<Symbol> &args,
+				Array<float> &bound);
+	virtual void onProcedural2(Symbol name, Symbol bound_function);
+	virtual void onProcedural2Param(Symbol key,
+				Array<float> &value);
+	virtual void onProcedural2Param(Symbol key,
+				Array<Symbol> &value);
+
+	virtual void onError(const Parser::location_type &location,
+				const std::string &message);
+
+	// relative archive paths are looked up here first
+	void setDirectory(const std::string &directory)
+		{ directory_ = directory; }
+	// Adds a node of a tree with its subtree, archives with what they
+	// have loaded. The symbols stay those of the tree's scene.
+	void addTree(const Node *node);
+	// Ends the blocks left open and works out the world matrices and
+	// the ids, the scene is complete after it.
+	void finish();
+private:
+	// a node with nothing inside, or the start of a block
+	size_t add(NodeType type, size_t item);
+	void open(NodeType type, size_t item);
+	void close();
+	bool keepsTransforms() const { return open_.size() > 1; }
+	void addRow(NodeType type, const float *values, size_t count);
+	FlatMesh *addMesh(NodeType type);
+	FlatShader *addShader(NodeType type, Symbol item_type, Symbol name);
+	size_t addArchive(const std::string &filename, bool delayed);
+	// opens the node and hands out the contents of an archive
+	const Node *openCopy(const Node *node);
+	// to the last node if it is of the given type
+	void addParam(NodeType type, Symbol key,
+			const Array<float> &value);
+	void addParam(NodeType type, Symbol key,
+			const Array<Symbol> &value);
+	// to the last node if it is a mesh, strings or numbers
+	template<typename T>
+	void addPrimvar(NodeType type, const Declaration &declaration,
+			const Array<T> &value);
+
+	FlatScene *scene_;
+	std::string *message_;
+	std::string directory_;
+	// the blocks not yet ended, innermost last
+	std::vector<size_t> open_;
+	// the last node added to the innermost block, npos if none
+	size_t last_ = std::string::npos;
+	// of the last Procedural2 if it reads an archive, npos if not
+	size_t procedural_ = std::string::npos;
+};
+
+// Lays out a tree in a flat scene, which is cleared first. Archives
+// are laid out with what they have loaded. The symbols are those of
+// the tree's scene, which has to outlive the flat one.
+void Flatten(const Node &root, FlatScene *scene);
+
+} /* namespace rib */
+
+#endif  // MAYAPLUGIN_RIBFLAT_H_
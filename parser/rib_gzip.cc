@@ -0,0 +1,186 @@
+/* ************************************************************************
+ * Copyright 2017 Alexander Mishurov
+ * 
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ * 
+ * http://www.apache.org/licenses/LICENSE-2.0
+ * 
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ * ************************************************************************/
+
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <zlib.h>
+#include "rib_gzip.h"
+
+using namespace rib;
+
+namespace {
+
+typedef std::chrono::steady_clock Clock;
+
+// a few slots are enough to absorb the jitter between the stages,
+// more only cost memory
+const size_t kSlots = 4;
+const size_t kSlotSize = 1 << 18;
+const size_t kInputSize = 1 << 16;
+
+double Seconds(Clock::time_point start)
+{
+	return std::chrono::duration<double>(Clock::now() - start).count();
+}
+
+} // namespace
+
+bool rib::IsGzip(const char *data, size_t size)
+{
+	return size >= 2 && (unsigned char) data[0] == 0x1f &&
+		(unsigned char) data[1] == 0x8b;
+}
+
+GzipInput::GzipInput(Input *source)
+: source_(source), slots_(kSlots)
+{
+	for (size_t i = 0; i < slots_.size(); i++)
+		slots_[i].data.resize(kSlotSize);
+	thread_ = std::thread(&GzipInput::inflateLoop, this);
+}
+
+GzipInput::~GzipInput()
+{
+	{
+		std::lock_guard<std::mutex> lock(mutex_);
+		closed_ = true;
+	}
+	not_full_.notify_one();
+	thread_.join();
+}
+
+bool GzipInput::failed()
+{
+	std::lock_guard<std::mutex> lock(mutex_);
+	return finished_ && failed_;
+}
+
+void GzipInput::addStats(InputStats *stats)
+{
+	std::lock_guard<std::mutex> lock(mutex_);
+	stats->compressed_bytes += compressed_bytes_;
+	stats->inflate_seconds += inflate_seconds_;
+	stats->stall_seconds += stall_seconds_;
+	stats->wait_seconds += wait_seconds_;
+}
+
+size_t GzipInput::fill(char *buf, size_t size)
+{
+	while (!reading_ || read_pos_ == slots_[head_].size) {
+		std::unique_lock<std::mutex> lock(mutex_);
+		if (reading_) {
+			head_ = (head_ + 1) % kSlots;
+			filled_--;
+			reading_ = false;
+			not_full_.notify_one();
+		}
+		if (filled_ == 0 && !finished_) {
+			Clock::time_point start = Clock::now();
+			not_empty_.wait(lock, [this] {
+				return filled_ > 0 || finished_;
+			});
+			wait_seconds_ += Seconds(start);
+		}
+		if (filled_ == 0)
+			return 0;
+		reading_ = true;
+		read_pos_ = 0;
+	}
+	const Slot &slot = slots_[head_];
+	size_t count = std::min(size, slot.size - read_pos_);
+	memcpy(buf, slot.data.data() + read_pos_, count);
+	read_pos_ += count;
+	return count;
+}
+
+void GzipInput::inflateLoop()
+{
+	z_stream stream;
+	memset(&stream, 0, sizeof(stream));
+	// 16 selects the gzip wrapper
+	bool ok = inflateInit2(&stream, 15 + 16) == Z_OK;
+	failed_ = !ok;
+
+	std::vector<char> in(kInputSize);
+	bool in_eof = false;
+	bool member_end = false;
+	while (ok) {
+		size_t tail;
+		{
+			std::unique_lock<std::mutex> lock(mutex_);
+			Clock::time_point start = Clock::now();
+			not_full_.wait(lock, [this] {
+				return filled_ < kSlots || closed_;
+			});
+			stall_seconds_ += Seconds(start);
+			if (closed_)
+				break;
+			tail = (head_ + filled_) % kSlots;
+		}
+
+		Clock::time_point start = Clock::now();
+		Slot &slot = slots_[tail];
+		slot.size = 0;
+		bool done = false;
+		while (slot.size < slot.data.size()) {
+			if (stream.avail_in == 0 && !in_eof) {
+				size_t count = source_->read(in.data(), in.size());
+				compressed_bytes_ += count;
+				in_eof = count == 0;
+				stream.next_in = (Bytef *) in.data();
+				stream.avail_in = (uInt) count;
+			}
+			if (stream.avail_in == 0) {
+				failed_ = !member_end;
+				done = true;
+				break;
+			}
+			stream.next_out = (Bytef *) slot.data.data() + slot.size;
+			stream.avail_out = (uInt) (slot.data.size() - slot.size);
+			int ret = inflate(&stream, Z_NO_FLUSH);
+			slot.size = slot.data.size() - stream.avail_out;
+			if (ret == Z_STREAM_END) {
+				// another member may follow
+				member_end = true;
+				inflateReset(&stream);
+			} else if (ret == Z_OK) {
+				member_end = false;
+			} else {
+				// garbage after a complete member is ignored,
+				// as gzip does
+				failed_ = !member_end;
+				done = true;
+				break;
+			}
+		}
+
+		std::lock_guard<std::mutex> lock(mutex_);
+		inflate_seconds_ += Seconds(start);
+		if (slot.size > 0)
+			filled_++;
+		if (done)
+			break;
+		not_empty_.notify_one();
+	}
+	inflateEnd(&stream);
+
+	{
+		std::lock_guard<std::mutex> lock(mutex_);
+		finished_ = true;
+	}
+	not_empty_.notify_one();
+}
@@ -0,0 +1,80 @@
+/* ************************************************************************
+ * Copyright 2017 Alexander Mishurov
+ * 
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ * 
+ * http://www.apache.org/licenses/LICENSE-2.0
+ * 
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ * ************************************************************************/
+
+#ifndef MAYAPLUGIN_RIBGZIP_H_
+#define MAYAPLUGIN_RIBGZIP_H_
+
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include "parser/rib_input.h"
+
+namespace rib {
+
+// True if the data starts with the gzip magic number.
+bool IsGzip(const char *data, size_t size);
+
+// Inflates a gzip stream on a thread of its own. The thread fills a small
+// ring of buffers ahead of the lexer, so inflating one chunk overlaps
+// with lexing the previous one. Concatenated gzip members are read as
+// one stream.
+class GzipInput : public Input {
+public:
+	// the source is read by the inflate thread only and has to
+	// outlive this object
+	GzipInput(Input *source);
+	virtual ~GzipInput();
+
+	// True if the stream turned out corrupt or truncated.
+	bool failed();
+	void addStats(InputStats *stats);
+protected:
+	virtual size_t fill(char *buf, size_t size);
+private:
+	struct Slot {
+		std::vector<char> data;
+		size_t size = 0;
+	};
+
+	void inflateLoop();
+
+	Input *source_;
+	std::vector<Slot> slots_;
+	// ring state, guarded by mutex_
+	size_t head_ = 0;
+	size_t filled_ = 0;
+	bool finished_ = false;
+	bool closed_ = false;
+	std::mutex mutex_;
+	std::condition_variable not_empty_;
+	std::condition_variable not_full_;
+	// owned by the lexer side
+	bool reading_ = false;
+	size_t read_pos_ = 0;
+	double wait_seconds_ = 0.0;
+	// owned by the inflate thread until finished_ is set
+	bool failed_ = false;
+	size_t compressed_bytes_ = 0;
+	double inflate_seconds_ = 0.0;
+	double stall_seconds_ = 0.0;
+
+	std::thread thread_;
+};
+
+} /* namespace rib */
+
+#endif  // MAYAPLUGIN_RIBGZIP_H_
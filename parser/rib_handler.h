@@ -0,0 +1,126 @@
+/* ************************************************************************
+ * Copyright 2017 Alexander Mishurov
+ * 
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ * 
+ * http://www.apache.org/licenses/LICENSE-2.0
+ * 
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ * ************************************************************************/
+
+#ifndef MAYAPLUGIN_RIBHANDLER_H_
+#define MAYAPLUGIN_RIBHANDLER_H_
+
+#include <iostream>
+#include <string>
+#include "rib_parser.tab.hh"
+#include "parser/rib_arena.h"
+#include "parser/rib_primvar.h"
+#include "parser/rib_symbol.h"
+
+namespace rib {
+
+// Receives the requests as the parser reduces them, in file order.
+// Parameters of a primitive or a shader follow the request they
+// belong to, those of a primitive with their declarations taken
+// apart. Everything defaults to doing nothing.
+//
+// The arrays are built where arena() says, a handler that keeps them
+// moves them out of the callback instead of copying them. What is left
+// in them is gone once the callback returns, and with no arena the
+// parser frees everything as it goes, so a handler that doesn't build
+// anything parses in memory independent of the file size.
+class RibHandler {
+public:
+	virtual ~RibHandler() {}
+	// where the arrays are to live, null if nothing is kept
+	virtual Arena *arena() { return nullptr; }
+	// hierarchy
+	virtual void onWorldBegin() {}
+	virtual void onWorldEnd() {}
+	virtual void onAttributeBegin() {}
+	virtual void onAttributeEnd() {}
+	virtual void onTransformBegin() {}
+	virtual void onTransformEnd() {}
+	// transforms
+	virtual void onTranslate(float x, float y, float z) {}
+	virtual void onRotate(float angle, float x, float y, float z) {}
+	virtual void onScale(float x, float y, float z) {}
+	virtual void onConcatTransform(Array<float> &matrix) {}
+	// quadrics
+	virtual void onHyperboloid(float x1, float y1, float z1,
+				float x2, float y2, float z2,
+				float thetamax) {}
+	virtual void onParaboloid(float rmax, float zmin, float zmax,
+				float thetamax) {}
+	virtual void onTorus(float rmajor, float rminor, float phimin,
+				float phimax, float thetamax) {}
+	virtual void onCylinder(float radius, float zmin, float zmax,
+				float thetamax) {}
+	virtual void onSphere(float radius, float zmin, float zmax,
+				float thetamax) {}
+	virtual void onDisk(float height, float radius, float thetamax) {}
+	virtual void onCone(float height, float radius, float thetamax) {}
+	// primitives
+	virtual void onPointsGeneralPolygons(Array<int> &nloops,
+				Array<int> &nvertices,
+				Array<int> &vertices) {}
+	virtual void onPointsGeneralPolygonsParam(
+				const Declaration &declaration,
+				Array<float> &value) {}
+	virtual void onPointsGeneralPolygonsParam(
+				const Declaration &declaration,
+				Array<Symbol> &value) {}
+	virtual void onPointsPolygons(Array<int> &nvertices,
+				Array<int> &vertices) {}
+	virtual void onPointsPolygonsParam(const Declaration &declaration,
+				Array<float> &value) {}
+	virtual void onPointsPolygonsParam(const Declaration &declaration,
+				Array<Symbol> &value) {}
+	// rendering
+	virtual void onAttribute(Symbol name) {}
+	virtual void onAttributeParam(Symbol key,
+				Array<float> &value) {}
+	virtual void onAttributeParam(Symbol key,
+				Array<Symbol> &value) {}
+	virtual void onPattern(Symbol item_type, Symbol name) {}
+	virtual void onPatternParam(Symbol key,
+				Array<float> &value) {}
+	virtual void onPatternParam(Symbol key,
+				Array<Symbol> &value) {}
+	virtual void onBxdf(Symbol item_type, Symbol name) {}
+	virtual void onBxdfParam(Symbol key,
+				Array<float> &value) {}
+	virtual void onBxdfParam(Symbol key,
+				Array<Symbol> &value) {}
+	virtual void onLight(Symbol item_type, Symbol name) {}
+	virtual void onLightParam(Symbol key,
+				Array<float> &value) {}
+	virtual void onLightParam(Symbol key,
+				Array<Symbol> &value) {}
+	// archives
+	virtual void onReadArchive(Symbol filename) {}
+	virtual void onProcedural(Symbol name, Array<Symbol> &args,
+				Array<float> &bound) {}
+	virtual void onProcedural2(Symbol name, Symbol bound_function) {}
+	virtual void onProcedural2Param(Symbol key,
+				Array<float> &value) {}
+	virtual void onProcedural2Param(Symbol key,
+				Array<Symbol> &value) {}
+
+	virtual void onError(const Parser::location_type &location,
+				const std::string &message)
+	{
+		std::cerr << "Error: " << message << " at " << location << "\n";
+	}
+};
+
+} /* namespace rib */
+
+#endif  // MAYAPLUGIN_RIBHANDLER_H_
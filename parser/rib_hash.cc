@@ -0,0 +1,255 @@
+/* ************************************************************************
+ * Copyright 2017 Alexander Mishurov
+ * 
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ * 
+ * http://www.apache.org/licenses/LICENSE-2.0
+ * 
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ * ************************************************************************/
+
+#include <cstring>
+#include <string>
+#include "rib_hash.h"
+#include "rib_driver.h"
+#include "rib_walk.h"
+
+using namespace rib;
+
+namespace {
+
+const uint64_t kMultiplier = 0x9e3779b97f4a7c15ULL;
+
+inline uint64_t Mix(uint64_t h)
+{
+	h *= kMultiplier;
+	return h ^ (h >> 32);
+}
+
+class Hasher {
+public:
+	Hasher(NodeType type) : hash_(HashBytes(&type, sizeof(type))) {}
+
+	void add(const void *data, size_t size)
+		{ hash_ = HashBytes(data, size, hash_); }
+	void add(uint64_t value) { add(&value, sizeof(value)); }
+	void add(float value) { add(&value, sizeof(value)); }
+	void add(const std::string &str) { add(str.data(), str.size()); }
+	// symbols by their strings, the ids differ from table to table
+	void add(Symbol symbol) { add(symbol.str()); }
+	template<typename T>
+	void add(const Array<T> &values)
+	{
+		add((uint64_t) values.size());
+		add(values.data(), values.size() * sizeof(T));
+	}
+	void add(const Array<Symbol> &values)
+	{
+		add((uint64_t) values.size());
+		for (size_t i = 0; i < values.size(); i++)
+			add(values[i]);
+	}
+	template<typename T>
+	void add(const SymbolMap<T> &params)
+	{
+		add((uint64_t) params.size());
+		for (typename SymbolMap<T>::const_iterator it = params.begin();
+		     it != params.end(); ++it) {
+			add(it->first);
+			add(it->second);
+		}
+	}
+
+	void add(const PrimvarTable &primvars)
+	{
+		add((uint64_t) primvars.size());
+		for (PrimvarTable::const_iterator it = primvars.begin();
+		     it != primvars.end(); ++it) {
+			const Declaration &declaration = it->declaration;
+			add(declaration.name);
+			add((uint64_t) declaration.storage);
+			add((uint64_t) declaration.type);
+			add((uint64_t) declaration.arity);
+			add(it->numbers);
+			add(it->strings);
+		}
+	}
+
+	uint64_t hash() const { return hash_; }
+private:
+	uint64_t hash_;
+};
+
+void AddContents(const Node *node, Hasher *h)
+{
+	switch (node->type) {
+	case kJoint:
+		break;
+	case kTranslate:
+		{
+			const TranslateNode *n = (const TranslateNode *) node;
+			h->add(n->x); h->add(n->y); h->add(n->z);
+		}
+		break;
+	case kRotate:
+		{
+			const RotateNode *n = (const RotateNode *) node;
+			h->add(n->r); h->add(n->x); h->add(n->y); h->add(n->z);
+		}
+		break;
+	case kScale:
+		{
+			const ScaleNode *n = (const ScaleNode *) node;
+			h->add(n->x); h->add(n->y); h->add(n->z);
+		}
+		break;
+	case kConcatTransform:
+		h->add(((const ConcatTransformNode *) node)->matrix);
+		break;
+	case kHyperboloid:
+		{
+			const HyperboloidNode *n = (const HyperboloidNode *) node;
+			h->add(n->x1); h->add(n->y1); h->add(n->z1);
+			h->add(n->x2); h->add(n->y2); h->add(n->z2);
+			h->add(n->thetamax);
+		}
+		break;
+	case kParaboloid:
+		{
+			const ParaboloidNode *n = (const ParaboloidNode *) node;
+			h->add(n->rmax); h->add(n->zmin); h->add(n->zmax);
+			h->add(n->thetamax);
+		}
+		break;
+	case kTorus:
+		{
+			const TorusNode *n = (const TorusNode *) node;
+			h->add(n->rmajor); h->add(n->rminor);
+			h->add(n->phimin); h->add(n->phimax);
+			h->add(n->thetamax);
+		}
+		break;
+	case kCylinder:
+		{
+			const CylinderNode *n = (const CylinderNode *) node;
+			h->add(n->radius); h->add(n->zmin); h->add(n->zmax);
+			h->add(n->thetamax);
+		}
+		break;
+	case kSphere:
+		{
+			const SphereNode *n = (const SphereNode *) node;
+			h->add(n->radius); h->add(n->zmin); h->add(n->zmax);
+			h->add(n->thetamax);
+		}
+		break;
+	case kDisk:
+		{
+			const DiskNode *n = (const DiskNode *) node;
+			h->add(n->height); h->add(n->radius);
+			h->add(n->thetamax);
+		}
+		break;
+	case kCone:
+		{
+			const ConeNode *n = (const ConeNode *) node;
+			h->add(n->height); h->add(n->radius);
+			h->add(n->thetamax);
+		}
+		break;
+	case kPointsGeneralPolygons:
+		{
+			const PointsGeneralPolygonsNode *n =
+				(const PointsGeneralPolygonsNode *) node;
+			h->add(n->nloops);
+			h->add(n->nvertices);
+			h->add(n->vertices);
+			h->add(n->primvars);
+		}
+		break;
+	case kPointsPolygons:
+		{
+			const PointsPolygonsNode *n =
+				(const PointsPolygonsNode *) node;
+			h->add(n->nvertices);
+			h->add(n->vertices);
+			h->add(n->primvars);
+		}
+		break;
+	case kAttribute:
+	case kPattern:
+	case kBxdf:
+	case kLight:
+		{
+			const AttributeNode *n = (const AttributeNode *) node;
+			h->add(n->item_type);
+			h->add(n->name);
+			h->add(n->string_params);
+			h->add(n->float_params);
+		}
+		break;
+	case kArchive:
+		{
+			const ArchiveNode *n = (const ArchiveNode *) node;
+			h->add(n->filename);
+			h->add(n->bound);
+			h->add((uint64_t) n->delayed);
+			// an edited asset changes whoever reads it
+			std::shared_ptr<const Scene> contents = n->loaded();
+			h->add(contents ? contents->root.hash : 0);
+		}
+		break;
+	}
+}
+
+} // namespace
+
+uint64_t rib::HashBytes(const void *data, size_t size, uint64_t seed)
+{
+	const unsigned char *p = (const unsigned char *) data;
+	uint64_t h = seed ^ Mix(size + 1);
+	for (; size >= 8; p += 8, size -= 8) {
+		uint64_t word;
+		memcpy(&word, p, 8);
+		h = Mix(h ^ word);
+	}
+	uint64_t tail = 0;
+	// empty arrays may have no data at all
+	if (size > 0)
+		memcpy(&tail, p, size);
+	h = Mix(Mix(h ^ tail));
+	return h != 0 ? h : 1;
+}
+
+namespace {
+
+// the children are sealed by the time their parent is left
+class Sealer : public Visitor {
+public:
+	Sealer(Node *root) : root_(root) {}
+	bool enter(Node *node) { return node == root_ || node->hash == 0; }
+	void leave(Node *node)
+	{
+		Hasher h(node->type);
+		AddContents(node, &h);
+		for (size_t i = 0; i < node->children.size(); i++)
+			h.add(node->children[i]->hash);
+		node->hash = h.hash();
+	}
+private:
+	Node *root_;
+};
+
+} // namespace
+
+void rib::SealHash(Node *node)
+{
+	Sealer sealer(node);
+	Walk(node, sealer);
+}
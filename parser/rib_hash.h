@@ -0,0 +1,36 @@
+/* ************************************************************************
+ * Copyright 2017 Alexander Mishurov
+ * 
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ * 
+ * http://www.apache.org/licenses/LICENSE-2.0
+ * 
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ * ************************************************************************/
+
+#ifndef MAYAPLUGIN_RIBHASH_H_
+#define MAYAPLUGIN_RIBHASH_H_
+
+#include <cstddef>
+#include <cstdint>
+
+namespace rib {
+
+class Node;
+
+// A fast non-cryptographic hash, never 0.
+uint64_t HashBytes(const void *data, size_t size, uint64_t seed = 0);
+
+// Sets the node's hash from its type, its values and its children's
+// hashes, sealing the children that have none yet first.
+void SealHash(Node *node);
+
+} /* namespace rib */
+
+#endif  // MAYAPLUGIN_RIBHASH_H_
@@ -0,0 +1,205 @@
+/* ************************************************************************
+ * Copyright 2017 Alexander Mishurov
+ * 
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ * 
+ * http://www.apache.org/licenses/LICENSE-2.0
+ * 
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ * ************************************************************************/
+
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+#include "rib_input.h"
+
+#include <sys/types.h>
+#include <sys/stat.h>
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
+
+using namespace rib;
+
+// mmap refuses zero-length mappings, empty files get this instead
+static const char kEmpty[] = "";
+
+size_t Input::read(char *buf, size_t size)
+{
+	if (peeked_pos_ < peeked_.size()) {
+		size_t count = std::min(size, peeked_.size() - peeked_pos_);
+		memcpy(buf, peeked_.data() + peeked_pos_, count);
+		peeked_pos_ += count;
+		consumed_ += count;
+		return count;
+	}
+	size_t count = fill(buf, size);
+	consumed_ += count;
+	return count;
+}
+
+size_t Input::peek(const char **data, size_t size)
+{
+	char chunk[4096];
+	while (peeked_.size() < size) {
+		size_t count = fill(chunk, std::min(size - peeked_.size(),
+							sizeof(chunk)));
+		if (count == 0)
+			break;
+		peeked_.append(chunk, count);
+	}
+	*data = peeked_.data();
+	return std::min(size, peeked_.size());
+}
+
+size_t MemoryInput::fill(char *buf, size_t size)
+{
+	size_t count = std::min(size, (size_t) (end_ - pos_));
+	// a null or empty buffer has nothing to copy from
+	if (count == 0)
+		return 0;
+	memcpy(buf, pos_, count);
+	pos_ += count;
+	return count;
+}
+
+size_t StreamInput::fill(char *buf, size_t size)
+{
+	in_->read(buf, size);
+	return (size_t) in_->gcount();
+}
+
+MappedFile::~MappedFile()
+{
+	close();
+}
+
+#ifdef _WIN32
+
+bool MappedFile::open(const char * const filename)
+{
+	close();
+	HANDLE file = CreateFileA(filename, GENERIC_READ, FILE_SHARE_READ,
+				NULL, OPEN_EXISTING,
+				FILE_FLAG_SEQUENTIAL_SCAN, NULL);
+	if (file == INVALID_HANDLE_VALUE)
+		return false;
+
+	LARGE_INTEGER size;
+	if (!GetFileSizeEx(file, &size)) {
+		CloseHandle(file);
+		return false;
+	}
+	file_ = file;
+	if (size.QuadPart == 0) {
+		data_ = kEmpty;
+		return true;
+	}
+
+	HANDLE mapping = CreateFileMappingA(file, NULL, PAGE_READONLY,
+						0, 0, NULL);
+	if (mapping == NULL) {
+		close();
+		return false;
+	}
+	mapping_ = mapping;
+
+	void *view = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+	if (view == NULL) {
+		close();
+		return false;
+	}
+	data_ = static_cast<const char *>(view);
+	size_ = static_cast<size_t>(size.QuadPart);
+	return true;
+}
+
+void MappedFile::close()
+{
+	if (data_ != nullptr && data_ != kEmpty)
+		UnmapViewOfFile(data_);
+	if (mapping_ != nullptr)
+		CloseHandle(mapping_);
+	if (file_ != nullptr)
+		CloseHandle(file_);
+	data_ = nullptr;
+	size_ = 0;
+	mapping_ = nullptr;
+	file_ = nullptr;
+}
+
+#else
+
+bool MappedFile::open(const char * const filename)
+{
+	close();
+	int fd = ::open(filename, O_RDONLY);
+	if (fd < 0)
+		return false;
+
+	struct stat st;
+	if (fstat(fd, &st) != 0 || !S_ISREG(st.st_mode)) {
+		::close(fd);
+		return false;
+	}
+	if (st.st_size == 0) {
+		::close(fd);
+		data_ = kEmpty;
+		return true;
+	}
+
+	void *view = mmap(nullptr, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+	// the mapping keeps its own reference to the file
+	::close(fd);
+	if (view == MAP_FAILED)
+		return false;
+	madvise(view, st.st_size, MADV_SEQUENTIAL);
+
+	data_ = static_cast<const char *>(view);
+	size_ = static_cast<size_t>(st.st_size);
+	return true;
+}
+
+void MappedFile::close()
+{
+	if (data_ != nullptr && data_ != kEmpty)
+		munmap(const_cast<char *>(data_), size_);
+	data_ = nullptr;
+	size_ = 0;
+}
+
+#endif
+
+bool rib::StampFile(const char * const filename, FileStamp *stamp)
+{
+	struct stat st;
+	if (stat(filename, &st) != 0)
+		return false;
+	stamp->mtime = (long long) st.st_mtime;
+	stamp->size = (long long) st.st_size;
+	return true;
+}
+
+std::string rib::FullPath(const char * const filename)
+{
+#ifdef _WIN32
+	char *full = _fullpath(nullptr, filename, 0);
+#else
+	char *full = realpath(filename, nullptr);
+#endif
+	if (full == nullptr)
+		return filename;
+	std::string path(full);
+	free(full);
+	return path;
+}
@@ -0,0 +1,126 @@
+/* ************************************************************************
+ * Copyright 2017 Alexander Mishurov
+ * 
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ * 
+ * http://www.apache.org/licenses/LICENSE-2.0
+ * 
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ * ************************************************************************/
+
+#ifndef MAYAPLUGIN_RIBINPUT_H_
+#define MAYAPLUGIN_RIBINPUT_H_
+
+#include <cstddef>
+#include <istream>
+#include <string>
+
+namespace rib {
+
+// Timings of the last parse. Compressed input is inflated on a thread of
+// its own, so the two stages are measured separately: inflate_seconds is
+// the time that thread was busy, the parse stage is parse_seconds less
+// the time it spent waiting for inflated data.
+struct InputStats {
+	size_t compressed_bytes = 0;
+	size_t bytes = 0;
+	double inflate_seconds = 0.0;
+	double parse_seconds = 0.0;
+	double wait_seconds = 0.0;
+	double stall_seconds = 0.0;
+};
+
+// Where the lexers get their bytes from.
+class Input {
+public:
+	Input() = default;
+	Input(const Input &) = delete;
+	Input &operator=(const Input &) = delete;
+	virtual ~Input() {}
+
+	// Copies up to size bytes to buf, returns 0 at the end of the input.
+	size_t read(char *buf, size_t size);
+	// Makes up to size bytes from the start of the input available
+	// without consuming them, so the encoding can be sniffed.
+	size_t peek(const char **data, size_t size);
+	// Bytes handed out by read() so far.
+	size_t consumed() const { return consumed_; }
+protected:
+	virtual size_t fill(char *buf, size_t size) = 0;
+private:
+	std::string peeked_;
+	size_t peeked_pos_ = 0;
+	size_t consumed_ = 0;
+};
+
+class MemoryInput : public Input {
+public:
+	MemoryInput(const char *data, size_t size)
+	: pos_(data), end_(data + size) {}
+protected:
+	virtual size_t fill(char *buf, size_t size);
+private:
+	const char *pos_;
+	const char *end_;
+};
+
+class StreamInput : public Input {
+public:
+	StreamInput(std::istream *in) : in_(in) {}
+protected:
+	virtual size_t fill(char *buf, size_t size);
+private:
+	std::istream *in_;
+};
+
+// A read-only view of a whole file mapped into memory. The lexer reads
+// straight from the mapping, so there is no stream buffer in between
+// and no read() call per chunk.
+class MappedFile {
+public:
+	MappedFile() = default;
+	MappedFile(const MappedFile &) = delete;
+	MappedFile &operator=(const MappedFile &) = delete;
+	~MappedFile();
+
+	bool open(const char * const filename);
+	void close();
+
+	const char *data() const { return data_; }
+	size_t size() const { return size_; }
+private:
+	const char *data_ = nullptr;
+	size_t size_ = 0;
+#ifdef _WIN32
+	void *file_ = nullptr;
+	void *mapping_ = nullptr;
+#endif
+};
+
+// Enough of a file's metadata to tell that it changed.
+struct FileStamp {
+	long long mtime = 0;
+	long long size = 0;
+
+	bool operator==(const FileStamp &other) const
+		{ return mtime == other.mtime && size == other.size; }
+	bool operator!=(const FileStamp &other) const
+		{ return !(*this == other); }
+};
+
+// False if there is no such file.
+bool StampFile(const char * const filename, FileStamp *stamp);
+
+// The absolute path with links and dots resolved, the filename as it
+// is if there is no such file.
+std::string FullPath(const char * const filename);
+
+} /* namespace rib */
+
+#endif  // MAYAPLUGIN_RIBINPUT_H_
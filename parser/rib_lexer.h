@@ -22,20 +22,68 @@
 #endif
 
 #include "rib_parser.tab.hh"
+#include "parser/rib_arena.h"
+#include "parser/rib_primvar.h"
+#include "parser/rib_symbol.h"
 
 namespace rib {
 
+class Input;
+
 class Lexer : public yyFlexLexer {
 public:
-	Lexer(std::istream *in) : yyFlexLexer(in) {
+	// strings are interned in symbols, both have to outlive the lexer
+	Lexer(std::istream *in, SymbolTable *symbols)
+	: yyFlexLexer(in), symbols_(symbols) {
+	};
+	Lexer(Input *input, SymbolTable *symbols)
+	: yyFlexLexer(nullptr), symbols_(symbols), input_(input) {
 	};
 	virtual ~Lexer() {};
 
+	// where the text starts in the file, for error messages
+	void setFirstLine(int line) { first_line_ = line; }
+	int firstLine() const { return first_line_; }
+
+	// Where the arrays handed to the parser keep their elements, so a
+	// handler can take them over as they are. Null means an arena of
+	// the lexer's own, which freeScratch() empties.
+	void setArena(Arena *arena)
+		{ arena_ = arena != nullptr ? arena : &scratch_; }
+	Arena *arena() const { return arena_; }
+	// An empty array, valid until freeScratch().
+	template<typename T>
+	Array<T> *newArray() { return scratch_.create<Array<T>>(); }
+	// Gives back what is left in an array the parser is done with, if
+	// nothing was allocated after it.
+	template<typename T>
+	void drop(Array<T> *array)
+	{
+		array->clear();
+		array->shrink(arena_);
+	}
+	// Frees the arrays made so far once there is more than a little
+	// of them. Only between requests, when the parser holds none.
+	void freeScratch();
+	// A parameter's key taken apart, only once for the keys seen
+	// lately. Valid until the next call.
+	const Declaration &declaration(Symbol key);
+
 	using FlexLexer::yylex;
 	virtual int yylex(rib::Parser::semantic_type * const lval,
 			  rib::Parser::location_type * location);
+protected:
+	virtual int LexerInput(char *buf, int max_size);
+
+	SymbolCache symbols_;
 private:
 	rib::Parser::semantic_type *yylval = nullptr;
+	int first_line_ = 1;
+	Input *input_ = nullptr;
+	Arena scratch_;
+	Arena *arena_ = &scratch_;
+	static const unsigned kDeclarations = 64;
+	Declaration declarations_[kDeclarations];
 };
 
 } /* namespace rib */
@@ -0,0 +1,270 @@
+/* ************************************************************************
+ * Copyright 2017 Alexander Mishurov
+ * 
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ * 
+ * http://www.apache.org/licenses/LICENSE-2.0
+ * 
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ * ************************************************************************/
+
+#include <climits>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <limits>
+#include <locale.h>
+#include <string>
+#ifdef __APPLE__
+#include <xlocale.h>
+#endif
+#include "rib_number.h"
+
+using namespace rib;
+
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ != __ORDER_LITTLE_ENDIAN__
+#define RIB_NUMBER_NO_SWAR
+#endif
+
+namespace {
+
+// a mantissa that fits 19 digits can't overflow 64 bits
+const int kMaxDigits = 19;
+
+// Anything at or below 1e-46 rounds to zero and anything from 1e39 up
+// overflows, so with up to 19 mantissa digits these are all the powers
+// a float conversion can need.
+const int kMinExponent = -46;
+const int kMaxExponent = 38;
+
+const double kPow10[] = {
+	1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9,
+	1e10, 1e11, 1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19,
+	1e20, 1e21, 1e22, 1e23, 1e24, 1e25, 1e26, 1e27, 1e28, 1e29,
+	1e30, 1e31, 1e32, 1e33, 1e34, 1e35, 1e36, 1e37, 1e38, 1e39,
+	1e40, 1e41, 1e42, 1e43, 1e44, 1e45, 1e46, 1e47, 1e48, 1e49,
+	1e50, 1e51, 1e52, 1e53, 1e54, 1e55, 1e56, 1e57, 1e58, 1e59,
+	1e60, 1e61, 1e62, 1e63, 1e64, 1e65
+};
+
+const float kPow10f[] = {
+	1e0f, 1e1f, 1e2f, 1e3f, 1e4f, 1e5f, 1e6f, 1e7f, 1e8f, 1e9f, 1e10f
+};
+
+// The double estimate below is off by a few units in the last place at
+// most, 2^-50 relative leaves a wide margin.
+const double kEstimateError = 8.8817841970012523e-16;
+
+inline bool IsDigit(char c)
+{
+	return (unsigned char) (c - '0') < 10;
+}
+
+#ifndef RIB_NUMBER_NO_SWAR
+
+// Eight ASCII digits are tested and converted as one 64 bit word,
+// which is where most of the time goes on long mantissas.
+
+inline uint64_t LoadEight(const char *p)
+{
+	uint64_t v;
+	memcpy(&v, p, sizeof(v));
+	return v;
+}
+
+inline bool IsEightDigits(uint64_t v)
+{
+	return (((v & 0xF0F0F0F0F0F0F0F0) |
+		(((v + 0x0606060606060606) & 0xF0F0F0F0F0F0F0F0) >> 4)) ==
+		0x3333333333333333);
+}
+
+inline uint32_t EightDigits(uint64_t v)
+{
+	const uint64_t mask = 0x000000FF000000FF;
+	const uint64_t mul1 = 0x000F424000000064; // 100 + (1000000 << 32)
+	const uint64_t mul2 = 0x0000271000000001; // 1 + (10000 << 32)
+	v -= 0x3030303030303030;
+	v = (v * 10) + (v >> 8);
+	v = (((v & mask) * mul1) + (((v >> 16) & mask) * mul2)) >> 32;
+	return (uint32_t) v;
+}
+
+#endif
+
+inline void AddDigit(Decimal *d, char c, bool fraction)
+{
+	if (d->digits < kMaxDigits) {
+		d->mantissa = d->mantissa * 10 + (c - '0');
+		d->digits++;
+		if (fraction)
+			d->exponent--;
+	} else {
+		d->truncated |= c != '0';
+		if (!fraction)
+			d->exponent++;
+	}
+}
+
+const char *ScanDigits(const char *p, const char *end, Decimal *d,
+			bool fraction)
+{
+	// leading zeros don't count against the mantissa width
+	if (d->mantissa == 0) {
+		while (p < end && *p == '0') {
+			if (fraction)
+				d->exponent--;
+			p++;
+		}
+	}
+#ifndef RIB_NUMBER_NO_SWAR
+	while (end - p >= 8 && d->digits + 8 <= kMaxDigits) {
+		uint64_t word = LoadEight(p);
+		if (!IsEightDigits(word))
+			break;
+		d->mantissa = d->mantissa * 100000000 + EightDigits(word);
+		d->digits += 8;
+		if (fraction)
+			d->exponent -= 8;
+		p += 8;
+	}
+#endif
+	while (p < end && IsDigit(*p))
+		AddDigit(d, *p++, fraction);
+	return p;
+}
+
+#ifdef _WIN32
+
+typedef _locale_t CLocale;
+
+CLocale NewCLocale()
+{
+	return _create_locale(LC_NUMERIC, "C");
+}
+
+float StrToFloat(const char *s, CLocale locale)
+{
+	return _strtof_l(s, nullptr, locale);
+}
+
+#else
+
+typedef locale_t CLocale;
+
+CLocale NewCLocale()
+{
+	return newlocale(LC_NUMERIC_MASK, "C", (locale_t) 0);
+}
+
+float StrToFloat(const char *s, CLocale locale)
+{
+	return strtof_l(s, nullptr, locale);
+}
+
+#endif
+
+// Correct for every input, only needed near a rounding boundary.
+float SlowFloat(const char *begin, const char *end)
+{
+	static const CLocale locale = NewCLocale();
+	char buf[128];
+	size_t size = end - begin;
+	if (size < sizeof(buf)) {
+		memcpy(buf, begin, size);
+		buf[size] = '\0';
+		return StrToFloat(buf, locale);
+	}
+	return StrToFloat(std::string(begin, end).c_str(), locale);
+}
+
+} // namespace
+
+const char *rib::ScanDecimal(const char *p, const char *end, Decimal *d)
+{
+	if (p < end && (*p == '-' || *p == '+'))
+		d->negative = *p++ == '-';
+	p = ScanDigits(p, end, d, false);
+	if (p < end && *p == '.') {
+		d->integral = false;
+		p = ScanDigits(p + 1, end, d, true);
+	}
+	if (p + 1 < end && (*p == 'e' || *p == 'E')) {
+		const char *q = p + 1;
+		bool negative = false;
+		if (*q == '-' || *q == '+')
+			negative = *q++ == '-';
+		if (q == end || !IsDigit(*q))
+			return p;
+
+		int exponent = 0;
+		for (; q < end && IsDigit(*q); q++) {
+			if (exponent < 100000)
+				exponent = exponent * 10 + (*q - '0');
+		}
+		d->integral = false;
+		d->exponent += negative ? -exponent : exponent;
+		p = q;
+	}
+	return p;
+}
+
+bool rib::DecimalToInt(const Decimal &d, int *value)
+{
+	// a non-zero exponent here means digits past the 19th
+	uint64_t limit = d.negative ? (uint64_t) INT_MAX + 1 : INT_MAX;
+	if (!d.integral || d.exponent != 0 || d.mantissa > limit)
+		return false;
+	*value = d.negative ? (int) (0 - d.mantissa) : (int) d.mantissa;
+	return true;
+}
+
+float rib::DecimalToFloat(const Decimal &d, const char *begin,
+			const char *end)
+{
+	float sign = d.negative ? -1.0f : 1.0f;
+	if (d.mantissa == 0)
+		return sign * 0.0f;
+	if (d.exponent + d.digits <= kMinExponent)
+		return sign * 0.0f;
+	if (d.exponent + d.digits - 1 > kMaxExponent)
+		return sign * std::numeric_limits<float>::infinity();
+
+	// exact operands, a single rounding
+	if (!d.truncated && d.mantissa <= (1 << 24) &&
+			d.exponent >= -10 && d.exponent <= 10) {
+		float v = (float) d.mantissa;
+		v = d.exponent < 0 ? v / kPow10f[-d.exponent]
+					: v * kPow10f[d.exponent];
+		return sign * v;
+	}
+
+	double v = (double) d.mantissa;
+	v = d.exponent < 0 ? v / kPow10[-d.exponent] : v * kPow10[d.exponent];
+	// the exact value is somewhere within the error of the estimate,
+	// if all of that interval rounds to the same float, that's the one
+	float low = (float) (v - v * kEstimateError);
+	float high = (float) (v + v * kEstimateError);
+	if (low == high)
+		return sign * low;
+	return SlowFloat(begin, end);
+}
+
+bool rib::ParseInt(const char *begin, const char *end, int *value)
+{
+	Decimal d;
+	return ScanDecimal(begin, end, &d) == end && DecimalToInt(d, value);
+}
+
+float rib::ParseFloat(const char *begin, const char *end)
+{
+	Decimal d;
+	ScanDecimal(begin, end, &d);
+	return DecimalToFloat(d, begin, end);
+}
@@ -0,0 +1,54 @@
+/* ************************************************************************
+ * Copyright 2017 Alexander Mishurov
+ * 
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ * 
+ * http://www.apache.org/licenses/LICENSE-2.0
+ * 
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ * ************************************************************************/
+
+#ifndef MAYAPLUGIN_RIBNUMBER_H_
+#define MAYAPLUGIN_RIBNUMBER_H_
+
+#include <cstdint>
+
+namespace rib {
+
+// Number conversion for the lexer. Everything works on a [begin, end)
+// range, so no terminating NUL is needed, never looks at the locale and
+// rounds floats correctly.
+
+// A decimal number split into its significant digits and a power of ten.
+// Only the first 19 digits are kept, truncated is set if there were more.
+struct Decimal {
+	uint64_t mantissa = 0;
+	int exponent = 0;
+	int digits = 0;
+	bool negative = false;
+	bool integral = true;
+	bool truncated = false;
+};
+
+// Reads the number at p, returns the position right after it.
+const char *ScanDecimal(const char *p, const char *end, Decimal *d);
+
+// False if the number has a fraction or an exponent or doesn't fit an int.
+bool DecimalToInt(const Decimal &d, int *value);
+
+// The text is only looked at in the rare cases when the digits kept
+// in d aren't enough to decide the rounding.
+float DecimalToFloat(const Decimal &d, const char *begin, const char *end);
+
+bool ParseInt(const char *begin, const char *end, int *value);
+float ParseFloat(const char *begin, const char *end);
+
+} /* namespace rib */
+
+#endif  // MAYAPLUGIN_RIBNUMBER_H_
@@ -0,0 +1,83 @@
+/* ************************************************************************
+ * Copyright 2017 Alexander Mishurov
+ * 
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ * 
+ * http://www.apache.org/licenses/LICENSE-2.0
+ * 
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ * ************************************************************************/
+
+#include "rib_parallel.h"
+
+using namespace rib;
+
+ThreadPool::ThreadPool(unsigned threads)
+: next_(0)
+{
+	threads = DefaultThreads(threads);
+	for (unsigned i = 1; i < threads; i++)
+		workers_.emplace_back(&ThreadPool::wait, this);
+}
+
+ThreadPool::~ThreadPool()
+{
+	{
+		std::lock_guard<std::mutex> lock(mutex_);
+		stop_ = true;
+	}
+	wake_.notify_all();
+	for (size_t i = 0; i < workers_.size(); i++)
+		workers_[i].join();
+}
+
+void ThreadPool::run(size_t count, const std::function<void(size_t)> &func)
+{
+	if (workers_.empty() || count <= 1) {
+		for (size_t i = 0; i < count; i++)
+			func(i);
+		return;
+	}
+	{
+		std::lock_guard<std::mutex> lock(mutex_);
+		func_ = &func;
+		count_ = count;
+		next_ = 0;
+		busy_ = (unsigned) workers_.size();
+		round_++;
+	}
+	wake_.notify_all();
+	work();
+	std::unique_lock<std::mutex> lock(mutex_);
+	done_.wait(lock, [this] { return busy_ == 0; });
+	func_ = nullptr;
+}
+
+void ThreadPool::wait()
+{
+	unsigned seen = 0;
+	std::unique_lock<std::mutex> lock(mutex_);
+	for (;;) {
+		wake_.wait(lock, [&] { return stop_ || round_ != seen; });
+		if (stop_)
+			return;
+		seen = round_;
+		lock.unlock();
+		work();
+		lock.lock();
+		if (--busy_ == 0)
+			done_.notify_one();
+	}
+}
+
+void ThreadPool::work()
+{
+	for (size_t i = next_++; i < count_; i = next_++)
+		(*func_)(i);
+}
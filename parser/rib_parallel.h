@@ -0,0 +1,101 @@
+/* ************************************************************************
+ * Copyright 2017 Alexander Mishurov
+ * 
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ * 
+ * http://www.apache.org/licenses/LICENSE-2.0
+ * 
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ * ************************************************************************/
+
+#ifndef MAYAPLUGIN_RIBPARALLEL_H_
+#define MAYAPLUGIN_RIBPARALLEL_H_
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace rib {
+
+// Hardware threads, 0 or an unknown count gives one.
+inline unsigned DefaultThreads(unsigned threads = 0)
+{
+	if (threads == 0)
+		threads = std::thread::hardware_concurrency();
+	return std::max(threads, 1u);
+}
+
+// Calls func(i) for every i in [0, count) on up to threads threads, the
+// calling one included. Indices are handed out in order to whichever
+// thread is free, so uneven items balance themselves.
+template<typename Func>
+void ParallelFor(size_t count, unsigned threads, Func func)
+{
+	threads = (unsigned) std::min<size_t>(DefaultThreads(threads), count);
+	if (threads <= 1) {
+		for (size_t i = 0; i < count; i++)
+			func(i);
+		return;
+	}
+
+	std::atomic<size_t> next(0);
+	auto work = [&]() {
+		for (size_t i = next++; i < count; i = next++)
+			func(i);
+	};
+	std::vector<std::thread> pool;
+	for (unsigned i = 1; i < threads; i++)
+		pool.emplace_back(work);
+	work();
+	for (size_t i = 0; i < pool.size(); i++)
+		pool[i].join();
+}
+
+// Threads started once that wait between loops, for the loops that
+// run often, such as one a frame, where starting threads each time
+// would cost more than the work.
+class ThreadPool {
+public:
+	// threads as DefaultThreads counts them, the calling one included
+	explicit ThreadPool(unsigned threads = 0);
+	~ThreadPool();
+	ThreadPool(const ThreadPool &) = delete;
+	ThreadPool &operator=(const ThreadPool &) = delete;
+
+	unsigned size() const { return (unsigned) workers_.size() + 1; }
+	// Like ParallelFor on the pool's threads and the calling one. One
+	// loop at a time, not to be called from more than one thread.
+	void run(size_t count, const std::function<void(size_t)> &func);
+private:
+	void wait();
+	// takes indices until there are none left
+	void work();
+
+	std::vector<std::thread> workers_;
+	std::mutex mutex_;
+	std::condition_variable wake_;
+	std::condition_variable done_;
+	// the loop being run
+	const std::function<void(size_t)> *func_ = nullptr;
+	size_t count_ = 0;
+	std::atomic<size_t> next_;
+	// counts the loops, workers still in the current one
+	unsigned round_ = 0;
+	unsigned busy_ = 0;
+	bool stop_ = false;
+};
+
+} /* namespace rib */
+
+#endif  // MAYAPLUGIN_RIBPARALLEL_H_
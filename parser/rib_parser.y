@@ -22,17 +22,21 @@
 %define parser_class_name { Parser }
 
 %code requires {
+    #include "parser/rib_arena.h"
+    #include "parser/rib_symbol.h"
+
     namespace rib {
         class Lexer;
-        class Driver;
+        class RibHandler;
     }
 }
 
 %parse-param { Lexer &lexer }
-%parse-param { Driver &driver }
+%parse-param { RibHandler &handler }
 
 %code {
-    #include "parser/rib_driver.h"
+    #include "parser/rib_handler.h"
+    #include "parser/rib_lexer.h"
 
     #undef yylex
     #define yylex lexer.yylex
@@ -45,9 +49,11 @@ https://www.gnu.org/software/bison/manual/html_node/_0025define-Summary.html
 
 %token END 0 "end of file"
 %token UNKNOWN
-%token <std::string> STRING
+%token <Symbol> STRING
 %token <int> INT
 %token <float> FLOAT
+%token <Array<int>*> INT_ARRAY
+%token <Array<float>*> FLOAT_ARRAY
 %token LEFT_SQUARE_BRACKET
 %token RIGHT_SQUARE_BRACKET
 
@@ -101,17 +107,29 @@ https://www.gnu.org/software/bison/manual/html_node/_0025define-Summary.html
 %token PATTERN
 %token BXDF
 %token LIGHT
+%token READ_ARCHIVE
+%token PROCEDURAL
+%token PROCEDURAL2
 
 %type <float> float
-%type <std::vector<float>*> float_list float_array
-%type <std::vector<int>*> int_list int_array
-%type <std::vector<std::string>*> string_list string_array
+%type <Array<float>*> float_list float_array
+%type <Array<int>*> int_list int_array
+%type <Array<Symbol>*> string_list string_array
 
 %locations
 
+%initial-action {
+    @$.begin.line = @$.end.line = lexer.firstLine();
+}
+
 %%
 
-rib : END | rib_item | rib rib_item;
+// what the lexer made for a request is gone once it is reduced
+rib
+    : END
+    | rib_item { lexer.freeScratch(); }
+    | rib rib_item { lexer.freeScratch(); }
+    ;
 
 rib_item
     : world_begin
@@ -158,177 +176,246 @@ rib_item
     | pattern
     | bxdf
     | light
+    | read_archive
+    | procedural
+    | procedural2
     ;
 
 hyperboloid
     : HYPERBOLOID float float float float float float float
-                { driver.addHyperboloid($2, $3, $4, $5, $6, $7, $8); }
+                { handler.onHyperboloid($2, $3, $4, $5, $6, $7, $8); }
     ;
 
 paraboloid
     : PARABOLOID float float float float
-                { driver.addParaboloid($2, $3, $4, $5); }
+                { handler.onParaboloid($2, $3, $4, $5); }
     ;
 
 torus
     : TORUS float float float float float
-                { driver.addTorus($2, $3, $4, $5, $6); }
+                { handler.onTorus($2, $3, $4, $5, $6); }
     ;
 
 cylinder
-    : CYLINDER float float float float { driver.addCylinder($2, $3, $4, $5); }
+    : CYLINDER float float float float { handler.onCylinder($2, $3, $4, $5); }
     ;
 
 sphere
-    : SPHERE float float float float { driver.addSphere($2, $3, $4, $5); }
+    : SPHERE float float float float { handler.onSphere($2, $3, $4, $5); }
     ;
 
-disk : DISK float float float { driver.addDisk($2, $3, $4); } ;
+disk : DISK float float float { handler.onDisk($2, $3, $4); } ;
 
-cone : CONE float float float { driver.addCone($2, $3, $4); } ;
+cone : CONE float float float { handler.onCone($2, $3, $4); } ;
 
 
 points_general_polygons
-    : points_general_polygons STRING string_array { delete $3; }
+    : points_general_polygons STRING string_array
+        {
+            handler.onPointsGeneralPolygonsParam(lexer.declaration($2),
+                                                 *$3);
+            lexer.drop($3);
+        }
     | points_general_polygons STRING float_array
         {
-            driver.addPGPparam($2, *$3);
-            delete $3;
+            handler.onPointsGeneralPolygonsParam(lexer.declaration($2),
+                                                 *$3);
+            lexer.drop($3);
         }
     | POINTS_GENERAL_POLYGONS int_array int_array int_array
         {
-            driver.addPGP(*$2, *$3, *$4);
-            delete $2;
-            delete $3;
-            delete $4;
+            handler.onPointsGeneralPolygons(*$2, *$3, *$4);
+            // the latest first, so the arena can take them all back
+            lexer.drop($4);
+            lexer.drop($3);
+            lexer.drop($2);
         }
     ;
 
 points_polygons
-    : points_polygons STRING float_array
+    : points_polygons STRING string_array
+        {
+            handler.onPointsPolygonsParam(lexer.declaration($2), *$3);
+            lexer.drop($3);
+        }
+    | points_polygons STRING float_array
         {
-            driver.addPPparam($2, *$3);
-            delete $3;
+            handler.onPointsPolygonsParam(lexer.declaration($2), *$3);
+            lexer.drop($3);
         }
     | POINTS_POLYGONS int_array int_array
         {
-            driver.addPP(*$2, *$3);
-            delete $2;
-            delete $3;
+            handler.onPointsPolygons(*$2, *$3);
+            lexer.drop($3);
+            lexer.drop($2);
         }
     ;
 
 pattern
     : pattern STRING float_array
         {
-            driver.addPatternFlParam($2, *$3);
-            delete $3;
+            handler.onPatternParam($2, *$3);
+            lexer.drop($3);
         }
     | pattern STRING string_array
         {
-            driver.addPatternStrParam($2, *$3);
-            delete $3;
+            handler.onPatternParam($2, *$3);
+            lexer.drop($3);
         }
     | PATTERN STRING STRING
         {
-            driver.addPattern($2, $3);
+            handler.onPattern($2, $3);
         }
     ;
 
 bxdf
     : bxdf STRING float_array
         {
-            driver.addBxdfFlParam($2, *$3);
-            delete $3;
+            handler.onBxdfParam($2, *$3);
+            lexer.drop($3);
         }
     | bxdf STRING string_array
         {
-            driver.addBxdfStrParam($2, *$3);
-            delete $3;
+            handler.onBxdfParam($2, *$3);
+            lexer.drop($3);
         }
     | BXDF STRING STRING
         {
-            driver.addBxdf($2, $3);
+            handler.onBxdf($2, $3);
         }
     ;
 
 light
     : light STRING float_array
         {
-            driver.addLightFlParam($2, *$3);
-            delete $3;
+            handler.onLightParam($2, *$3);
+            lexer.drop($3);
         }
     | light STRING string_array
         {
-            driver.addLightStrParam($2, *$3);
-            delete $3;
+            handler.onLightParam($2, *$3);
+            lexer.drop($3);
         }
     | LIGHT STRING STRING
         {
-            driver.addLight($2, $3);
+            handler.onLight($2, $3);
+        }
+    ;
+
+read_archive : READ_ARCHIVE STRING { handler.onReadArchive($2); } ;
+
+procedural
+    : PROCEDURAL STRING string_array float_array
+        {
+            handler.onProcedural($2, *$3, *$4);
+            lexer.drop($4);
+            lexer.drop($3);
+        }
+    ;
+
+procedural2
+    : procedural2 STRING float_array
+        {
+            handler.onProcedural2Param($2, *$3);
+            lexer.drop($3);
+        }
+    | procedural2 STRING string_array
+        {
+            handler.onProcedural2Param($2, *$3);
+            lexer.drop($3);
+        }
+    | PROCEDURAL2 STRING STRING
+        {
+            handler.onProcedural2($2, $3);
         }
     ;
 
 attribute
     : attribute STRING float_array
         {
-            driver.addAttrFlParam($2, *$3);
-            delete $3; 
+            handler.onAttributeParam($2, *$3);
+            lexer.drop($3);
+        }
+    | attribute STRING string_array
+        {
+            handler.onAttributeParam($2, *$3);
+            lexer.drop($3);
         }
-    | attribute STRING string_array { delete $3; }
     | attribute STRING STRING
     | ATTRIBUTE STRING
         {
-            driver.addAttribute($2);
+            handler.onAttribute($2);
         }
     ;
 
 
-world_begin : WORLD_BEGIN { driver.addNode(); } ;
-world_end : WORLD_END { driver.selectParent(); } ;
+world_begin : WORLD_BEGIN { handler.onWorldBegin(); } ;
+world_end : WORLD_END { handler.onWorldEnd(); } ;
 
-attribute_begin : ATTRIBUTE_BEGIN { driver.addNode(); } ;
-attribute_end : ATTRIBUTE_END { driver.selectParent(); } ;
+attribute_begin : ATTRIBUTE_BEGIN { handler.onAttributeBegin(); } ;
+attribute_end : ATTRIBUTE_END { handler.onAttributeEnd(); } ;
 
-transform_begin : TRANSFORM_BEGIN { driver.addNode(); } ;
-transform_end : TRANSFORM_END { driver.selectParent(); } ;
+transform_begin : TRANSFORM_BEGIN { handler.onTransformBegin(); } ;
+transform_end : TRANSFORM_END { handler.onTransformEnd(); } ;
 
 
 
 translate
-    : TRANSLATE float float float { driver.addTranslate($2, $3, $4); }
+    : TRANSLATE float float float { handler.onTranslate($2, $3, $4); }
     ;
 
 rotate
-    : ROTATE float float float float { driver.addRotate($2, $3, $4, $5); }
+    : ROTATE float float float float { handler.onRotate($2, $3, $4, $5); }
     ;
 
 scale
-    : SCALE float float float { driver.addScale($2, $3, $4); }
+    : SCALE float float float { handler.onScale($2, $3, $4); }
     ;
 
 contcat_transform: CONCAT_TRANSFORM float_array
     {
-        driver.addConcatTransform(*$2);
-        delete $2;
+        handler.onConcatTransform(*$2);
+        lexer.drop($2);
     } ;
 
 string_array
-    : LEFT_SQUARE_BRACKET string_list RIGHT_SQUARE_BRACKET { $$ = $2; }
+    : LEFT_SQUARE_BRACKET string_list RIGHT_SQUARE_BRACKET
+        {
+            $$ = $2;
+            $$->shrink(lexer.arena());
+        }
     ;
 
 string_list
-    : string_list STRING { $1->push_back($2); $$ = $1; }
-    | STRING { $$ = new std::vector<std::string>; $$->push_back($1); }
+    : string_list STRING { $1->push_back($2, lexer.arena()); $$ = $1; }
+    | STRING
+        {
+            $$ = lexer.newArray<Symbol>();
+            $$->push_back($1, lexer.arena());
+        }
     ;
 
 float_array
-    : LEFT_SQUARE_BRACKET float_list RIGHT_SQUARE_BRACKET { $$ = $2; }
+    : LEFT_SQUARE_BRACKET float_list RIGHT_SQUARE_BRACKET
+        {
+            $$ = $2;
+            $$->shrink(lexer.arena());
+        }
+    | FLOAT_ARRAY { $$ = $1; }
+    | INT_ARRAY
+        {
+            $$ = lexer.newArray<float>();
+            *$$ = $1->convert<float>();
+        }
     ;
 
 float_list
-    : float_list float { $1->push_back($2); $$ = $1; }
-    | float { $$ = new std::vector<float>; $$->push_back($1); }
+    : float_list float { $1->push_back($2, lexer.arena()); $$ = $1; }
+    | float
+        {
+            $$ = lexer.newArray<float>();
+            $$->push_back($1, lexer.arena());
+        }
     ;
 
 float
@@ -337,59 +424,68 @@ float
     ;
 
 int_array
-    : LEFT_SQUARE_BRACKET int_list RIGHT_SQUARE_BRACKET { $$ = $2; }
+    : LEFT_SQUARE_BRACKET int_list RIGHT_SQUARE_BRACKET
+        {
+            $$ = $2;
+            $$->shrink(lexer.arena());
+        }
+    | INT_ARRAY { $$ = $1; }
     ;
 
 int_list
-    : int_list INT { $1->push_back($2); $$ = $1; }
-    | INT { $$ = new std::vector<int>; $$->push_back($1); }
+    : int_list INT { $1->push_back($2, lexer.arena()); $$ = $1; }
+    | INT
+        {
+            $$ = lexer.newArray<int>();
+            $$->push_back($1, lexer.arena());
+        }
     ;
 
 
 sides : SIDES INT;
 orientation : ORIENTATION STRING;
-opacity : OPACITY float_array { delete $2; };
-color : COLOR float_array { delete $2; };
+opacity : OPACITY float_array { lexer.drop($2); };
+color : COLOR float_array { lexer.drop($2); };
 surface
-    : surface STRING float_array { delete $3; }
+    : surface STRING float_array { lexer.drop($3); }
     | surface STRING float
     | SURFACE STRING
     ;
 geometry : GEOMETRY STRING;
 
 light_source
-    : light_source STRING float_array { delete $3; }
+    : light_source STRING float_array { lexer.drop($3); }
     | light_source STRING float
     | LIGHT_SOURCE
     ;
 
 option
-    : option STRING float_array { delete $3; }
+    : option STRING float_array { lexer.drop($3); }
     | option STRING float
     | option INT
     | OPTION STRING
     ;
 
 integrator
-    : integrator STRING int_array { delete $3; }
+    : integrator STRING int_array { lexer.drop($3); }
     | INTEGRATOR STRING STRING
     ;
 
 hider
-    : hider STRING int_array { delete $3; }
-    | hider STRING string_array { delete $3; }
+    : hider STRING int_array { lexer.drop($3); }
+    | hider STRING string_array { lexer.drop($3); }
     | HIDER STRING
     ;
 
 projection
-    : projection STRING float_array { delete $3; }
+    : projection STRING float_array { lexer.drop($3); }
     | projection STRING INT
     | PROJECTION STRING
     ;
 
 area_light_source
-    : area_light_source STRING float_array { delete $3; }
-    | area_light_source STRING string_array { delete $3; }
+    : area_light_source STRING float_array { lexer.drop($3); }
+    | area_light_source STRING string_array { lexer.drop($3); }
     | AREA_LIGHT_SOURCE STRING STRING
     ;
 
@@ -408,7 +504,6 @@ scoped_coordinate_system : SCOPED_COORDINATE_SYSTEM STRING ;
 void rib::Parser::error(const rib::Parser::location_type &l,
                         const std::string &err_message)
 {
-    driver.clean(&driver.root);
-    std::cerr << "Error: " << err_message << " at " << l << "\n";
+    handler.onError(l, err_message);
 }
 
@@ -0,0 +1,282 @@
+/* ************************************************************************
+ * Copyright 2017 Alexander Mishurov
+ * 
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ * 
+ * http://www.apache.org/licenses/LICENSE-2.0
+ * 
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ * ************************************************************************/
+
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include "rib_primvar.h"
+
+using namespace rib;
+
+namespace {
+
+struct Word {
+	const char *str;
+	uint8_t value;
+};
+
+const Word kClasses[] = {
+	{ "constant", kConstant },
+	{ "uniform", kUniform },
+	{ "varying", kVarying },
+	{ "vertex", kVertex },
+	{ "facevarying", kFaceVarying },
+	{ "facevertex", kFaceVertex }
+};
+
+const Word kTypes[] = {
+	{ "float", kFloat },
+	{ "int", kInteger },
+	{ "integer", kInteger },
+	{ "string", kString },
+	{ "point", kPoint },
+	{ "vector", kVector },
+	{ "normal", kNormal },
+	{ "color", kColor },
+	{ "hpoint", kHPoint },
+	{ "matrix", kMatrix }
+};
+
+// numbers in a value of each type
+const unsigned kTypeWidth[] = { 1, 1, 1, 3, 3, 3, 3, 4, 16 };
+
+// what RenderMan declares them as
+struct Standard {
+	const char *name;
+	PrimvarClass storage;
+	PrimvarType type;
+	uint32_t arity;
+};
+
+const Standard kStandard[] = {
+	{ "P", kVertex, kPoint, 1 },
+	{ "Pw", kVertex, kHPoint, 1 },
+	{ "Pz", kVertex, kFloat, 1 },
+	{ "N", kVarying, kNormal, 1 },
+	{ "Cs", kVarying, kColor, 1 },
+	{ "Os", kVarying, kColor, 1 },
+	{ "st", kVarying, kFloat, 2 },
+	{ "s", kVarying, kFloat, 1 },
+	{ "t", kVarying, kFloat, 1 },
+	{ "width", kVarying, kFloat, 1 },
+	{ "constantwidth", kConstant, kFloat, 1 }
+};
+
+template<size_t N>
+bool Lookup(const Word (&words)[N], const char *str, size_t size,
+							uint8_t *value)
+{
+	for (size_t i = 0; i < N; i++) {
+		if (strlen(words[i].str) == size &&
+		    memcmp(words[i].str, str, size) == 0) {
+			*value = words[i].value;
+			return true;
+		}
+	}
+	return false;
+}
+
+bool IsSpace(char c)
+{
+	return c == ' ' || c == '\t' || c == '\n' || c == '\r';
+}
+
+// "type", "type[n]" or "type [n]", advances past it
+bool ParseType(const char **pos, const char *end, Declaration *declaration)
+{
+	const char *begin = *pos;
+	const char *p = begin;
+	while (p != end && !IsSpace(*p) && *p != '[')
+		p++;
+	uint8_t type;
+	if (!Lookup(kTypes, begin, p - begin, &type))
+		return false;
+	declaration->type = (PrimvarType) type;
+
+	const char *q = p;
+	while (q != end && IsSpace(*q))
+		q++;
+	if (q == end || *q != '[') {
+		*pos = p;
+		return true;
+	}
+	char *number_end;
+	long arity = strtol(q + 1, &number_end, 10);
+	if (number_end == q + 1 || number_end >= end || *number_end != ']' ||
+	    arity < 1)
+		return false;
+	declaration->arity = (uint32_t) arity;
+	*pos = number_end + 1;
+	return true;
+}
+
+// false if the words before the name aren't a class and a type,
+// either of which may be left out
+bool Split(const std::string &key, Declaration *declaration,
+			const char **name, size_t *name_size,
+			bool *classed, bool *typed)
+{
+	const char *begin = key.data();
+	const char *end = begin + key.size();
+	while (end != begin && IsSpace(end[-1]))
+		end--;
+	const char *last = end;
+	while (last != begin && !IsSpace(last[-1]))
+		last--;
+	*name = last;
+	*name_size = end - last;
+	*classed = false;
+	*typed = false;
+
+	const char *pos = begin;
+	while (pos != last && IsSpace(*pos))
+		pos++;
+	if (pos == last)
+		return true;
+	const char *word = pos;
+	while (pos != last && !IsSpace(*pos))
+		pos++;
+	uint8_t storage;
+	if (Lookup(kClasses, word, pos - word, &storage)) {
+		declaration->storage = (PrimvarClass) storage;
+		*classed = true;
+		while (pos != last && IsSpace(*pos))
+			pos++;
+	} else {
+		pos = word;
+	}
+	if (pos != last) {
+		if (!ParseType(&pos, last, declaration))
+			return false;
+		*typed = true;
+	}
+	while (pos != last && IsSpace(*pos))
+		pos++;
+	return pos == last;
+}
+
+template<typename Symbols>
+Declaration Parse(Symbol key, Symbols *symbols)
+{
+	Declaration declaration;
+	declaration.key = key;
+	const char *name;
+	size_t name_size;
+	bool classed;
+	bool typed;
+	if (!Split(key.str(), &declaration, &name, &name_size,
+						&classed, &typed)) {
+		Declaration plain;
+		plain.key = plain.name = key;
+		return plain;
+	}
+	declaration.name = name_size == key.size() ? key
+				: symbols->intern(name, name_size);
+	const size_t count = sizeof(kStandard) / sizeof(kStandard[0]);
+	for (size_t i = 0; i < count; i++) {
+		const Standard &standard = kStandard[i];
+		if (strlen(standard.name) != name_size ||
+		    memcmp(standard.name, name, name_size) != 0)
+			continue;
+		if (!classed)
+			declaration.storage = standard.storage;
+		if (!typed) {
+			declaration.type = standard.type;
+			declaration.arity = standard.arity;
+		}
+		break;
+	}
+	return declaration;
+}
+
+} // namespace
+
+size_t Declaration::width() const
+{
+	return kTypeWidth[type] * arity;
+}
+
+Declaration Declaration::holding(bool strings) const
+{
+	Declaration declaration = *this;
+	if (strings != (type == kString)) {
+		declaration.type = strings ? kString : kFloat;
+		declaration.arity = 1;
+	}
+	return declaration;
+}
+
+Declaration rib::ParseDeclaration(Symbol key, SymbolCache *symbols)
+{
+	return Parse(key, symbols);
+}
+
+Declaration rib::ParseDeclaration(Symbol key, SymbolTable *symbols)
+{
+	return Parse(key, symbols);
+}
+
+size_t Primvar::size() const
+{
+	if (declaration.type == kString)
+		return strings.size() / declaration.arity;
+	return numbers.size() / declaration.width();
+}
+
+const Primvar *PrimvarTable::find(Symbol name) const
+{
+	if (name.id() >= 1 && name.id() <= kWellKnownSymbols)
+		return standard(name);
+	for (size_t i = 0; i < items_.size(); i++) {
+		if (items_[i].declaration.name == name)
+			return &items_[i];
+	}
+	return nullptr;
+}
+
+Primvar *PrimvarTable::insert(const Declaration &declaration,
+					bool strings, Arena *arena)
+{
+	if (find(declaration.name) != nullptr)
+		return nullptr;
+	Primvar primvar;
+	primvar.declaration = declaration.holding(strings);
+	items_.push_back(std::move(primvar), arena);
+	unsigned id = declaration.name.id();
+	if (id >= 1 && id <= kWellKnownSymbols)
+		slots_[id - 1] = (uint32_t) items_.size();
+	return &items_.back();
+}
+
+bool PrimvarTable::add(const Declaration &declaration,
+				Array<float> &numbers, Arena *arena)
+{
+	Primvar *primvar = insert(declaration, false, arena);
+	if (primvar == nullptr)
+		return false;
+	primvar->numbers = std::move(numbers);
+	return true;
+}
+
+bool PrimvarTable::add(const Declaration &declaration,
+				Array<Symbol> &strings, Arena *arena)
+{
+	Primvar *primvar = insert(declaration, true, arena);
+	if (primvar == nullptr)
+		return false;
+	primvar->strings = std::move(strings);
+	return true;
+}
@@ -0,0 +1,129 @@
+/* ************************************************************************
+ * Copyright 2017 Alexander Mishurov
+ * 
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ * 
+ * http://www.apache.org/licenses/LICENSE-2.0
+ * 
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ * ************************************************************************/
+
+#ifndef MAYAPLUGIN_RIBPRIMVAR_H_
+#define MAYAPLUGIN_RIBPRIMVAR_H_
+
+#include <cstddef>
+#include <cstdint>
+#include "parser/rib_arena.h"
+#include "parser/rib_symbol.h"
+
+namespace rib {
+
+// How many values a primitive variable has, one per primitive, face,
+// vertex and so on.
+enum PrimvarClass : uint8_t {
+	kConstant,
+	kUniform,
+	kVarying,
+	kVertex,
+	kFaceVarying,
+	kFaceVertex
+};
+
+enum PrimvarType : uint8_t {
+	kFloat,
+	kInteger,
+	kString,
+	kPoint,
+	kVector,
+	kNormal,
+	kColor,
+	kHPoint,
+	kMatrix
+};
+
+// A parameter name as the file spells it, "facevarying normal N",
+// "float[2] st" or just "P", taken apart. What isn't spelled out is
+// what RenderMan declares for the standard names, uniform float for
+// the rest.
+struct Declaration {
+	// as it was written
+	Symbol key;
+	Symbol name;
+	PrimvarClass storage = kUniform;
+	PrimvarType type = kFloat;
+	// the n of type[n]
+	uint32_t arity = 1;
+
+	// numbers in one value, 3 for a point, 6 for a float[6]
+	size_t width() const;
+	// The values have the last word on whether they are strings, a
+	// float if they are numbers declared as strings.
+	Declaration holding(bool strings) const;
+};
+
+// Takes the key apart, the name is interned in symbols. A key that is
+// no declaration is all name.
+Declaration ParseDeclaration(Symbol key, SymbolCache *symbols);
+Declaration ParseDeclaration(Symbol key, SymbolTable *symbols);
+
+// A primitive variable, its values are in one of the arrays, strings
+// for the string type and numbers for all the others.
+struct Primvar {
+	Declaration declaration;
+	Array<float> numbers;
+	Array<Symbol> strings;
+
+	Symbol name() const { return declaration.name; }
+	// values, not numbers
+	size_t size() const;
+};
+
+// The primitive variables of a mesh by name, in the order they were
+// given. The standard names are found without a search. Kept in an
+// arena like the node it belongs to.
+class PrimvarTable {
+public:
+	typedef Array<Primvar>::const_iterator const_iterator;
+
+	const_iterator begin() const { return items_.begin(); }
+	const_iterator end() const { return items_.end(); }
+	size_t size() const { return items_.size(); }
+	bool empty() const { return items_.empty(); }
+
+	// null if it isn't there
+	const Primvar *find(Symbol name) const;
+	const Primvar *P() const { return standard(kSymbolP); }
+	const Primvar *N() const { return standard(kSymbolN); }
+	const Primvar *Cs() const { return standard(kSymbolCs); }
+	const Primvar *st() const { return standard(kSymbolSt); }
+
+	// Like a map, a name that is already there keeps its values, the
+	// given ones are left where they were then. False if so.
+	bool add(const Declaration &declaration, Array<float> &numbers,
+						Arena *arena);
+	bool add(const Declaration &declaration, Array<Symbol> &strings,
+						Arena *arena);
+private:
+	const Primvar *standard(Symbol name) const
+	{
+		uint32_t slot = slots_[name.id() - 1];
+		return slot != 0 ? &items_[slot - 1] : nullptr;
+	}
+	Primvar *insert(const Declaration &declaration, bool strings,
+							Arena *arena);
+
+	Array<Primvar> items_;
+	// 1 + the index of each name that is always in a symbol table,
+	// by its id, 0 if it isn't there
+	uint32_t slots_[kWellKnownSymbols] = {};
+};
+
+} /* namespace rib */
+
+#endif  // MAYAPLUGIN_RIBPRIMVAR_H_
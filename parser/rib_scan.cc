@@ -0,0 +1,63 @@
+/* ************************************************************************
+ * Copyright 2017 Alexander Mishurov
+ * 
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ * 
+ * http://www.apache.org/licenses/LICENSE-2.0
+ * 
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ * ************************************************************************/
+
+#include "rib_scan.h"
+#include "rib_number.h"
+
+using namespace rib;
+
+namespace {
+
+inline bool IsSpace(char c)
+{
+	return c == ' ' || c == '\t' || c == '\r' || c == '\n';
+}
+
+} // namespace
+
+bool rib::ScanNumberArray(const char *begin, const char *end, Arena *arena,
+			Array<int> *ints, Array<float> *floats)
+{
+	const char *p = begin + 1;
+	end--;
+	bool integral = true;
+	for (;;) {
+		while (p < end && IsSpace(*p))
+			p++;
+		if (p >= end)
+			break;
+
+		Decimal d;
+		const char *number = p;
+		p = ScanDecimal(p, end, &d);
+
+		int value;
+		if (integral && DecimalToInt(d, &value)) {
+			ints->push_back(value, arena);
+			continue;
+		}
+		if (integral) {
+			*floats = ints->convert<float>();
+			integral = false;
+		}
+		floats->push_back(DecimalToFloat(d, number, p), arena);
+	}
+	if (integral)
+		ints->shrink(arena);
+	else
+		floats->shrink(arena);
+	return integral;
+}
@@ -0,0 +1,35 @@
+/* ************************************************************************
+ * Copyright 2017 Alexander Mishurov
+ * 
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ * 
+ * http://www.apache.org/licenses/LICENSE-2.0
+ * 
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ * ************************************************************************/
+
+#ifndef MAYAPLUGIN_RIBSCAN_H_
+#define MAYAPLUGIN_RIBSCAN_H_
+
+#include <cstddef>
+#include "parser/rib_arena.h"
+
+namespace rib {
+
+// Decodes the text of a bracketed array of numbers the lexer has matched
+// as a single token, brackets included. Numbers go to ints while they
+// all are integers, the first real number turns everything into floats
+// where it is. The elements are in the arena, no larger than needed.
+// Returns true if the array turned out to be integer.
+bool ScanNumberArray(const char *begin, const char *end, Arena *arena,
+			Array<int> *ints, Array<float> *floats);
+
+} /* namespace rib */
+
+#endif  // MAYAPLUGIN_RIBSCAN_H_
@@ -0,0 +1,150 @@
+/* ************************************************************************
+ * Copyright 2017 Alexander Mishurov
+ * 
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ * 
+ * http://www.apache.org/licenses/LICENSE-2.0
+ * 
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ * ************************************************************************/
+
+#include <cstring>
+#include "rib_split.h"
+
+using namespace rib;
+
+namespace {
+
+enum Block {
+	kNone,
+	kBegin,
+	kEnd,
+	kWorldBegin
+};
+
+inline bool IsWordChar(char c)
+{
+	return (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') ||
+		(c >= '0' && c <= '9') || c == '_';
+}
+
+inline bool Is(const char *word, size_t size, const char *keyword)
+{
+	return size == strlen(keyword) && memcmp(word, keyword, size) == 0;
+}
+
+// The parser doesn't care which kind of block an end closes,
+// neither does this.
+Block Classify(const char *word, size_t size)
+{
+	if (size < 8 || (word[0] != 'A' && word[0] != 'T' && word[0] != 'W'))
+		return kNone;
+	if (Is(word, size, "WorldBegin"))
+		return kWorldBegin;
+	if (Is(word, size, "AttributeBegin") ||
+	    Is(word, size, "TransformBegin"))
+		return kBegin;
+	if (Is(word, size, "AttributeEnd") ||
+	    Is(word, size, "TransformEnd") ||
+	    Is(word, size, "WorldEnd"))
+		return kEnd;
+	return kNone;
+}
+
+} // namespace
+
+bool rib::SplitBlocks(const char *data, size_t size, size_t min_size,
+			std::vector<Chunk> *chunks)
+{
+	std::vector<Chunk> pieces;
+	Chunk piece = { 0, 0, 1, false, 0 };
+	int depth = 0;
+	bool in_world = false;
+	int line = 1;
+
+	const char *p = data;
+	const char *end = data + size;
+	while (p < end) {
+		char c = *p;
+		if (c == '\n') {
+			line++;
+			p++;
+		} else if (c == '#') {
+			while (p < end && *p != '\n')
+				p++;
+		} else if (c == '"') {
+			// the lexer doesn't count lines in strings either
+			for (p++; p < end && *p != '"'; p++) {
+				if (*p == '\\')
+					p++;
+			}
+			p++;
+		} else if ((unsigned char) c >= 0x80) {
+			return false;
+		} else if (IsWordChar(c)) {
+			const char *word = p;
+			while (p < end && IsWordChar(*p))
+				p++;
+			Block block = Classify(word, p - word);
+			if (block == kNone)
+				continue;
+
+			bool cut = block != kEnd &&
+					(depth == 0 || (depth == 1 && in_world));
+			if (cut && (size_t) (word - data) > piece.begin) {
+				piece.end = word - data;
+				pieces.push_back(piece);
+				piece.begin = piece.end;
+				piece.first_line = line;
+				piece.nested = depth > 0;
+				piece.depth = 0;
+			}
+			if (block == kWorldBegin && depth == 0) {
+				in_world = true;
+				piece.depth++;
+			}
+			if (block != kEnd) {
+				depth++;
+			} else if (depth > 0) {
+				depth--;
+				// whatever closes the world closes it
+				if (depth == 0 && in_world) {
+					in_world = false;
+					piece.depth--;
+					piece.end = p - data;
+					pieces.push_back(piece);
+					piece.begin = piece.end;
+					piece.first_line = line;
+					piece.nested = false;
+					piece.depth = 0;
+				}
+			}
+		} else {
+			p++;
+		}
+	}
+	if (size > piece.begin || pieces.empty()) {
+		piece.end = size;
+		pieces.push_back(piece);
+	}
+
+	chunks->clear();
+	for (size_t i = 0; i < pieces.size(); i++) {
+		// a chunk can't go on past the world's end,
+		// what follows belongs one level up
+		if (chunks->empty() || chunks->back().depth < 0 ||
+		    chunks->back().end - chunks->back().begin >= min_size) {
+			chunks->push_back(pieces[i]);
+		} else {
+			chunks->back().end = pieces[i].end;
+			chunks->back().depth += pieces[i].depth;
+		}
+	}
+	return true;
+}
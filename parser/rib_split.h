@@ -0,0 +1,48 @@
+/* ************************************************************************
+ * Copyright 2017 Alexander Mishurov
+ * 
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ * 
+ * http://www.apache.org/licenses/LICENSE-2.0
+ * 
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ * ************************************************************************/
+
+#ifndef MAYAPLUGIN_RIBSPLIT_H_
+#define MAYAPLUGIN_RIBSPLIT_H_
+
+#include <cstddef>
+#include <vector>
+
+namespace rib {
+
+// A range of an ASCII RIB that parses on its own.
+struct Chunk {
+	size_t begin;
+	size_t end;
+	int first_line;
+	// starts inside the WorldBegin block
+	bool nested;
+	// +1 if the range opens the world block and leaves it open,
+	// -1 if it closes it
+	int depth;
+};
+
+// Cuts the text before every top level AttributeBegin, TransformBegin
+// and WorldBegin, before every block directly inside the world block
+// and right after the world ends. Neighbouring pieces are merged into
+// chunks of at least min_size bytes. Comments and strings are skipped.
+// Returns false for input that has binary tokens, which can't be cut
+// without decoding everything before the cut.
+bool SplitBlocks(const char *data, size_t size, size_t min_size,
+			std::vector<Chunk> *chunks);
+
+} /* namespace rib */
+
+#endif  // MAYAPLUGIN_RIBSPLIT_H_
@@ -0,0 +1,152 @@
+/* ************************************************************************
+ * Copyright 2017 Alexander Mishurov
+ * 
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ * 
+ * http://www.apache.org/licenses/LICENSE-2.0
+ * 
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ * ************************************************************************/
+
+#include <cstdint>
+#include <cstring>
+#include "rib_symbol.h"
+
+using namespace rib;
+
+namespace {
+
+// FNV-1a, the strings are short
+size_t Fnv1a(const char *str, size_t size)
+{
+	uint64_t hash = 14695981039346656037ULL;
+	for (size_t i = 0; i < size; i++) {
+		hash ^= (unsigned char) str[i];
+		hash *= 1099511628211ULL;
+	}
+	return (size_t) hash;
+}
+
+const std::string kEmpty;
+
+Symbol::Entry kWellKnown[] = {
+	{ "P", 1, Fnv1a("P", 1) },
+	{ "N", 2, Fnv1a("N", 1) },
+	{ "Cs", 3, Fnv1a("Cs", 2) },
+	{ "st", 4, Fnv1a("st", 2) },
+	{ "s", 5, Fnv1a("s", 1) },
+	{ "t", 6, Fnv1a("t", 1) }
+};
+
+const size_t kWellKnownCount = sizeof(kWellKnown) / sizeof(kWellKnown[0]);
+
+} // namespace
+
+const Symbol rib::kSymbolP(&kWellKnown[0]);
+const Symbol rib::kSymbolN(&kWellKnown[1]);
+const Symbol rib::kSymbolCs(&kWellKnown[2]);
+const Symbol rib::kSymbolSt(&kWellKnown[3]);
+const Symbol rib::kSymbolS(&kWellKnown[4]);
+const Symbol rib::kSymbolT(&kWellKnown[5]);
+
+size_t SymbolTable::hash(const char *str, size_t size)
+{
+	return Fnv1a(str, size);
+}
+
+const std::string &Symbol::str() const
+{
+	return entry_ != nullptr ? entry_->str : kEmpty;
+}
+
+SymbolTable::SymbolTable()
+: slots_(64, nullptr)
+{
+	for (size_t i = 0; i < kWellKnownCount; i++)
+		insert(&kWellKnown[i]);
+}
+
+size_t SymbolTable::slot(const char *str, size_t size, size_t hash) const
+{
+	size_t mask = slots_.size() - 1;
+	size_t i = hash & mask;
+	for (;;) {
+		const Symbol::Entry *entry = slots_[i];
+		if (entry == nullptr)
+			return i;
+		if (entry->hash == hash && entry->str.size() == size &&
+				memcmp(entry->str.data(), str, size) == 0)
+			return i;
+		i = (i + 1) & mask;
+	}
+}
+
+void SymbolTable::insert(const Symbol::Entry *entry)
+{
+	if ((count_ + 1) * 2 > slots_.size()) {
+		std::vector<const Symbol::Entry *> old(slots_.size() * 2, nullptr);
+		old.swap(slots_);
+		for (size_t i = 0; i < old.size(); i++) {
+			if (old[i] != nullptr) {
+				slots_[slot(old[i]->str.data(), old[i]->str.size(),
+						old[i]->hash)] = old[i];
+			}
+		}
+	}
+	slots_[slot(entry->str.data(), entry->str.size(), entry->hash)] =
+									entry;
+	count_++;
+}
+
+Symbol SymbolTable::intern(const char *str, size_t size, size_t hash)
+{
+	if (size == 0)
+		return Symbol();
+	std::lock_guard<std::mutex> lock(mutex_);
+	const Symbol::Entry *entry = slots_[slot(str, size, hash)];
+	if (entry != nullptr)
+		return Symbol(entry);
+
+	Symbol::Entry fresh = {
+		std::string(str, size),
+		(unsigned) (kWellKnownCount + entries_.size() + 1),
+		hash
+	};
+	entries_.push_back(std::move(fresh));
+	insert(&entries_.back());
+	return Symbol(&entries_.back());
+}
+
+Symbol SymbolTable::find(const char *str, size_t size) const
+{
+	if (size == 0)
+		return Symbol();
+	size_t hash = Fnv1a(str, size);
+	std::lock_guard<std::mutex> lock(mutex_);
+	return Symbol(slots_[slot(str, size, hash)]);
+}
+
+size_t SymbolTable::size() const
+{
+	std::lock_guard<std::mutex> lock(mutex_);
+	return count_;
+}
+
+Symbol SymbolCache::intern(const char *str, size_t size)
+{
+	if (size == 0)
+		return Symbol();
+	size_t hash = SymbolTable::hash(str, size);
+	Symbol &cached = slots_[hash & 0xFF];
+	if (cached.size() == size &&
+			memcmp(cached.str().data(), str, size) == 0)
+		return cached;
+	cached = table_->intern(str, size, hash);
+	return cached;
+}
@@ -0,0 +1,166 @@
+/* ************************************************************************
+ * Copyright 2017 Alexander Mishurov
+ * 
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ * 
+ * http://www.apache.org/licenses/LICENSE-2.0
+ * 
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ * ************************************************************************/
+
+#ifndef MAYAPLUGIN_RIBSYMBOL_H_
+#define MAYAPLUGIN_RIBSYMBOL_H_
+
+#include <cstddef>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <utility>
+#include <vector>
+#include "parser/rib_arena.h"
+
+namespace rib {
+
+// A handle to a string interned in a SymbolTable. Two symbols from the
+// same table are equal if and only if their strings are, so comparing
+// them is comparing pointers. The default symbol is the empty string.
+class Symbol {
+public:
+	struct Entry {
+		std::string str;
+		unsigned id;
+		size_t hash;
+	};
+
+	constexpr Symbol() : entry_(nullptr) {}
+	constexpr explicit Symbol(const Entry *entry) : entry_(entry) {}
+
+	const std::string &str() const;
+	const char *c_str() const { return str().c_str(); }
+	size_t size() const { return str().size(); }
+	bool empty() const { return entry_ == nullptr; }
+	// in the order the strings were first interned
+	unsigned id() const { return entry_ != nullptr ? entry_->id : 0; }
+
+	bool operator==(Symbol other) const { return entry_ == other.entry_; }
+	bool operator!=(Symbol other) const { return entry_ != other.entry_; }
+	bool operator<(Symbol other) const { return id() < other.id(); }
+private:
+	const Entry *entry_;
+};
+
+// Names the code looks up. They are in every table from the start,
+// so they compare equal to what the lexer interns without a table at
+// hand.
+extern const Symbol kSymbolP;
+extern const Symbol kSymbolN;
+extern const Symbol kSymbolCs;
+extern const Symbol kSymbolSt;
+extern const Symbol kSymbolS;
+extern const Symbol kSymbolT;
+// their ids, which are 1 up to this
+const unsigned kWellKnownSymbols = 6;
+
+// Owns the strings, symbols stay valid as long as the table does.
+// Safe to share between threads.
+class SymbolTable {
+public:
+	SymbolTable();
+	SymbolTable(const SymbolTable &) = delete;
+	SymbolTable &operator=(const SymbolTable &) = delete;
+
+	static size_t hash(const char *str, size_t size);
+
+	Symbol intern(const char *str, size_t size)
+		{ return intern(str, size, hash(str, size)); }
+	Symbol intern(const char *str, size_t size, size_t hash);
+	Symbol intern(const std::string &str)
+		{ return intern(str.data(), str.size()); }
+	// The empty symbol if the string has never been interned.
+	Symbol find(const char *str, size_t size) const;
+	Symbol find(const std::string &str) const
+		{ return find(str.data(), str.size()); }
+
+	size_t size() const;
+private:
+	size_t slot(const char *str, size_t size, size_t hash) const;
+	void insert(const Symbol::Entry *entry);
+
+	mutable std::mutex mutex_;
+	std::deque<Symbol::Entry> entries_;
+	// open addressing, a power of two in size and never more than
+	// half full
+	std::vector<const Symbol::Entry *> slots_;
+	size_t count_ = 0;
+};
+
+// Remembers the symbols a lexer has seen lately, so the shared table
+// is only locked for strings that aren't among them.
+class SymbolCache {
+public:
+	SymbolCache(SymbolTable *table) : table_(table) {}
+
+	Symbol intern(const char *str, size_t size);
+	Symbol intern(const std::string &str)
+		{ return intern(str.data(), str.size()); }
+private:
+	SymbolTable *table_;
+	Symbol slots_[256];
+};
+
+// Parameters keyed by symbols. A node has a handful of them, so a scan
+// comparing handles is as fast as a tree, and iterating in the order
+// they were added keeps the file order whatever the symbols' ids.
+// Kept in an arena like the node they belong to.
+template<typename T>
+class SymbolMap {
+public:
+	typedef std::pair<Symbol, T> value_type;
+	typedef typename Array<value_type>::iterator iterator;
+	typedef typename Array<value_type>::const_iterator const_iterator;
+
+	iterator begin() { return items_.begin(); }
+	iterator end() { return items_.end(); }
+	const_iterator begin() const { return items_.begin(); }
+	const_iterator end() const { return items_.end(); }
+	size_t size() const { return items_.size(); }
+	bool empty() const { return items_.empty(); }
+
+	iterator find(Symbol key)
+	{
+		iterator it = items_.begin();
+		while (it != items_.end() && it->first != key)
+			++it;
+		return it;
+	}
+	const_iterator find(Symbol key) const
+	{
+		const_iterator it = items_.begin();
+		while (it != items_.end() && it->first != key)
+			++it;
+		return it;
+	}
+	size_t count(Symbol key) const { return find(key) != end(); }
+
+	// like std::map, a key that is already there keeps its value
+	std::pair<iterator, bool> insert(value_type value, Arena *arena)
+	{
+		iterator it = find(value.first);
+		if (it != items_.end())
+			return std::make_pair(it, false);
+		items_.push_back(std::move(value), arena);
+		return std::make_pair(items_.end() - 1, true);
+	}
+private:
+	Array<value_type> items_;
+};
+
+} /* namespace rib */
+
+#endif  // MAYAPLUGIN_RIBSYMBOL_H_
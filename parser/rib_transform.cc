@@ -0,0 +1,108 @@
+/* ************************************************************************
+ * Copyright 2017 Alexander Mishurov
+ * 
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ * 
+ * http://www.apache.org/licenses/LICENSE-2.0
+ * 
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ * ************************************************************************/
+
+#include <cmath>
+#include <cstring>
+#include "rib_transform.h"
+
+using namespace rib;
+
+Matrix Matrix::Identity()
+{
+	return Scale(1.0f, 1.0f, 1.0f);
+}
+
+Matrix Matrix::Translate(float x, float y, float z)
+{
+	Matrix matrix = Identity();
+	matrix.m[3][0] = x;
+	matrix.m[3][1] = y;
+	matrix.m[3][2] = z;
+	return matrix;
+}
+
+Matrix Matrix::Scale(float x, float y, float z)
+{
+	Matrix matrix;
+	memset(matrix.m, 0, sizeof(matrix.m));
+	matrix.m[0][0] = x;
+	matrix.m[1][1] = y;
+	matrix.m[2][2] = z;
+	matrix.m[3][3] = 1.0f;
+	return matrix;
+}
+
+// Rodrigues' formula, turning the x axis towards y for an axis along z
+Matrix Matrix::Rotate(float angle, float x, float y, float z)
+{
+	double length = std::sqrt((double) x * x + (double) y * y +
+							(double) z * z);
+	if (length == 0.0)
+		return Identity();
+	double a[] = { x / length, y / length, z / length };
+	double radians = angle * M_PI / 180.0;
+	double c = std::cos(radians);
+	double s = std::sin(radians);
+
+	Matrix matrix = Identity();
+	for (int i = 0; i < 3; i++) {
+		for (int j = 0; j < 3; j++)
+			matrix.m[i][j] = (float) (a[i] * a[j] * (1.0 - c) +
+						(i == j ? c : 0.0));
+	}
+	// the rows are where the axes go
+	matrix.m[0][1] += (float) (a[2] * s);
+	matrix.m[0][2] -= (float) (a[1] * s);
+	matrix.m[1][0] -= (float) (a[2] * s);
+	matrix.m[1][2] += (float) (a[0] * s);
+	matrix.m[2][0] += (float) (a[1] * s);
+	matrix.m[2][1] -= (float) (a[0] * s);
+	return matrix;
+}
+
+Matrix Matrix::FromRows(const float *values)
+{
+	Matrix matrix;
+	memcpy(matrix.m, values, sizeof(matrix.m));
+	return matrix;
+}
+
+Matrix Matrix::operator*(const Matrix &other) const
+{
+	Matrix product;
+	for (int i = 0; i < 4; i++) {
+		for (int j = 0; j < 4; j++) {
+			product.m[i][j] = m[i][0] * other.m[0][j] +
+					m[i][1] * other.m[1][j] +
+					m[i][2] * other.m[2][j] +
+					m[i][3] * other.m[3][j];
+		}
+	}
+	return product;
+}
+
+void Matrix::transform(const float *point, float *out) const
+{
+	float result[4];
+	for (int j = 0; j < 4; j++) {
+		result[j] = point[0] * m[0][j] + point[1] * m[1][j] +
+					point[2] * m[2][j] + m[3][j];
+	}
+	float w = result[3] != 0.0f ? result[3] : 1.0f;
+	out[0] = result[0] / w;
+	out[1] = result[1] / w;
+	out[2] = result[2] / w;
+}
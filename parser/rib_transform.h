@@ -0,0 +1,44 @@
+/* ************************************************************************
+ * Copyright 2017 Alexander Mishurov
+ * 
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ * 
+ * http://www.apache.org/licenses/LICENSE-2.0
+ * 
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ * ************************************************************************/
+
+#ifndef MAYAPLUGIN_RIBTRANSFORM_H_
+#define MAYAPLUGIN_RIBTRANSFORM_H_
+
+namespace rib {
+
+// A transformation as RenderMan writes it, points are row vectors
+// multiplied on the left, so the last row is the translation and
+// a * b is a first, then b. Maya's MMatrix is laid out the same.
+struct Matrix {
+	float m[4][4];
+
+	static Matrix Identity();
+	static Matrix Translate(float x, float y, float z);
+	static Matrix Scale(float x, float y, float z);
+	// angle degrees about the axis through the origin, the identity
+	// for an axis of no length
+	static Matrix Rotate(float angle, float x, float y, float z);
+	// 16 numbers row by row
+	static Matrix FromRows(const float *values);
+
+	Matrix operator*(const Matrix &other) const;
+	// of a point, without the division by w for affine ones
+	void transform(const float *point, float *out) const;
+};
+
+} /* namespace rib */
+
+#endif  // MAYAPLUGIN_RIBTRANSFORM_H_
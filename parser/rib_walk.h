@@ -0,0 +1,189 @@
+/* ************************************************************************
+ * Copyright 2017 Alexander Mishurov
+ * 
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ * 
+ * http://www.apache.org/licenses/LICENSE-2.0
+ * 
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ * ************************************************************************/
+
+#ifndef MAYAPLUGIN_RIBWALK_H_
+#define MAYAPLUGIN_RIBWALK_H_
+
+#include <cstddef>
+#include <vector>
+#include "parser/rib_driver.h"
+#include "parser/rib_flat.h"
+
+namespace rib {
+
+// What a walk calls, a visitor hides the ones it has a use for. The
+// walk is a template over the visitor's own type, so nothing is
+// virtual.
+struct Visitor {
+	// Before the children, false leaves them and leave() out.
+	template<typename N>
+	bool enter(N *node) { return true; }
+	// after the children
+	template<typename N>
+	void leave(N *node) {}
+	// a tree to walk as the node's first child, null if none
+	template<typename N>
+	N *inside(N *node) { return nullptr; }
+};
+
+// The same for a walk over a flat scene.
+struct FlatVisitor {
+	bool enter(size_t node) { return true; }
+	void leave(size_t node) {}
+};
+
+// Walks a tree depth first with a stack of its own, as deep as memory
+// allows whatever the call stack. N is Node or const Node.
+template<typename N, typename V>
+void Walk(N *root, V &visitor)
+{
+	// the nodes entered, with the next child and what is inside
+	struct Frame {
+		N *node;
+		size_t next;
+		N *inside;
+	};
+	std::vector<Frame> stack;
+	if (!visitor.enter(root))
+		return;
+	stack.push_back({root, 0, visitor.inside(root)});
+	while (!stack.empty()) {
+		Frame &frame = stack.back();
+		N *child;
+		if (frame.inside != nullptr) {
+			child = frame.inside;
+			frame.inside = nullptr;
+		} else if (frame.next < frame.node->children.size()) {
+			child = frame.node->children[frame.next++];
+		} else {
+			N *node = frame.node;
+			stack.pop_back();
+			visitor.leave(node);
+			continue;
+		}
+		if (visitor.enter(child))
+			stack.push_back({child, 0, visitor.inside(child)});
+	}
+}
+
+// The same over a flat scene, whose nodes are indices.
+template<typename V>
+void Walk(const FlatScene &scene, V &visitor)
+{
+	// the blocks entered and not left yet
+	std::vector<size_t> open;
+	for (size_t node = 0; node < scene.size(); ) {
+		while (!open.empty() && scene.ends[open.back()] <= node) {
+			visitor.leave(open.back());
+			open.pop_back();
+		}
+		if (!visitor.enter(node)) {
+			node = scene.ends[node];
+			continue;
+		}
+		if (scene.ends[node] > node + 1)
+			open.push_back(node);
+		else
+			visitor.leave(node);
+		node++;
+	}
+	while (!open.empty()) {
+		visitor.leave(open.back());
+		open.pop_back();
+	}
+}
+
+// T as const as N
+template<typename N, typename T>
+struct Like { typedef T type; };
+template<typename N, typename T>
+struct Like<const N, T> { typedef const T type; };
+
+template<typename T, typename N>
+typename Like<N, T>::type *As(N *node)
+{
+	return static_cast<typename Like<N, T>::type *>(node);
+}
+
+// Calls the visitor's visit() with the node as the class its type
+// says it is, an overload for Node takes the types it has none for.
+template<typename N, typename V>
+void Dispatch(N *node, V &visitor)
+{
+	switch (node->type) {
+	case kJoint:
+		visitor.visit(node);
+		break;
+	case kAttribute:
+		visitor.visit(As<AttributeNode>(node));
+		break;
+	case kTranslate:
+		visitor.visit(As<TranslateNode>(node));
+		break;
+	case kRotate:
+		visitor.visit(As<RotateNode>(node));
+		break;
+	case kScale:
+		visitor.visit(As<ScaleNode>(node));
+		break;
+	case kConcatTransform:
+		visitor.visit(As<ConcatTransformNode>(node));
+		break;
+	case kHyperboloid:
+		visitor.visit(As<HyperboloidNode>(node));
+		break;
+	case kParaboloid:
+		visitor.visit(As<ParaboloidNode>(node));
+		break;
+	case kTorus:
+		visitor.visit(As<TorusNode>(node));
+		break;
+	case kCylinder:
+		visitor.visit(As<CylinderNode>(node));
+		break;
+	case kSphere:
+		visitor.visit(As<SphereNode>(node));
+		break;
+	case kDisk:
+		visitor.visit(As<DiskNode>(node));
+		break;
+	case kCone:
+		visitor.visit(As<ConeNode>(node));
+		break;
+	case kPointsGeneralPolygons:
+		visitor.visit(As<PointsGeneralPolygonsNode>(node));
+		break;
+	case kPointsPolygons:
+		visitor.visit(As<PointsPolygonsNode>(node));
+		break;
+	case kPattern:
+		visitor.visit(As<PatternNode>(node));
+		break;
+	case kBxdf:
+		visitor.visit(As<BxdfNode>(node));
+		break;
+	case kLight:
+		visitor.visit(As<LightNode>(node));
+		break;
+	case kArchive:
+		visitor.visit(As<ArchiveNode>(node));
+		break;
+	}
+}
+
+} /* namespace rib */
+
+#endif  // MAYAPLUGIN_RIBWALK_H_
@@ -0,0 +1,70 @@
+/* ************************************************************************
+ * Copyright 2017 Alexander Mishurov
+ * 
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ * 
+ * http://www.apache.org/licenses/LICENSE-2.0
+ * 
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ * ************************************************************************/
+
+#include <cmath>
+#include <cstdio>
+#include "bench.h"
+
+namespace bench {
+
+namespace {
+
+const char *kQuadrics[] = {
+	"Sphere 1 -1 1 360",
+	"Cone 2 1 360",
+	"Cylinder 1 -1 1 360",
+	"Hyperboloid 1 0 -1 0 1 1 360",
+	"Paraboloid 1 0.1 2 360",
+	"Disk 0.5 1 360",
+	"Torus 1 0.3 0 360 360"
+};
+
+} // namespace
+
+double Seconds(std::chrono::steady_clock::time_point start)
+{
+	return std::chrono::duration<double>(
+			std::chrono::steady_clock::now() - start).count();
+}
+
+double Milliseconds(std::chrono::steady_clock::time_point start)
+{
+	return Seconds(start) * 1e3;
+}
+
+std::string MakeScene(int count, bool meshes)
+{
+	int side = (int) std::ceil(std::sqrt((double) count));
+	std::string text;
+	char line[128];
+	for (int i = 0; i < count; i++) {
+		snprintf(line, sizeof(line),
+			"AttributeBegin\nTranslate %d 0 %d\nRotate -90 1 0 0\n",
+			(i % side - side / 2) * 4, (i / side - side / 2) * 4);
+		text += line;
+		if (meshes && i % 16 == 15) {
+			text += "PointsPolygons [4] [0 1 2 3] "
+				"\"P\" [0 0 0 1 0 0 1 1 0 0 1 0]\n";
+		} else {
+			text += kQuadrics[i % 7];
+			text += "\n";
+		}
+		text += "AttributeEnd\n";
+	}
+	return text;
+}
+
+} // namespace bench
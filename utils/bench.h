@@ -0,0 +1,35 @@
+/* ************************************************************************
+ * Copyright 2017 Alexander Mishurov
+ * 
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ * 
+ * http://www.apache.org/licenses/LICENSE-2.0
+ * 
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ * ************************************************************************/
+
+#ifndef RIBPARSER_BENCH_H_
+#define RIBPARSER_BENCH_H_
+
+#include <chrono>
+#include <string>
+
+// What the benchmarks share.
+namespace bench {
+
+double Seconds(std::chrono::steady_clock::time_point start);
+double Milliseconds(std::chrono::steady_clock::time_point start);
+
+// count blocks of a quadric each, every kind in turn, on a square grid
+// 4 apart on the ground, one in 16 a quad mesh instead if meshes is set
+std::string MakeScene(int count, bool meshes);
+
+} // namespace bench
+
+#endif  // RIBPARSER_BENCH_H_
@@ -0,0 +1,176 @@
+/* ************************************************************************
+ * Copyright 2017 Alexander Mishurov
+ * 
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ * 
+ * http://www.apache.org/licenses/LICENSE-2.0
+ * 
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ * ************************************************************************/
+
+// Nanoseconds a token of ParseFloat and ParseInt against atof and atoi,
+// the path the lexer took before, on the same made up numbers as RIB
+// files have them, and how many floats differ from strtof.
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <random>
+#include <string>
+#include <vector>
+#include "parser/rib_number.h"
+#include "utils/bench.h"
+
+namespace {
+
+// Tokens one after another, each ended by a NUL so that atof and atoi
+// can read them too.
+struct Tokens {
+	std::string text;
+	std::vector<size_t> begins;
+
+	const char *begin(size_t i) const { return text.data() + begins[i]; }
+	const char *end(size_t i) const
+	{
+		return text.data() + (i + 1 < begins.size() ?
+				begins[i + 1] : text.size()) - 1;
+	}
+	void add(const char *token)
+	{
+		begins.push_back(text.size());
+		text += token;
+		text += '\0';
+	}
+};
+
+// floats with a few digits either side of the point, one in eight
+// with an exponent, a quarter of them negative
+Tokens MakeFloats(int count)
+{
+	std::mt19937 random(1);
+	std::uniform_int_distribution<int> digits(0, 6);
+	std::uniform_real_distribution<double> value(0.0, 1000.0);
+	Tokens tokens;
+	char token[64];
+	for (int i = 0; i < count; i++) {
+		const char *sign = random() % 4 == 0 ? "-" : "";
+		if (random() % 8 == 0) {
+			snprintf(token, sizeof(token), "%s%.*fe%d", sign,
+				digits(random), value(random) / 1000.0,
+				(int) (random() % 60) - 30);
+		} else {
+			snprintf(token, sizeof(token), "%s%.*f", sign,
+				digits(random), value(random));
+		}
+		tokens.add(token);
+	}
+	return tokens;
+}
+
+// indices and counts, mostly small
+Tokens MakeInts(int count)
+{
+	std::mt19937 random(2);
+	Tokens tokens;
+	char token[32];
+	for (int i = 0; i < count; i++) {
+		int most = random() % 4 == 0 ? 10000000 : 1000;
+		snprintf(token, sizeof(token), "%d", (int) (random() % most));
+		tokens.add(token);
+	}
+	return tokens;
+}
+
+} // namespace
+
+int main(int argc, char **argv)
+{
+	int count = 2000000;
+	int repeats = 5;
+	for (int i = 1; i < argc; i++) {
+		if (strcmp(argv[i], "-n") == 0 && i + 1 < argc) {
+			count = atoi(argv[++i]);
+		} else if (strcmp(argv[i], "-r") == 0 && i + 1 < argc) {
+			repeats = atoi(argv[++i]);
+		} else {
+			count = 0;
+			break;
+		}
+	}
+	if (count < 1 || repeats < 1) {
+		printf("Usage: %s [-n tokens] [-r repeats]\n", argv[0]);
+		return EXIT_FAILURE;
+	}
+
+	Tokens floats = MakeFloats(count);
+	Tokens ints = MakeInts(count);
+	double tokens = (double) count * repeats;
+	// summed so that the calls can't be left out
+	volatile double sink = 0.0;
+
+	auto start = std::chrono::steady_clock::now();
+	for (int r = 0; r < repeats; r++) {
+		double sum = 0.0;
+		for (int i = 0; i < count; i++)
+			sum += (float) atof(floats.begin(i));
+		sink = sink + sum;
+	}
+	double atof_ns = bench::Seconds(start) * 1e9 / tokens;
+
+	start = std::chrono::steady_clock::now();
+	for (int r = 0; r < repeats; r++) {
+		double sum = 0.0;
+		for (int i = 0; i < count; i++)
+			sum += rib::ParseFloat(floats.begin(i), floats.end(i));
+		sink = sink + sum;
+	}
+	double parse_float_ns = bench::Seconds(start) * 1e9 / tokens;
+
+	start = std::chrono::steady_clock::now();
+	for (int r = 0; r < repeats; r++) {
+		long sum = 0;
+		for (int i = 0; i < count; i++)
+			sum += atoi(ints.begin(i));
+		sink = sink + sum;
+	}
+	double atoi_ns = bench::Seconds(start) * 1e9 / tokens;
+
+	start = std::chrono::steady_clock::now();
+	for (int r = 0; r < repeats; r++) {
+		long sum = 0;
+		for (int i = 0; i < count; i++) {
+			int value = 0;
+			rib::ParseInt(ints.begin(i), ints.end(i), &value);
+			sum += value;
+		}
+		sink = sink + sum;
+	}
+	double parse_int_ns = bench::Seconds(start) * 1e9 / tokens;
+
+	int float_misses = 0, int_misses = 0;
+	for (int i = 0; i < count; i++) {
+		float value = rib::ParseFloat(floats.begin(i), floats.end(i));
+		if (value != strtof(floats.begin(i), nullptr))
+			float_misses++;
+		int number = 0;
+		if (!rib::ParseInt(ints.begin(i), ints.end(i), &number) ||
+		    number != atoi(ints.begin(i)))
+			int_misses++;
+	}
+
+	printf("%d tokens of each, %d times\n", count, repeats);
+	printf("%-8s %10s %10s %8s %10s\n", "", "old ns", "new ns",
+		"speedup", "differ");
+	printf("%-8s %10.1f %10.1f %7.1fx %10d\n", "float", atof_ns,
+		parse_float_ns, atof_ns / parse_float_ns, float_misses);
+	printf("%-8s %10.1f %10.1f %7.1fx %10d\n", "int", atoi_ns,
+		parse_int_ns, atoi_ns / parse_int_ns, int_misses);
+	return EXIT_SUCCESS;
+}
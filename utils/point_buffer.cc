@@ -0,0 +1,253 @@
+/* ************************************************************************
+ * Copyright 2017 Alexander Mishurov
+ * 
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ * 
+ * http://www.apache.org/licenses/LICENSE-2.0
+ * 
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ * ************************************************************************/
+
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+#include <unordered_map>
+#include <utility>
+#include "point_buffer.h"
+#include "parser/rib_hash.h"
+
+namespace rib {
+
+namespace {
+
+// The points of a node are the same for the same key and samples, its
+// id covers what it holds and its seed, the rest is the world matrix.
+uint64_t Key(const FlatScene &scene, size_t node)
+{
+	return HashBytes(&scene.world(node), sizeof(Matrix), scene.ids[node]);
+}
+
+} // namespace
+
+void PointBuffer::reset(size_t nodes)
+{
+	Range none = { 0, 0, kNone, 0 };
+	ranges_.assign(nodes, none);
+	vertices_.clear();
+	indices_.clear();
+	shown_.clear();
+	unused_ = 0;
+	lose();
+	version_++;
+}
+
+void PointBuffer::carry(const FlatScene &scene)
+{
+	std::unordered_map<uint64_t, Range> had;
+	for (size_t node = 0; node < ranges_.size(); node++) {
+		if (ranges_[node].samples != kNone)
+			had.insert({ ranges_[node].key, ranges_[node] });
+	}
+	Range none = { 0, 0, kNone, 0 };
+	ranges_.assign(scene.size(), none);
+	size_t kept = 0;
+	if (!had.empty()) {
+		for (size_t node = 0; node < ranges_.size(); node++) {
+			auto found = had.find(Key(scene, node));
+			if (found == had.end())
+				continue;
+			ranges_[node] = found->second;
+			kept += found->second.count;
+			// one node a range
+			had.erase(found);
+		}
+	}
+	unused_ = size() - kept;
+	if (unused_ > used())
+		pack();
+	shown_.clear();
+	indices_.clear();
+	version_++;
+}
+
+void PointBuffer::update(const FlatScene &scene,
+				const std::vector<PointJob> &jobs,
+				const PointCloud &cloud)
+{
+	if (jobs.empty())
+		return;
+	for (size_t i = 0; i < jobs.size(); i++) {
+		Range &range = ranges_[jobs[i].node];
+		if (range.samples != kNone)
+			unused_ += range.count;
+		range.begin = (uint32_t) size();
+		range.count = (uint32_t) cloud.count(i);
+		range.samples = jobs[i].samples;
+		range.key = Key(scene, jobs[i].node);
+		vertices_.insert(vertices_.end(), cloud.begin(i),
+				cloud.begin(i) + range.count * 3);
+	}
+	if (unused_ > used())
+		pack();
+	// the ranges moved, so the indices have to be made again
+	shown_.clear();
+	indices_.clear();
+	version_++;
+}
+
+void PointBuffer::pack()
+{
+	std::vector<float> packed;
+	packed.reserve(used() * 3);
+	for (size_t node = 0; node < ranges_.size(); node++) {
+		Range &range = ranges_[node];
+		if (range.samples == kNone)
+			continue;
+		const float *from = vertices_.data() + range.begin * 3;
+		range.begin = (uint32_t) (packed.size() / 3);
+		packed.insert(packed.end(), from, from + range.count * 3);
+	}
+	vertices_.swap(packed);
+	unused_ = 0;
+	synced_ = 0;
+}
+
+bool PointBuffer::show(const std::vector<uint32_t> &visible)
+{
+	if (visible == shown_)
+		return false;
+	shown_ = visible;
+	indices_.clear();
+	for (size_t i = 0; i < visible.size(); i++) {
+		const Range &range = ranges_[visible[i]];
+		if (range.samples == kNone)
+			continue;
+		for (uint32_t k = 0; k < range.count; k++)
+			indices_.push_back(range.begin + k);
+	}
+	version_++;
+	return true;
+}
+
+PointBuffer::Upload PointBuffer::sync()
+{
+	Upload upload = { synced_, size(), 0 };
+	if (size() > capacity_) {
+		capacity_ = size() * 2;
+		upload.begin = 0;
+		upload.capacity = capacity_;
+	}
+	synced_ = size();
+	return upload;
+}
+
+float ScreenSize(const Matrix &clip, const Bound &bound, int width,
+							int height)
+{
+	float low[] = { FLT_MAX, FLT_MAX };
+	float high[] = { -FLT_MAX, -FLT_MAX };
+	for (int i = 0; i < 8; i++) {
+		const float corner[] = {
+			(i & 1) ? bound.max[0] : bound.min[0],
+			(i & 2) ? bound.max[1] : bound.min[1],
+			(i & 4) ? bound.max[2] : bound.min[2]
+		};
+		float p[4];
+		for (int j = 0; j < 4; j++) {
+			p[j] = corner[0] * clip.m[0][j] + corner[1] *
+				clip.m[1][j] + corner[2] * clip.m[2][j] +
+				clip.m[3][j];
+		}
+		if (p[3] <= 0.0f)
+			return (float) std::max(width, height);
+		for (int j = 0; j < 2; j++) {
+			low[j] = std::min(low[j], p[j] / p[3]);
+			high[j] = std::max(high[j], p[j] / p[3]);
+		}
+	}
+	return std::max((high[0] - low[0]) * width,
+				(high[1] - low[1]) * height) * 0.5f;
+}
+
+unsigned Samples(float pixels, const Detail &detail)
+{
+	float wanted = std::min(std::max(pixels * detail.density,
+			(float) detail.least), (float) detail.most);
+	unsigned samples = 1u << (int) std::lround(std::log2(wanted));
+	return std::min(std::max(samples, (unsigned) detail.least),
+						(unsigned) detail.most);
+}
+
+bool Refresh(const FlatScene &scene, const Bvh &bvh,
+			const std::vector<View> &views, const Detail &detail,
+			ThreadPool *pool, PointBuffer *buffer)
+{
+	// what each view sees and how large, sorted by node
+	std::vector<std::pair<uint32_t, float>> seen;
+	std::vector<uint32_t> culled;
+	for (size_t v = 0; v < views.size(); v++) {
+		const View &view = views[v];
+		bvh.cull(Frustum(view.clip), &culled);
+		for (size_t i = 0; i < culled.size(); i++) {
+			uint32_t node = culled[i];
+			NodeType type = scene.type(node);
+			float pixels = 0.0f;
+			// the types from Hyperboloid to Cone
+			if (type >= kHyperboloid && type <= kCone) {
+				pixels = ScreenSize(view.clip, bvh.bound(node),
+						view.width, view.height);
+			}
+			seen.push_back({ node, pixels });
+		}
+	}
+	if (views.size() > 1)
+		std::sort(seen.begin(), seen.end());
+	// a node seen by more views is as large as in the one it is
+	// largest in, which sorts last
+	std::vector<uint32_t> visible;
+	std::vector<float> largest;
+	for (size_t i = 0; i < seen.size(); i++) {
+		if (i + 1 < seen.size() && seen[i + 1].first == seen[i].first)
+			continue;
+		visible.push_back(seen[i].first);
+		largest.push_back(seen[i].second);
+	}
+
+	bool changed = false;
+	if (buffer->used() > detail.budget) {
+		size_t shown = 0;
+		for (size_t i = 0; i < visible.size(); i++)
+			shown += buffer->count(visible[i]);
+		if (shown < buffer->used() / 2) {
+			buffer->reset(buffer->nodes());
+			changed = true;
+		}
+	}
+
+	std::vector<PointJob> jobs;
+	for (size_t i = 0; i < visible.size(); i++) {
+		uint32_t node = visible[i];
+		NodeType type = scene.type(node);
+		unsigned samples = 0;
+		if (type >= kHyperboloid && type <= kCone)
+			samples = Samples(largest[i], detail);
+		unsigned has = buffer->samples(node);
+		if (has != samples)
+			jobs.push_back(PointJob { node, samples });
+	}
+	if (!jobs.empty()) {
+		PointCloud cloud;
+		Tessellate(scene, jobs, pool, &cloud);
+		buffer->update(scene, jobs, cloud);
+		changed = true;
+	}
+	return buffer->show(visible) || changed;
+}
+
+} /* namespace rib */
@@ -0,0 +1,159 @@
+/* ************************************************************************
+ * Copyright 2017 Alexander Mishurov
+ * 
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ * 
+ * http://www.apache.org/licenses/LICENSE-2.0
+ * 
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ * ************************************************************************/
+
+#ifndef RIBPARSER_POINT_BUFFER_H_
+#define RIBPARSER_POINT_BUFFER_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+#include "parser/rib_bvh.h"
+#include "parser/rib_flat.h"
+#include "parser/rib_transform.h"
+#include "utils/point_cloud.h"
+
+namespace rib {
+
+// The points of a scene's nodes laid out for a vertex and an index
+// buffer that stay on the GPU between frames. A node keeps its range
+// of vertices until it is sampled again, then its new points go at the
+// end and the old range is left unused, the vertices are packed once
+// the unused outweigh the rest. The indices name only the vertices of
+// the nodes in view, they are made again for every camera and are what
+// culls the vertices that stay.
+//
+// The GPU copy of the vertices is kept up to date by sync, which tells
+// what it lacks: mostly only the vertices appended since the last one,
+// all of them after a pack, a reset, or when the copy has to grow.
+class PointBuffer {
+public:
+	// the samples of a node that isn't in the buffer
+	static const unsigned kNone = ~0u;
+
+	// The vertices from begin to end to send, after first making the
+	// copy room for capacity of them if that isn't 0.
+	struct Upload {
+		size_t begin;
+		size_t end;
+		size_t capacity;
+	};
+
+	PointBuffer() : unused_(0), synced_(0), capacity_(0), version_(0) {}
+
+	// Empties the buffer for a scene of that many nodes.
+	void reset(size_t nodes);
+	// Takes the buffer to another parse of its scene, or another
+	// scene: a node whose id and world matrix are those of a node with
+	// points here gets those points, the rest are left unused. So only
+	// what an edit changed is made again.
+	void carry(const FlatScene &scene);
+	size_t nodes() const { return ranges_.size(); }
+	// What the node's points were made with, kNone if it has none.
+	unsigned samples(uint32_t node) const { return ranges_[node].samples; }
+	// its vertices, 0 if it has none
+	uint32_t count(uint32_t node) const { return ranges_[node].count; }
+	// Puts in the points Tessellate made of the jobs.
+	void update(const FlatScene &scene, const std::vector<PointJob> &jobs,
+				const PointCloud &cloud);
+	// Indexes the vertices of the visible nodes, sorted, in that order.
+	// Returns whether the indices changed.
+	bool show(const std::vector<uint32_t> &visible);
+
+	// 3 floats each
+	const std::vector<float> &vertices() const { return vertices_; }
+	const std::vector<uint32_t> &indices() const { return indices_; }
+	size_t size() const { return vertices_.size() / 3; }
+	// the vertices some node uses
+	size_t used() const { return size() - unused_; }
+	// Goes up with every change to the vertices or the indices, what
+	// a GPU copy compares to know it is stale.
+	unsigned version() const { return version_; }
+	// What the GPU copy lacks, then takes it as sent. Room is made
+	// for twice the vertices there are, so that appending rarely has
+	// to send them all.
+	Upload sync();
+	// Takes it that the GPU copy is gone, the next sync sends all.
+	void lose() { synced_ = 0; capacity_ = 0; }
+private:
+	struct Range {
+		uint32_t begin;
+		uint32_t count;
+		unsigned samples;
+		// what made the points, less the samples, see carry
+		uint64_t key;
+	};
+
+	void pack();
+
+	std::vector<Range> ranges_;
+	std::vector<float> vertices_;
+	std::vector<uint32_t> indices_;
+	// the nodes indexed
+	std::vector<uint32_t> shown_;
+	// vertices no node uses
+	size_t unused_;
+	// the vertices the GPU copy has as they are here, and its room
+	size_t synced_;
+	size_t capacity_;
+	unsigned version_;
+};
+
+// How finely quadrics are sampled for the space they take on the
+// screen.
+struct Detail {
+	// samples across per pixel, and the least and most there may be
+	float density = 0.5f;
+	int least = 4;
+	int most = 64;
+	// the vertices used past which the buffer is made again from what
+	// the cameras see
+	size_t budget = 1 << 24;
+};
+
+// A camera the buffer is drawn from, its clip matrix and the size of
+// its viewport.
+struct View {
+	Matrix clip = Matrix::Identity();
+	int width = 1;
+	int height = 1;
+};
+
+// The pixels the widest side of a box covers, as many as there are if
+// it reaches behind the camera.
+float ScreenSize(const Matrix &clip, const Bound &bound, int width,
+							int height);
+
+// Samples across a quadric that size on the screen, a power of two so
+// that only a change by half or double makes new points.
+unsigned Samples(float pixels, const Detail &detail);
+
+// Brings the buffer up to date for the views, which all draw from it:
+// the nodes any of them sees that aren't in it yet, or whose samples
+// aren't what their size in the view they look largest in asks for
+// now, finer or coarser, are made on the pool's threads and put in,
+// then only the nodes seen are indexed. What isn't seen keeps its
+// vertices, so a camera going back over where it has been at the same
+// distance changes only the indices.
+// Once the buffer is over budget and mostly out of view it is emptied
+// and filled with only what is seen now.
+// Returns whether anything changed.
+bool Refresh(const FlatScene &scene, const Bvh &bvh,
+			const std::vector<View> &views, const Detail &detail,
+			ThreadPool *pool, PointBuffer *buffer);
+
+} /* namespace rib */
+
+#endif  // RIBPARSER_POINT_BUFFER_H_
@@ -0,0 +1,210 @@
+/* ************************************************************************
+ * Copyright 2017 Alexander Mishurov
+ * 
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ * 
+ * http://www.apache.org/licenses/LICENSE-2.0
+ * 
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ * ************************************************************************/
+
+// A camera circles a file's scene or, without one, a made up field of
+// quadrics twice. Prints the time Refresh takes a frame, the frames
+// that change the buffer, those that send all the vertices, and the
+// bytes sent to the GPU, the vertices sync asks for and the indices,
+// against what sending every visible point every frame would.
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+#include "parser/rib_bvh.h"
+#include "parser/rib_driver.h"
+#include "parser/rib_flat.h"
+#include "parser/rib_transform.h"
+#include "utils/bench.h"
+#include "utils/point_buffer.h"
+
+namespace {
+
+float Dot(const float *a, const float *b)
+{
+	return a[0] * b[0] + a[1] * b[1] + a[2] * b[2];
+}
+
+void Normalize(float *a)
+{
+	float length = std::sqrt(Dot(a, a));
+	for (int i = 0; i < 3; i++)
+		a[i] /= length;
+}
+
+// from the eye towards the target with y up, then a 45 degree
+// perspective, as Maya's view and projection matrices are
+rib::Matrix Camera(const float *eye, const float *target, float aspect,
+						float near, float far)
+{
+	float back[] = { eye[0] - target[0], eye[1] - target[1],
+				eye[2] - target[2] };
+	Normalize(back);
+	float right[] = { back[2], 0.0f, -back[0] };
+	Normalize(right);
+	float up[] = {
+		back[1] * right[2] - back[2] * right[1],
+		back[2] * right[0] - back[0] * right[2],
+		back[0] * right[1] - back[1] * right[0]
+	};
+	rib::Matrix view = rib::Matrix::Identity();
+	for (int i = 0; i < 3; i++) {
+		view.m[i][0] = right[i];
+		view.m[i][1] = up[i];
+		view.m[i][2] = back[i];
+	}
+	view.m[3][0] = -Dot(right, eye);
+	view.m[3][1] = -Dot(up, eye);
+	view.m[3][2] = -Dot(back, eye);
+
+	float f = 1.0f / std::tan(22.5f * 3.14159265f / 180.0f);
+	rib::Matrix projection = {};
+	projection.m[0][0] = f / aspect;
+	projection.m[1][1] = f;
+	projection.m[2][2] = (far + near) / (near - far);
+	projection.m[2][3] = -1.0f;
+	projection.m[3][2] = 2.0f * far * near / (near - far);
+	return view * projection;
+}
+
+} // namespace
+
+int main(int argc, char **argv)
+{
+	const char *filename = nullptr;
+	int frames = 240;
+	int count = 20000;
+	int threads = 0;
+	long budget = 1 << 24;
+	for (int i = 1; i < argc; i++) {
+		if (strcmp(argv[i], "-f") == 0 && i + 1 < argc) {
+			frames = atoi(argv[++i]);
+		} else if (strcmp(argv[i], "-n") == 0 && i + 1 < argc) {
+			count = atoi(argv[++i]);
+		} else if (strcmp(argv[i], "-t") == 0 && i + 1 < argc) {
+			threads = atoi(argv[++i]);
+		} else if (strcmp(argv[i], "-b") == 0 && i + 1 < argc) {
+			budget = atol(argv[++i]);
+		} else if (argv[i][0] != '-') {
+			filename = argv[i];
+		} else {
+			frames = 0;
+			break;
+		}
+	}
+	if (frames < 1 || count < 1 || threads < 0 || budget < 1) {
+		printf("Usage: %s [-f frames an orbit] [-n made up primitives] "
+			"[-t threads] [-b budget vertices] [file.rib]\n",
+			argv[0]);
+		return EXIT_FAILURE;
+	}
+
+	rib::Driver driver;
+	rib::Scene tree;
+	rib::ParseError error;
+	if (filename != nullptr) {
+		error = driver.parse(filename, &tree, 0);
+	} else {
+		std::string text = bench::MakeScene(count, false);
+		error = driver.parseBuffer(text.data(), text.size(), &tree, 0);
+	}
+	if (error != rib::kSuccess) {
+		printf("Couldn't parse: %s\n", tree.message.c_str());
+		return EXIT_FAILURE;
+	}
+	rib::FlatScene scene;
+	rib::Flatten(tree.root, &scene);
+	rib::Bvh bvh;
+	bvh.build(scene);
+	if (bvh.bound().empty()) {
+		printf("Nothing to draw\n");
+		return EXIT_FAILURE;
+	}
+
+	// circles the middle of the scene a little above it, near enough
+	// to see part of it at a time
+	const rib::Bound &bound = bvh.bound();
+	float middle[3], size = 0.0f;
+	for (int i = 0; i < 3; i++) {
+		middle[i] = (bound.min[i] + bound.max[i]) * 0.5f;
+		size = std::max(size, bound.max[i] - bound.min[i]);
+	}
+	rib::Detail detail;
+	detail.budget = (size_t) budget;
+	std::vector<rib::View> views(1);
+	views[0].width = 1920;
+	views[0].height = 1080;
+	float aspect = (float) views[0].width / views[0].height;
+
+	printf("%zu nodes, %d frames an orbit\n", bvh.size(), frames);
+	printf("%6s %10s %10s %10s %10s %12s %12s\n", "orbit", "mean ms",
+		"max ms", "uploads", "whole", "sent MB", "per frame MB");
+	rib::PointBuffer buffer;
+	buffer.reset(scene.size());
+	rib::ThreadPool pool(threads);
+	std::vector<uint32_t> visible;
+	for (int orbit = 1; orbit <= 2; orbit++) {
+		double total = 0.0, most = 0.0;
+		double sent = 0.0, immediate = 0.0;
+		int uploads = 0, whole = 0;
+		for (int frame = 0; frame < frames; frame++) {
+			float angle = 6.2831853f * frame / frames;
+			float eye[] = {
+				middle[0] + size * 0.3f * std::cos(angle),
+				middle[1] + size * 0.05f,
+				middle[2] + size * 0.3f * std::sin(angle)
+			};
+			views[0].clip = Camera(eye, middle, aspect,
+						size * 0.001f, size * 2.0f);
+			auto start = std::chrono::steady_clock::now();
+			bool changed = rib::Refresh(scene, bvh, views, detail,
+						&pool, &buffer);
+			double took = bench::Milliseconds(start);
+			total += took;
+			most = std::max(most, took);
+			if (changed) {
+				// what the locator's populateGeometry sends
+				rib::PointBuffer::Upload upload = buffer.sync();
+				uploads++;
+				if (upload.begin == 0 && upload.end > 0)
+					whole++;
+				sent += (upload.end - upload.begin) * 3 *
+						sizeof(float) +
+					buffer.indices().size() *
+						sizeof(uint32_t);
+			}
+
+			// what the UI drawables sent, every point in view
+			bvh.cull(rib::Frustum(views[0].clip), &visible);
+			for (size_t i = 0; i < visible.size(); i++) {
+				rib::PointJob job = { visible[i],
+					buffer.samples(visible[i]) };
+				immediate += rib::PointCount(scene, job) * 3 *
+							sizeof(float);
+			}
+		}
+		printf("%6d %10.2f %10.2f %10d %10d %12.1f %12.1f\n", orbit,
+			total / frames, most, uploads, whole, sent / 1e6,
+			immediate / 1e6);
+	}
+	printf("%zu vertices, %zu used, %zu in view\n", buffer.size(),
+		buffer.used(), buffer.indices().size());
+	return EXIT_SUCCESS;
+}
@@ -0,0 +1,171 @@
+/* ************************************************************************
+ * Copyright 2017 Alexander Mishurov
+ * 
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ * 
+ * http://www.apache.org/licenses/LICENSE-2.0
+ * 
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ * ************************************************************************/
+
+#include <algorithm>
+#include "point_cloud.h"
+#include "utils/quadric_grid.h"
+#include "utils/sampling.h"
+
+namespace rib {
+
+namespace {
+
+typedef void (*GridFunction)(const float *, const float *, int,
+					const float *, int, float *);
+
+// null for the types that aren't quadrics
+GridFunction GridOf(NodeType type)
+{
+	switch (type) {
+	case kHyperboloid:
+		return quadrics::HyperboloidGrid;
+	case kParaboloid:
+		return quadrics::ParaboloidGrid;
+	case kTorus:
+		return quadrics::TorusGrid;
+	case kCylinder:
+		return quadrics::CylinderGrid;
+	case kSphere:
+		return quadrics::SphereGrid;
+	case kDisk:
+		return quadrics::DiskGrid;
+	case kCone:
+		return quadrics::ConeGrid;
+	default:
+		return nullptr;
+	}
+}
+
+// P of a mesh, null if it has none
+const FlatPrimvar *PointsOf(const FlatScene &scene, size_t node)
+{
+	const FlatMesh &mesh = scene.meshes[scene.items[node]];
+	const FlatPrimvar *P = scene.findPrimvar(mesh, kSymbolP);
+	if (P == nullptr || P->declaration.type == kString)
+		return nullptr;
+	return P;
+}
+
+// the bound of a delayed archive, null for one that is read
+const float *CornersOf(const FlatScene &scene, size_t node)
+{
+	const FlatArchive &archive = scene.archives[scene.items[node]];
+	if (scene.ends[node] > node + 1 || archive.bound.size() != 6)
+		return nullptr;
+	return scene.data.data() + archive.bound.begin;
+}
+
+// Writes the points of a job from out on, in the node's own space.
+void Make(const FlatScene &scene, const PointJob &job, float *out)
+{
+	NodeType type = scene.type(job.node);
+	GridFunction grid = GridOf(type);
+	if (grid != nullptr) {
+		int numu, numv;
+		GridSize(type, job.samples, &numu, &numv);
+		std::vector<float> u(numu);
+		std::vector<float> v(numv);
+		uint64_t seed = scene.ids[job.node];
+		sampling::Strata(sampling::kR2, seed, 0, numu, u.data());
+		sampling::Strata(sampling::kR2, seed, 1, numv, v.data());
+		grid(scene.row(job.node), u.data(), numu, v.data(), numv, out);
+		return;
+	}
+	if (type == kPointsPolygons || type == kPointsGeneralPolygons) {
+		const FlatPrimvar *P = PointsOf(scene, job.node);
+		const float *values = scene.data.data() + P->values.begin;
+		std::copy(values, values + P->values.size() / 3 * 3, out);
+		return;
+	}
+	if (type == kArchive) {
+		const float *bound = CornersOf(scene, job.node);
+		for (int i = 0; i < 8; i++) {
+			*out++ = bound[i & 1];
+			*out++ = bound[2 + ((i >> 1) & 1)];
+			*out++ = bound[4 + ((i >> 2) & 1)];
+		}
+	}
+}
+
+} // namespace
+
+void GridSize(NodeType type, unsigned samples, int *numu, int *numv)
+{
+	// as the plug-in's fixed grids were, 50x30, 60x60, 60x30 and so on
+	int along = (int) samples;
+	switch (type) {
+	case kSphere:
+	case kCone:
+	case kCylinder:
+		along = (int) samples * 3 / 5;
+		break;
+	case kTorus:
+		along = (int) samples / 2;
+		break;
+	default:
+		break;
+	}
+	*numu = (int) samples;
+	*numv = std::max(2, along);
+}
+
+size_t PointCount(const FlatScene &scene, const PointJob &job)
+{
+	NodeType type = scene.type(job.node);
+	if (GridOf(type) != nullptr) {
+		int numu, numv;
+		GridSize(type, job.samples, &numu, &numv);
+		return (size_t) numu * numv;
+	}
+	if (type == kPointsPolygons || type == kPointsGeneralPolygons) {
+		const FlatPrimvar *P = PointsOf(scene, job.node);
+		return P != nullptr ? P->values.size() / 3 : 0;
+	}
+	if (type == kArchive)
+		return CornersOf(scene, job.node) != nullptr ? 8 : 0;
+	return 0;
+}
+
+void Tessellate(const FlatScene &scene, const std::vector<PointJob> &jobs,
+				ThreadPool *pool, PointCloud *cloud)
+{
+	cloud->offsets.resize(jobs.size() + 1);
+	size_t total = 0;
+	for (size_t i = 0; i < jobs.size(); i++) {
+		cloud->offsets[i] = total;
+		total += PointCount(scene, jobs[i]);
+	}
+	cloud->offsets[jobs.size()] = total;
+	cloud->points.resize(total * 3);
+
+	auto make = [&](size_t i) {
+		if (cloud->count(i) == 0)
+			return;
+		float *out = cloud->points.data() + cloud->offsets[i] * 3;
+		Make(scene, jobs[i], out);
+		const Matrix &world = scene.world(jobs[i].node);
+		for (size_t k = 0; k < cloud->count(i); k++)
+			world.transform(out + k * 3, out + k * 3);
+	};
+	if (pool != nullptr) {
+		pool->run(jobs.size(), make);
+	} else {
+		for (size_t i = 0; i < jobs.size(); i++)
+			make(i);
+	}
+}
+
+} /* namespace rib */
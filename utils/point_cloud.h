@@ -0,0 +1,66 @@
+/* ************************************************************************
+ * Copyright 2017 Alexander Mishurov
+ * 
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ * 
+ * http://www.apache.org/licenses/LICENSE-2.0
+ * 
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ * ************************************************************************/
+
+#ifndef RIBPARSER_POINT_CLOUD_H_
+#define RIBPARSER_POINT_CLOUD_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+#include "parser/rib_flat.h"
+#include "parser/rib_parallel.h"
+
+namespace rib {
+
+// A node to make the points of, quadrics at samples across and the
+// rest as they are.
+struct PointJob {
+	uint32_t node;
+	unsigned samples;
+};
+
+// The u by v grid of a quadric with samples across, v in the
+// proportion to u the shape needs.
+void GridSize(NodeType type, unsigned samples, int *numu, int *numv);
+
+// The points of each job one after another, in the scene's space.
+struct PointCloud {
+	// 3 floats each
+	std::vector<float> points;
+	// where each job's points start, and where the last ends
+	std::vector<size_t> offsets;
+
+	size_t size() const { return points.size() / 3; }
+	const float *begin(size_t job) const
+		{ return points.data() + offsets[job] * 3; }
+	size_t count(size_t job) const
+		{ return offsets[job + 1] - offsets[job]; }
+};
+
+// The points the job makes, 0 for nodes that draw nothing.
+size_t PointCount(const FlatScene &scene, const PointJob &job);
+
+// Makes the points of the jobs on the pool's threads, on the calling
+// one alone if pool is null. The buffer is sized first, then every job writes its own
+// slice of it from whichever thread takes it. A quadric's samples fall
+// where its node's id says, so they are the same on every run and
+// after edits elsewhere in the file.
+void Tessellate(const FlatScene &scene, const std::vector<PointJob> &jobs,
+				ThreadPool *pool, PointCloud *cloud);
+
+} /* namespace rib */
+
+#endif  // RIBPARSER_POINT_CLOUD_H_
@@ -0,0 +1,149 @@
+/* ************************************************************************
+ * Copyright 2017 Alexander Mishurov
+ * 
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ * 
+ * http://www.apache.org/licenses/LICENSE-2.0
+ * 
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ * ************************************************************************/
+
+// Points per second of Tessellate on 1, 2, 4 and so on threads up to
+// one per core or as many as -t says, for a file or, without one, a
+// made up scene of every quadric and a few meshes, and whether every
+// run made the same points. Past the cores there are, the threads only
+// take turns, so the scaling column means something only up to nproc.
+// Then the time a call takes for a frame's worth of jobs, as -j says,
+// on a pool started once against threads started for every call, as
+// ParallelFor does.
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+#include "parser/rib_driver.h"
+#include "parser/rib_flat.h"
+#include "parser/rib_parallel.h"
+#include "utils/bench.h"
+#include "utils/point_cloud.h"
+
+namespace {
+
+// calls timed for a frame's worth of jobs
+const int kFrames = 200;
+
+} // namespace
+
+int main(int argc, char **argv)
+{
+	const char *filename = nullptr;
+	int samples = 32;
+	int repeats = 10;
+	int count = 20000;
+	int most = 0;
+	int per_frame = 64;
+	for (int i = 1; i < argc; i++) {
+		if (strcmp(argv[i], "-s") == 0 && i + 1 < argc) {
+			samples = atoi(argv[++i]);
+		} else if (strcmp(argv[i], "-r") == 0 && i + 1 < argc) {
+			repeats = atoi(argv[++i]);
+		} else if (strcmp(argv[i], "-n") == 0 && i + 1 < argc) {
+			count = atoi(argv[++i]);
+		} else if (strcmp(argv[i], "-t") == 0 && i + 1 < argc) {
+			most = atoi(argv[++i]);
+		} else if (strcmp(argv[i], "-j") == 0 && i + 1 < argc) {
+			per_frame = atoi(argv[++i]);
+		} else if (argv[i][0] != '-') {
+			filename = argv[i];
+		} else {
+			filename = nullptr;
+			samples = 0;
+			break;
+		}
+	}
+	if (samples < 2 || repeats < 1 || count < 1 || most < 0 ||
+	    per_frame < 1) {
+		printf("Usage: %s [-s samples across] [-r repeats] "
+			"[-n made up primitives] [-t most threads] "
+			"[-j jobs a frame] [file.rib]\n", argv[0]);
+		return EXIT_FAILURE;
+	}
+
+	rib::Driver driver;
+	rib::Scene tree;
+	rib::ParseError error;
+	if (filename != nullptr) {
+		error = driver.parse(filename, &tree, 0);
+	} else {
+		std::string text = bench::MakeScene(count, true);
+		error = driver.parseBuffer(text.data(), text.size(), &tree, 0);
+	}
+	if (error != rib::kSuccess) {
+		printf("Couldn't parse: %s\n", tree.message.c_str());
+		return EXIT_FAILURE;
+	}
+	rib::FlatScene scene;
+	rib::Flatten(tree.root, &scene);
+
+	std::vector<rib::PointJob> jobs;
+	for (size_t node = 0; node < scene.size(); node++) {
+		rib::PointJob job = { (uint32_t) node, (unsigned) samples };
+		if (rib::PointCount(scene, job) > 0)
+			jobs.push_back(job);
+	}
+
+	rib::PointCloud first;
+	rib::Tessellate(scene, jobs, nullptr, &first);
+	std::vector<rib::PointJob> frame(jobs.begin(), jobs.begin() +
+				std::min(jobs.size(), (size_t) per_frame));
+	printf("%zu jobs, %zu points, %d samples across, %d times, "
+		"%zu jobs a frame\n", jobs.size(), first.size(), samples,
+		repeats, frame.size());
+	printf("%8s %12s %10s %10s %12s %12s\n", "threads", "Mpt/s",
+		"scaling", "same", "pool us", "started us");
+
+	if (most == 0)
+		most = (int) rib::DefaultThreads();
+	double single = 0.0;
+	for (unsigned threads = 1; ; threads *= 2) {
+		threads = std::min(threads, (unsigned) most);
+		rib::ThreadPool pool(threads);
+		rib::PointCloud cloud;
+		auto start = std::chrono::steady_clock::now();
+		for (int r = 0; r < repeats; r++)
+			rib::Tessellate(scene, jobs, &pool, &cloud);
+		double rate = (double) cloud.size() * repeats /
+						bench::Seconds(start) / 1e6;
+		if (threads == 1)
+			single = rate;
+		bool same = cloud.points == first.points;
+
+		rib::PointCloud small;
+		start = std::chrono::steady_clock::now();
+		for (int r = 0; r < kFrames; r++)
+			rib::Tessellate(scene, frame, &pool, &small);
+		double pooled = bench::Seconds(start) * 1e6 / kFrames;
+		start = std::chrono::steady_clock::now();
+		for (int r = 0; r < kFrames; r++) {
+			rib::ThreadPool started(threads);
+			rib::Tessellate(scene, frame, &started, &small);
+		}
+		double started = bench::Seconds(start) * 1e6 / kFrames;
+
+		printf("%8u %12.1f %9.2fx %10s %12.1f %12.1f\n", threads,
+			rate, rate / single, same ? "yes" : "no", pooled,
+			started);
+		if (threads == (unsigned) most)
+			break;
+	}
+	return EXIT_SUCCESS;
+}
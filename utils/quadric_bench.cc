@@ -0,0 +1,127 @@
+/* ************************************************************************
+ * Copyright 2017 Alexander Mishurov
+ * 
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ * 
+ * http://www.apache.org/licenses/LICENSE-2.0
+ * 
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ * ************************************************************************/
+
+// Points per second of the quadric grids against one Point call per
+// sample through a function pointer, the way the plug-in used to make
+// them, and how far apart the two are.
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <vector>
+#include "utils/bench.h"
+#include "utils/primitives.h"
+#include "utils/quadric_grid.h"
+
+namespace {
+
+struct Point {
+	float x, y, z;
+	Point(float x, float y, float z) : x(x), y(y), z(z) {}
+};
+
+typedef Point (*PointFunction)(float, float, float *);
+typedef void (*GridFunction)(const float *, const float *, int,
+					const float *, int, float *);
+
+struct Case {
+	const char *name;
+	PointFunction point;
+	GridFunction grid;
+	float args[7];
+};
+
+const Case kCases[] = {
+	{ "Sphere", quadrics::SpherePoint<Point>, quadrics::SphereGrid,
+		{ 1.0f, -0.5f, 0.8f, 300.0f } },
+	{ "Cone", quadrics::ConePoint<Point>, quadrics::ConeGrid,
+		{ 2.0f, 1.0f, 360.0f } },
+	{ "Cylinder", quadrics::CylinderPoint<Point>, quadrics::CylinderGrid,
+		{ 1.0f, -1.0f, 1.0f, 360.0f } },
+	{ "Hyperboloid", quadrics::HyperboloidPoint<Point>,
+		quadrics::HyperboloidGrid,
+		{ 1.0f, 0.0f, -1.0f, 0.0f, 1.0f, 1.0f, 360.0f } },
+	{ "Paraboloid", quadrics::ParaboloidPoint<Point>,
+		quadrics::ParaboloidGrid, { 1.0f, 0.1f, 2.0f, 360.0f } },
+	{ "Disk", quadrics::DiskPoint<Point>, quadrics::DiskGrid,
+		{ 0.5f, 1.0f, 360.0f } },
+	{ "Torus", quadrics::TorusPoint<Point>, quadrics::TorusGrid,
+		{ 1.0f, 0.3f, 0.0f, 360.0f, 360.0f } }
+};
+
+} // namespace
+
+int main(int argc, char **argv)
+{
+	int samples = argc > 1 ? atoi(argv[1]) : 64;
+	int repeats = argc > 2 ? atoi(argv[2]) : 2000;
+	if (samples < 1 || repeats < 1) {
+		printf("Usage: %s [samples across] [repeats]\n", argv[0]);
+		return EXIT_FAILURE;
+	}
+	std::vector<float> u(samples);
+	std::vector<float> v(samples);
+	for (int i = 0; i < samples; i++) {
+		u[i] = (i + 0.5f) / samples;
+		v[i] = (i + 0.5f) / samples;
+	}
+	size_t count = (size_t) samples * samples;
+	std::vector<float> one(count * 3);
+	std::vector<float> grid(count * 3);
+	double points = (double) count * repeats;
+
+	printf("%d x %d samples, %d times\n", samples, samples, repeats);
+	printf("%-12s %12s %12s %8s %10s\n", "", "Point Mpt/s",
+		"Grid Mpt/s", "speedup", "max error");
+	for (const Case &test : kCases) {
+		float args[7];
+		std::copy(test.args, test.args + 7, args);
+		// called through a pointer as PopulatePointArray did
+		volatile PointFunction point = test.point;
+
+		auto start = std::chrono::steady_clock::now();
+		for (int r = 0; r < repeats; r++) {
+			float *out = one.data();
+			for (int i = 0; i < samples; i++) {
+				for (int j = 0; j < samples; j++) {
+					Point p = point(u[i], v[j], args);
+					*out++ = p.x;
+					*out++ = p.y;
+					*out++ = p.z;
+				}
+			}
+		}
+		double one_seconds = bench::Seconds(start);
+
+		start = std::chrono::steady_clock::now();
+		for (int r = 0; r < repeats; r++) {
+			test.grid(args, u.data(), samples, v.data(), samples,
+							grid.data());
+		}
+		double grid_seconds = bench::Seconds(start);
+
+		float error = 0.0f;
+		for (size_t i = 0; i < one.size(); i++)
+			error = std::max(error, std::fabs(one[i] - grid[i]));
+		printf("%-12s %12.1f %12.1f %7.1fx %10.2g\n", test.name,
+			points / one_seconds / 1e6,
+			points / grid_seconds / 1e6,
+			one_seconds / grid_seconds, error);
+	}
+	return EXIT_SUCCESS;
+}
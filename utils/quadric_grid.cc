@@ -0,0 +1,273 @@
+/* ************************************************************************
+ * Copyright 2017 Alexander Mishurov
+ * 
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ * 
+ * http://www.apache.org/licenses/LICENSE-2.0
+ * 
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ * ************************************************************************/
+
+#include <cmath>
+#include <vector>
+#if defined(__AVX__)
+#include <immintrin.h>
+#elif defined(__SSE2__) || defined(_M_X64)
+#include <emmintrin.h>
+#endif
+#include "quadric_grid.h"
+#include "primitives.h"
+
+#if defined(__AVX__) || defined(__SSE2__) || defined(_M_X64)
+#define QUADRIC_GRID_SSE
+#endif
+
+namespace quadrics {
+
+namespace {
+
+// A quadric's profile at each v: the point at theta 0 is (a, b, c) and
+// the rest of the surface is the profile turned about z. Each shape
+// says where its thetamax is and whether b is ever other than 0.
+
+struct Sphere {
+	static const int kThetaMax = 3;
+	static const bool kTwisted = false;
+	static void profile(const float *args, float v,
+					float *a, float *b, float *c)
+	{
+		float radius = args[0];
+		float phimin = args[1] > -radius ? asin(args[1] / radius)
+							: radians(-90);
+		float phimax = args[2] < radius ? asin(args[2] / radius)
+							: radians(90);
+		float phi = phimin + v * (phimax - phimin);
+		*a = radius * cos(phi);
+		*c = radius * sin(phi);
+	}
+};
+
+struct Cone {
+	static const int kThetaMax = 2;
+	static const bool kTwisted = false;
+	static void profile(const float *args, float v,
+					float *a, float *b, float *c)
+	{
+		*a = args[1] * (1 - v);
+		*c = v * args[0];
+	}
+};
+
+struct Cylinder {
+	static const int kThetaMax = 3;
+	static const bool kTwisted = false;
+	static void profile(const float *args, float v,
+					float *a, float *b, float *c)
+	{
+		*a = args[0];
+		*c = args[1] + v * (args[2] - args[1]);
+	}
+};
+
+struct Hyperboloid {
+	static const int kThetaMax = 6;
+	static const bool kTwisted = true;
+	static void profile(const float *args, float v,
+					float *a, float *b, float *c)
+	{
+		*a = (1 - v) * args[0] + v * args[3];
+		*b = (1 - v) * args[1] + v * args[4];
+		*c = (1 - v) * args[2] + v * args[5];
+	}
+};
+
+struct Paraboloid {
+	static const int kThetaMax = 3;
+	static const bool kTwisted = false;
+	static void profile(const float *args, float v,
+					float *a, float *b, float *c)
+	{
+		float z = args[1] + v * (args[2] - args[1]);
+		*a = args[0] * sqrt(z / args[2]);
+		*c = z;
+	}
+};
+
+struct Disk {
+	static const int kThetaMax = 2;
+	static const bool kTwisted = false;
+	static void profile(const float *args, float v,
+					float *a, float *b, float *c)
+	{
+		*a = args[1] * (1 - v);
+		*c = args[0];
+	}
+};
+
+struct Torus {
+	static const int kThetaMax = 4;
+	static const bool kTwisted = false;
+	static void profile(const float *args, float v,
+					float *a, float *b, float *c)
+	{
+		float phimin = radians(args[2]);
+		float phimax = radians(args[3]);
+		float phi = phimin + v * (phimax - phimin);
+		*a = args[0] + args[1] * cos(phi);
+		*c = args[1] * sin(phi);
+	}
+};
+
+#ifdef QUADRIC_GRID_SSE
+// x0 x1 x2 x3, y.. and z.. as x0 y0 z0 x1 y1 z1 ...
+inline void Interleave(__m128 x, __m128 y, __m128 z, float *out)
+{
+	__m128 xy_low = _mm_unpacklo_ps(x, y);
+	__m128 xy_high = _mm_unpackhi_ps(x, y);
+	__m128 zx = _mm_shuffle_ps(z, x, _MM_SHUFFLE(1, 1, 0, 0));
+	__m128 yz = _mm_shuffle_ps(y, z, _MM_SHUFFLE(1, 1, 1, 1));
+	__m128 zxy = _mm_shuffle_ps(z, xy_high, _MM_SHUFFLE(3, 2, 3, 2));
+	_mm_storeu_ps(out, _mm_shuffle_ps(xy_low, zx,
+					_MM_SHUFFLE(2, 0, 1, 0)));
+	_mm_storeu_ps(out + 4, _mm_shuffle_ps(yz, xy_high,
+					_MM_SHUFFLE(1, 0, 2, 0)));
+	_mm_storeu_ps(out + 8, _mm_shuffle_ps(zxy, zxy,
+					_MM_SHUFFLE(1, 3, 2, 0)));
+}
+#endif
+
+// One row of the grid, the profile turned by the angle whose cosine
+// and sine are given.
+template<bool kTwisted>
+void Sweep(float cosine, float sine, const float *a, const float *b,
+				const float *c, int numv, float *out)
+{
+	int j = 0;
+#ifdef __AVX__
+	__m256 cosines = _mm256_set1_ps(cosine);
+	__m256 sines = _mm256_set1_ps(sine);
+	for (; j + 8 <= numv; j += 8) {
+		__m256 av = _mm256_loadu_ps(a + j);
+		__m256 x = _mm256_mul_ps(av, cosines);
+		__m256 y = _mm256_mul_ps(av, sines);
+		if (kTwisted) {
+			__m256 bv = _mm256_loadu_ps(b + j);
+			x = _mm256_sub_ps(x, _mm256_mul_ps(bv, sines));
+			y = _mm256_add_ps(y, _mm256_mul_ps(bv, cosines));
+		}
+		__m256 z = _mm256_loadu_ps(c + j);
+		Interleave(_mm256_castps256_ps128(x),
+				_mm256_castps256_ps128(y),
+				_mm256_castps256_ps128(z), out + j * 3);
+		Interleave(_mm256_extractf128_ps(x, 1),
+				_mm256_extractf128_ps(y, 1),
+				_mm256_extractf128_ps(z, 1), out + j * 3 + 12);
+	}
+#endif
+#ifdef QUADRIC_GRID_SSE
+	__m128 cosines4 = _mm_set1_ps(cosine);
+	__m128 sines4 = _mm_set1_ps(sine);
+	for (; j + 4 <= numv; j += 4) {
+		__m128 av = _mm_loadu_ps(a + j);
+		__m128 x = _mm_mul_ps(av, cosines4);
+		__m128 y = _mm_mul_ps(av, sines4);
+		if (kTwisted) {
+			__m128 bv = _mm_loadu_ps(b + j);
+			x = _mm_sub_ps(x, _mm_mul_ps(bv, sines4));
+			y = _mm_add_ps(y, _mm_mul_ps(bv, cosines4));
+		}
+		Interleave(x, y, _mm_loadu_ps(c + j), out + j * 3);
+	}
+#endif
+	for (; j < numv; j++) {
+		float x = a[j] * cosine;
+		float y = a[j] * sine;
+		if (kTwisted) {
+			x -= b[j] * sine;
+			y += b[j] * cosine;
+		}
+		out[j * 3] = x;
+		out[j * 3 + 1] = y;
+		out[j * 3 + 2] = c[j];
+	}
+}
+
+template<typename Shape>
+void Grid(const float *args, const float *u, int numu,
+			const float *v, int numv, float *points)
+{
+	if (numu <= 0 || numv <= 0)
+		return;
+	// the profile, then the cosines and sines of theta
+	std::vector<float> rows(numv * 3 + numu * 2, 0.0f);
+	float *a = rows.data();
+	float *b = a + numv;
+	float *c = b + numv;
+	float *cosines = c + numv;
+	float *sines = cosines + numu;
+
+	for (int j = 0; j < numv; j++)
+		Shape::profile(args, v[j], a + j, b + j, c + j);
+	float thetamax = radians(args[Shape::kThetaMax]);
+	for (int i = 0; i < numu; i++) {
+		float theta = u[i] * thetamax;
+		cosines[i] = cos(theta);
+		sines[i] = sin(theta);
+	}
+	for (int i = 0; i < numu; i++) {
+		Sweep<Shape::kTwisted>(cosines[i], sines[i], a, b, c, numv,
+						points + (size_t) i * numv * 3);
+	}
+}
+
+} // namespace
+
+void SphereGrid(const float *args, const float *u, int numu,
+				const float *v, int numv, float *points)
+{
+	Grid<Sphere>(args, u, numu, v, numv, points);
+}
+
+void ConeGrid(const float *args, const float *u, int numu,
+				const float *v, int numv, float *points)
+{
+	Grid<Cone>(args, u, numu, v, numv, points);
+}
+
+void CylinderGrid(const float *args, const float *u, int numu,
+				const float *v, int numv, float *points)
+{
+	Grid<Cylinder>(args, u, numu, v, numv, points);
+}
+
+void HyperboloidGrid(const float *args, const float *u, int numu,
+				const float *v, int numv, float *points)
+{
+	Grid<Hyperboloid>(args, u, numu, v, numv, points);
+}
+
+void ParaboloidGrid(const float *args, const float *u, int numu,
+				const float *v, int numv, float *points)
+{
+	Grid<Paraboloid>(args, u, numu, v, numv, points);
+}
+
+void DiskGrid(const float *args, const float *u, int numu,
+				const float *v, int numv, float *points)
+{
+	Grid<Disk>(args, u, numu, v, numv, points);
+}
+
+void TorusGrid(const float *args, const float *u, int numu,
+				const float *v, int numv, float *points)
+{
+	Grid<Torus>(args, u, numu, v, numv, points);
+}
+
+} // namespace quadrics
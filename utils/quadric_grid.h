@@ -0,0 +1,47 @@
+/* ************************************************************************
+ * Copyright 2017 Alexander Mishurov
+ * 
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ * 
+ * http://www.apache.org/licenses/LICENSE-2.0
+ * 
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ * ************************************************************************/
+
+#ifndef RIBPARSER_QUADRIC_GRID_H_
+#define RIBPARSER_QUADRIC_GRID_H_
+
+namespace quadrics {
+
+// The points of a quadric at every u with every v, the same as calling
+// the Point function of primitives.h for each pair. There are numu *
+// numv of them, v runs fastest, and each is 3 floats in points. The
+// args are those of the Point function.
+//
+// Every quadric is a profile in v swept about z by theta, which only u
+// changes, so the sines and cosines are worked out once per u and once
+// per v. The sweep is in SSE, or AVX where the compiler targets it.
+void SphereGrid(const float *args, const float *u, int numu,
+				const float *v, int numv, float *points);
+void ConeGrid(const float *args, const float *u, int numu,
+				const float *v, int numv, float *points);
+void CylinderGrid(const float *args, const float *u, int numu,
+				const float *v, int numv, float *points);
+void HyperboloidGrid(const float *args, const float *u, int numu,
+				const float *v, int numv, float *points);
+void ParaboloidGrid(const float *args, const float *u, int numu,
+				const float *v, int numv, float *points);
+void DiskGrid(const float *args, const float *u, int numu,
+				const float *v, int numv, float *points);
+void TorusGrid(const float *args, const float *u, int numu,
+				const float *v, int numv, float *points);
+
+} // namespace quadrics
+
+#endif  // RIBPARSER_QUADRIC_GRID_H_
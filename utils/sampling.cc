@@ -0,0 +1,93 @@
+/* ************************************************************************
+ * Copyright 2017 Alexander Mishurov
+ * 
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ * 
+ * http://www.apache.org/licenses/LICENSE-2.0
+ * 
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ * ************************************************************************/
+
+#include <algorithm>
+#include <cmath>
+#include "sampling.h"
+
+namespace sampling {
+
+namespace {
+
+const uint64_t kGolden = 0x9e3779b97f4a7c15ull;
+
+// the largest float below 1
+const float kBelowOne = 1.0f - 1.0f / (1 << 24);
+
+// the finalizer of splitmix64
+uint64_t Mix(uint64_t x)
+{
+	x = (x ^ (x >> 30)) * 0xbf58476d1ce4e5b9ull;
+	x = (x ^ (x >> 27)) * 0x94d049bb133111ebull;
+	return x ^ (x >> 31);
+}
+
+double RadicalInverse(uint64_t n, unsigned base)
+{
+	double inverse = 0.0;
+	double digit = 1.0 / base;
+	for (; n != 0; n /= base, digit /= base)
+		inverse += (n % base) * digit;
+	return inverse;
+}
+
+// 1 / g and 1 / g^2 for the plastic number g
+const double kR2Steps[] = { 0.7548776662466927, 0.5698402909980532 };
+const unsigned kHaltonBases[] = { 2, 3 };
+
+} // namespace
+
+uint64_t Random::bits(uint64_t counter) const
+{
+	return Mix(seed_ + (counter + 1) * kGolden);
+}
+
+float Random::uniform(uint64_t counter) const
+{
+	return (bits(counter) >> 40) * (1.0f / (1 << 24));
+}
+
+uint64_t Seed(uint64_t a, uint64_t b)
+{
+	return Mix(Mix(a + kGolden) ^ b);
+}
+
+void Strata(Pattern pattern, uint64_t seed, int axis, int count,
+								float *out)
+{
+	Random random(Seed(seed, axis));
+	// the sequences are turned about the cell by a random amount
+	double shift = pattern == kJittered ? 0.0 : random.uniform(0);
+	for (int i = 0; i < count; i++) {
+		double offset;
+		switch (pattern) {
+		case kHalton:
+			offset = RadicalInverse(i + 1, kHaltonBases[axis & 1]);
+			break;
+		case kR2:
+			offset = (i + 1) * kR2Steps[axis & 1];
+			break;
+		default:
+			offset = random.uniform(i + 1);
+			break;
+		}
+		offset += shift;
+		offset -= std::floor(offset);
+		out[i] = std::min((float) ((i + offset) / count), kBelowOne);
+	}
+}
+
+} // namespace sampling
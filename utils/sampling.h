@@ -0,0 +1,60 @@
+/* ************************************************************************
+ * Copyright 2017 Alexander Mishurov
+ * 
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ * 
+ * http://www.apache.org/licenses/LICENSE-2.0
+ * 
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ * ************************************************************************/
+
+#ifndef RIBPARSER_SAMPLING_H_
+#define RIBPARSER_SAMPLING_H_
+
+#include <cstdint>
+
+namespace sampling {
+
+// Where in its cell each sample of a stratified set falls.
+enum Pattern {
+	// anywhere, at random
+	kJittered,
+	// along the radical inverse in base 2 for u and 3 for v
+	kHalton,
+	// along the R2 sequence, the additive recurrence of the plastic
+	// number, one of its dimensions for u and the other for v
+	kR2
+};
+
+// A counter-based generator: the nth number of a seed is a hash of the
+// two, so numbers can be had in any order and from any thread, and the
+// same seed gives the same numbers on every run.
+class Random {
+public:
+	explicit Random(uint64_t seed) : seed_(seed) {}
+	uint64_t bits(uint64_t counter) const;
+	// in [0, 1)
+	float uniform(uint64_t counter) const;
+private:
+	uint64_t seed_;
+};
+
+// A seed of two numbers, say a primitive's index and what the numbers
+// are for.
+uint64_t Seed(uint64_t a, uint64_t b);
+
+// Fills out with count numbers in [0, 1), the ith in the ith of count
+// equal cells. The cells are shifted by the seed. Axis 0 is for u and
+// 1 for v, so that the two don't follow the same pattern.
+void Strata(Pattern pattern, uint64_t seed, int axis, int count,
+								float *out);
+
+} // namespace sampling
+
+#endif  // RIBPARSER_SAMPLING_H_